@@ -0,0 +1,60 @@
+/*
+ * Host simulation stand-in for driver/gpio.h
+ * Pin activity is routed to the emulated boards in sim_gpio.c
+ */
+#ifndef SIM_DRIVER_GPIO_H
+#define SIM_DRIVER_GPIO_H
+
+#include <stdint.h>
+#include "esp_attr.h"
+#include "soc/soc.h"
+#include "esp_err.h"
+
+typedef int gpio_num_t;
+
+typedef enum {
+    GPIO_MODE_DISABLE = 0,
+    GPIO_MODE_INPUT = 1,
+    GPIO_MODE_OUTPUT = 2,
+    GPIO_MODE_INPUT_OUTPUT = 3
+} gpio_mode_t;
+
+typedef enum {
+    GPIO_PULLUP_ONLY,
+    GPIO_PULLDOWN_ONLY,
+    GPIO_PULLUP_PULLDOWN,
+    GPIO_FLOATING
+} gpio_pull_mode_t;
+
+typedef enum {
+    GPIO_INTR_DISABLE = 0,
+    GPIO_INTR_POSEDGE = 1,
+    GPIO_INTR_NEGEDGE = 2,
+    GPIO_INTR_ANYEDGE = 3,
+    GPIO_INTR_LOW_LEVEL = 4,
+    GPIO_INTR_HIGH_LEVEL = 5
+} gpio_int_type_t;
+
+typedef struct {
+    uint64_t pin_bit_mask;
+    gpio_mode_t mode;
+    int pull_up_en;
+    int pull_down_en;
+    gpio_int_type_t intr_type;
+} gpio_config_t;
+
+typedef void (*gpio_isr_t)(void *);
+
+extern void gpio_pad_select_gpio(uint8_t gpio_num);
+extern esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode);
+extern esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level);
+extern int gpio_get_level(gpio_num_t gpio_num);
+extern esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull);
+extern esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type);
+extern esp_err_t gpio_config(const gpio_config_t *conf);
+extern esp_err_t gpio_install_isr_service(int intr_alloc_flags);
+extern esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr, void *args);
+extern esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num);
+extern esp_err_t gpio_wakeup_enable(gpio_num_t gpio_num, gpio_int_type_t intr_type);
+
+#endif
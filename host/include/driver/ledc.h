@@ -0,0 +1,48 @@
+/*
+ * Host simulation stand-in for driver/ledc.h
+ * The simulator only records what would have been played.
+ */
+#ifndef SIM_DRIVER_LEDC_H
+#define SIM_DRIVER_LEDC_H
+
+#include <stdint.h>
+#include "driver/gpio.h"
+
+typedef enum { LEDC_HIGH_SPEED_MODE, LEDC_LOW_SPEED_MODE } ledc_mode_t;
+typedef enum { LEDC_TIMER_0, LEDC_TIMER_1, LEDC_TIMER_2, LEDC_TIMER_3 } ledc_timer_t;
+typedef enum { LEDC_CHANNEL_0, LEDC_CHANNEL_1, LEDC_CHANNEL_2, LEDC_CHANNEL_3,
+               LEDC_CHANNEL_4, LEDC_CHANNEL_5, LEDC_CHANNEL_6, LEDC_CHANNEL_7 } ledc_channel_t;
+typedef enum { LEDC_INTR_DISABLE, LEDC_INTR_FADE_END } ledc_intr_type_t;
+typedef enum { LEDC_TIMER_10_BIT = 10, LEDC_TIMER_13_BIT = 13, LEDC_TIMER_15_BIT = 15 } ledc_timer_bit_t;
+typedef enum { LEDC_FADE_NO_WAIT, LEDC_FADE_WAIT_DONE } ledc_fade_mode_t;
+
+typedef struct {
+    ledc_mode_t speed_mode;
+    ledc_timer_bit_t duty_resolution;
+    ledc_timer_t timer_num;
+    uint32_t freq_hz;
+} ledc_timer_config_t;
+
+typedef struct {
+    int gpio_num;
+    ledc_mode_t speed_mode;
+    ledc_channel_t channel;
+    ledc_intr_type_t intr_type;
+    ledc_timer_t timer_sel;
+    uint32_t duty;
+    int hpoint;
+} ledc_channel_config_t;
+
+extern esp_err_t ledc_timer_config(const ledc_timer_config_t *timer_conf);
+extern esp_err_t ledc_channel_config(const ledc_channel_config_t *ledc_conf);
+extern esp_err_t ledc_set_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty);
+extern esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel);
+extern uint32_t ledc_get_duty(ledc_mode_t speed_mode, ledc_channel_t channel);
+extern esp_err_t ledc_set_freq(ledc_mode_t speed_mode, ledc_timer_t timer_num, uint32_t freq_hz);
+extern esp_err_t ledc_fade_func_install(int intr_alloc_flags);
+extern esp_err_t ledc_set_fade_with_time(ledc_mode_t speed_mode, ledc_channel_t channel,
+                                         uint32_t target_duty, int max_fade_time_ms);
+extern esp_err_t ledc_fade_start(ledc_mode_t speed_mode, ledc_channel_t channel,
+                                 ledc_fade_mode_t fade_mode);
+
+#endif
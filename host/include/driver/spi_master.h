@@ -0,0 +1,92 @@
+/*
+ * Host simulation stand-in for driver/spi_master.h
+ * Transactions are clocked into the emulated boards by sim_spi.c
+ */
+#ifndef SIM_DRIVER_SPI_MASTER_H
+#define SIM_DRIVER_SPI_MASTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+
+typedef enum { SPI_HOST = 0, HSPI_HOST = 1, VSPI_HOST = 2 } spi_host_device_t;
+
+#define SPI_DEVICE_TXBIT_LSBFIRST (1 << 0)
+#define SPI_DEVICE_RXBIT_LSBFIRST (1 << 1)
+#define SPI_DEVICE_BIT_LSBFIRST   (SPI_DEVICE_TXBIT_LSBFIRST | SPI_DEVICE_RXBIT_LSBFIRST)
+#define SPI_DEVICE_3WIRE          (1 << 2)
+#define SPI_DEVICE_HALFDUPLEX     (1 << 4)
+
+#define SPI_TRANS_USE_RXDATA      (1 << 2)
+#define SPI_TRANS_USE_TXDATA      (1 << 3)
+#define SPI_TRANS_VARIABLE_CMD    (1 << 5)
+#define SPI_TRANS_VARIABLE_ADDR   (1 << 6)
+#define SPI_TRANS_VARIABLE_DUMMY  (1 << 7)
+
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_TIMEOUT       0x107
+
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int max_transfer_sz;
+} spi_bus_config_t;
+
+struct spi_transaction_t;
+typedef void (*transaction_cb_t)(struct spi_transaction_t *trans);
+
+typedef struct {
+    uint8_t command_bits;
+    uint8_t address_bits;
+    uint8_t dummy_bits;
+    uint8_t mode;
+    int clock_speed_hz;
+    int spics_io_num;
+    uint32_t flags;
+    int queue_size;
+    transaction_cb_t pre_cb;
+    transaction_cb_t post_cb;
+} spi_device_interface_config_t;
+
+typedef struct spi_transaction_t {
+    uint32_t flags;
+    uint16_t cmd;
+    uint64_t addr;
+    size_t length;
+    size_t rxlength;
+    void *user;
+    union {
+        const void *tx_buffer;
+        uint8_t tx_data[4];
+    };
+    union {
+        void *rx_buffer;
+        uint8_t rx_data[4];
+    };
+} spi_transaction_t;
+
+typedef struct {
+    spi_transaction_t base;
+    uint8_t command_bits;
+    uint8_t address_bits;
+    uint8_t dummy_bits;
+} spi_transaction_ext_t;
+
+typedef struct sim_spi_device *spi_device_handle_t;
+
+extern esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config, int dma_chan);
+extern esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *dev_config,
+                                    spi_device_handle_t *handle);
+extern esp_err_t spi_bus_remove_device(spi_device_handle_t handle);
+extern esp_err_t spi_bus_free(spi_host_device_t host);
+extern esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc,
+                                        TickType_t ticks_to_wait);
+extern esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans_desc,
+                                             TickType_t ticks_to_wait);
+extern esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc);
+
+#endif
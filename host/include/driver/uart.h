@@ -0,0 +1,22 @@
+/*
+ * Host simulation stand-in for driver/uart.h
+ * Only receive is modelled, fed by sim_uart_input().
+ */
+#ifndef SIM_DRIVER_UART_H
+#define SIM_DRIVER_UART_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+typedef enum { UART_NUM_0, UART_NUM_1, UART_NUM_2 } uart_port_t;
+
+extern esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size,
+                                     int tx_buffer_size, int queue_size,
+                                     QueueHandle_t *uart_queue, int intr_alloc_flags);
+extern int uart_read_bytes(uart_port_t uart_num, uint8_t *buf, uint32_t length,
+                           TickType_t ticks_to_wait);
+extern esp_err_t uart_set_wakeup_threshold(uart_port_t uart_num, int wakeup_threshold);
+
+#endif
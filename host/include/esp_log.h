@@ -0,0 +1,37 @@
+/*
+ * Host simulation stand-in for esp_log.h
+ * Messages go to stderr, filtered by sim_log_level (see sim_os.c).
+ */
+#ifndef SIM_ESP_LOG_H
+#define SIM_ESP_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+extern esp_log_level_t sim_log_level;
+extern uint32_t esp_log_timestamp(void);
+extern void esp_log_level_set(const char *tag, esp_log_level_t level);
+
+#define SIM_LOG(level, letter, tag, format, ...) do {                       \
+        if ((level) <= sim_log_level)                                       \
+            fprintf(stderr, letter " (%u) %s: " format "\n",                \
+                    esp_log_timestamp(), tag, ##__VA_ARGS__);               \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) SIM_LOG(ESP_LOG_ERROR,   "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) SIM_LOG(ESP_LOG_WARN,    "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) SIM_LOG(ESP_LOG_INFO,    "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) SIM_LOG(ESP_LOG_DEBUG,   "D", tag, format, ##__VA_ARGS__)
+/* Verbose is compiled out on the device at CONFIG_LOG_DEFAULT_LEVEL 4 */
+#define ESP_LOGV(tag, format, ...) do { } while (0)
+
+#endif
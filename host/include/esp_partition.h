@@ -0,0 +1,40 @@
+/*
+ * Host simulation stand-in for esp_partition.h, see sim_flash.c
+ */
+#ifndef SIM_ESP_PARTITION_H
+#define SIM_ESP_PARTITION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef int esp_partition_subtype_t;
+#define ESP_PARTITION_SUBTYPE_ANY 0xff
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+    bool encrypted;
+} esp_partition_t;
+
+extern const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                        esp_partition_subtype_t subtype,
+                                                        const char *label);
+extern esp_err_t esp_partition_read(const esp_partition_t *partition,
+                                    size_t src_offset, void *dst, size_t size);
+extern esp_err_t esp_partition_write(const esp_partition_t *partition,
+                                     size_t dst_offset, const void *src, size_t size);
+extern esp_err_t esp_partition_erase_range(const esp_partition_t *partition,
+                                           size_t start_addr, size_t size);
+
+#endif
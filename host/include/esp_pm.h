@@ -0,0 +1,35 @@
+/*
+ * Host simulation stand-in for esp_pm.h
+ * sim_os.c runs busy time at the frequency the locks call for and counts
+ * the time every task is blocked as light sleep when it is enabled.
+ */
+#ifndef SIM_ESP_PM_H
+#define SIM_ESP_PM_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_PM_CPU_FREQ_MAX,
+    ESP_PM_APB_FREQ_MAX,
+    ESP_PM_NO_LIGHT_SLEEP,
+} esp_pm_lock_type_t;
+
+typedef struct {
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_esp32_t;
+
+typedef struct sim_pm_lock *esp_pm_lock_handle_t;
+
+extern esp_err_t esp_pm_configure(const void *config);
+extern esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg,
+                                    const char *name, esp_pm_lock_handle_t *out_handle);
+extern esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle);
+extern esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle);
+extern esp_err_t esp_pm_dump_locks(FILE *stream);
+
+#endif
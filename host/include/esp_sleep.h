@@ -0,0 +1,12 @@
+/*
+ * Host simulation stand-in for esp_sleep.h
+ */
+#ifndef SIM_ESP_SLEEP_H
+#define SIM_ESP_SLEEP_H
+
+#include "esp_err.h"
+
+extern esp_err_t esp_sleep_enable_gpio_wakeup(void);
+extern esp_err_t esp_sleep_enable_uart_wakeup(int uart_num);
+
+#endif
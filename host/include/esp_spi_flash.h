@@ -0,0 +1,10 @@
+#ifndef SIM_ESP_SPI_FLASH_H
+#define SIM_ESP_SPI_FLASH_H
+
+#include <stddef.h>
+
+#define SPI_FLASH_SEC_SIZE 4096
+
+extern size_t spi_flash_get_chip_size(void);
+
+#endif
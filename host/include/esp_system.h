@@ -0,0 +1,25 @@
+/*
+ * Host simulation stand-in for esp_system.h
+ */
+#ifndef SIM_ESP_SYSTEM_H
+#define SIM_ESP_SYSTEM_H
+
+#include <stdint.h>
+#include "soc/soc.h"
+
+#define CHIP_FEATURE_EMB_FLASH BIT(0)
+#define CHIP_FEATURE_WIFI_BGN  BIT(1)
+#define CHIP_FEATURE_BLE       BIT(4)
+#define CHIP_FEATURE_BT        BIT(5)
+
+typedef struct {
+    int model;
+    uint32_t features;
+    uint8_t cores;
+    uint8_t revision;
+} esp_chip_info_t;
+
+extern void esp_chip_info(esp_chip_info_t *out_info);
+extern uint32_t esp_random(void);
+
+#endif
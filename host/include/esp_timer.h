@@ -0,0 +1,12 @@
+/*
+ * Host simulation stand-in for esp_timer.h
+ */
+#ifndef SIM_ESP_TIMER_H
+#define SIM_ESP_TIMER_H
+
+#include <stdint.h>
+
+/* Microseconds since boot on the virtual clock */
+extern int64_t esp_timer_get_time(void);
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * Host simulation stand-in for FreeRTOS.h
+ *
+ * Tasks are run cooperatively on one host thread against a virtual clock,
+ * see sim_os.c.  A task only gives up the CPU when it delays or blocks,
+ * which is enough for the firmware as written.
+ */
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "soc/soc.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+/* ESP-IDF counts stacks in bytes */
+typedef uint8_t StackType_t;
+
+/* Room for the real kernel's objects; the sim keeps its own */
+typedef struct {
+    uint8_t reserved[352];
+} StaticTask_t;
+typedef struct {
+    uint8_t reserved[32];
+} StaticEventGroup_t;
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+
+#define portMAX_DELAY ((TickType_t) 0xffffffffUL)
+#define portNUM_PROCESSORS 2
+#define configTICK_RATE_HZ CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS ((TickType_t) 1000 / configTICK_RATE_HZ)
+#define portTICK_RATE_MS portTICK_PERIOD_MS
+#define pdMS_TO_TICKS(ms) ((TickType_t) (((uint64_t) (ms) * configTICK_RATE_HZ) / 1000))
+#define portYIELD_FROM_ISR()
+#define tskNO_AFFINITY 0x7fffffff
+
+/* Tasks never preempt each other, so critical sections have nothing to do */
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void) (mux))
+#define portEXIT_CRITICAL(mux) ((void) (mux))
+
+#endif
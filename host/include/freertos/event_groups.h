@@ -0,0 +1,22 @@
+#ifndef SIM_EVENT_GROUPS_H
+#define SIM_EVENT_GROUPS_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef uint32_t EventBits_t;
+typedef struct sim_event_group *EventGroupHandle_t;
+
+extern EventGroupHandle_t xEventGroupCreate(void);
+extern EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *buffer);
+extern EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+extern BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t group,
+                                            EventBits_t bits,
+                                            BaseType_t *higher_priority_woken);
+extern EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+extern EventBits_t xEventGroupWaitBits(EventGroupHandle_t group,
+                                       EventBits_t bits,
+                                       BaseType_t clear_on_exit,
+                                       BaseType_t wait_for_all,
+                                       TickType_t ticks);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef SIM_QUEUE_H
+#define SIM_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct sim_queue *QueueHandle_t;
+
+extern QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+extern void vQueueDelete(QueueHandle_t queue);
+extern BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks);
+extern BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item,
+                                    BaseType_t *higher_priority_woken);
+extern BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+extern UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+extern BaseType_t xQueueReset(QueueHandle_t queue);
+
+#define xQueueSend(queue, item, ticks) xQueueSendToBack(queue, item, ticks)
+
+#endif
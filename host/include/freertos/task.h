@@ -0,0 +1,40 @@
+#ifndef SIM_TASK_H
+#define SIM_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct sim_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+extern BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                          uint32_t stack_depth, void *arg,
+                                          UBaseType_t priority,
+                                          TaskHandle_t *handle,
+                                          BaseType_t core);
+extern TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name,
+                                                  uint32_t stack_depth, void *arg,
+                                                  UBaseType_t priority,
+                                                  StackType_t *stack,
+                                                  StaticTask_t *tcb,
+                                                  BaseType_t core);
+extern BaseType_t xTaskCreate(TaskFunction_t fn, const char *name,
+                              uint32_t stack_depth, void *arg,
+                              UBaseType_t priority, TaskHandle_t *handle);
+extern void vTaskDelete(TaskHandle_t task);
+extern void vTaskSuspend(TaskHandle_t task);
+extern TaskHandle_t xTaskGetHandle(const char *name);
+extern void vTaskDelay(TickType_t ticks);
+extern void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period);
+extern TickType_t xTaskGetTickCount(void);
+extern BaseType_t xPortGetCoreID(void);
+extern uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
+extern BaseType_t xTaskNotifyGive(TaskHandle_t task);
+extern void vTaskNotifyGiveFromISR(TaskHandle_t task,
+                                   BaseType_t *higher_priority_woken);
+extern TaskHandle_t xTaskGetCurrentTaskHandle(void);
+extern void vTaskGetRunTimeStats(char *buffer);
+extern UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+#define taskYIELD() vTaskDelay(0)
+
+#endif
@@ -0,0 +1,14 @@
+/*
+ * Host simulation stand-in for lwip/sockets.h, the host's own sockets
+ */
+#ifndef SIM_LWIP_SOCKETS_H
+#define SIM_LWIP_SOCKETS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#endif
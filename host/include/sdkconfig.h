@@ -0,0 +1,20 @@
+/*
+ * Host simulation stand-in for the generated sdkconfig.h
+ * Only the options the firmware sources actually look at are defined.
+ */
+#ifndef SIM_SDKCONFIG_H
+#define SIM_SDKCONFIG_H
+
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_LOG_DEFAULT_LEVEL 4
+#define CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ 160
+#define CONFIG_MAIN_TASK_STACK_SIZE 3584
+#define CONFIG_PM_ENABLE 1
+#define CONFIG_FREERTOS_USE_TICKLESS_IDLE 1
+#define CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP 3
+#define CONFIG_FREERTOS_USE_TRACE_FACILITY 1
+#define CONFIG_FREERTOS_USE_STATS_FORMATTING_FUNCTIONS 1
+#define CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS 1
+#define CONFIG_SUPPORT_STATIC_ALLOCATION 1
+
+#endif
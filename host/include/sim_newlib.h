@@ -0,0 +1,16 @@
+/*
+ * Forced include for every firmware translation unit in the host build.
+ *
+ * ESP-IDF's newlib runs clock() at CLOCKS_PER_SEC == 1000 and main.c relies
+ * on that (second_timer += 1000).  The simulator's clock() returns virtual
+ * milliseconds, so give the firmware the same view of the world.
+ */
+#ifndef SIM_NEWLIB_H
+#define SIM_NEWLIB_H
+
+#include <time.h>
+
+#undef CLOCKS_PER_SEC
+#define CLOCKS_PER_SEC 1000
+
+#endif
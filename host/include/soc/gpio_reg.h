@@ -0,0 +1,16 @@
+/*
+ * Host simulation stand-in for soc/gpio_reg.h
+ * Register "addresses" are only tokens for sim_reg_write()/sim_reg_read()
+ */
+#ifndef SIM_GPIO_REG_H
+#define SIM_GPIO_REG_H
+
+#define GPIO_OUT_REG          0x3ff44004
+#define GPIO_OUT_W1TS_REG     0x3ff44008
+#define GPIO_OUT_W1TC_REG     0x3ff4400c
+#define GPIO_ENABLE_REG       0x3ff44020
+#define GPIO_ENABLE_W1TS_REG  0x3ff44024
+#define GPIO_ENABLE_W1TC_REG  0x3ff44028
+#define GPIO_IN_REG           0x3ff4403c
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef SIM_SOC_H
+#define SIM_SOC_H
+
+#define BIT(nr) (1UL << (nr))
+#define BIT0 0x00000001
+#define BIT1 0x00000002
+#define BIT2 0x00000004
+#define BIT3 0x00000008
+
+/* Register access is routed to the simulated GPIO matrix, see sim_gpio.c */
+#include <stdint.h>
+extern void sim_reg_write(uint32_t reg, uint32_t value);
+extern uint32_t sim_reg_read(uint32_t reg);
+#define REG_WRITE(_r, _v) sim_reg_write((_r), (_v))
+#define REG_READ(_r) sim_reg_read(_r)
+
+#endif
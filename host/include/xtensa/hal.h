@@ -0,0 +1,12 @@
+/*
+ * Host simulation stand-in for xtensa/hal.h
+ * The cycle counter follows the virtual clock at CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ
+ */
+#ifndef SIM_XTENSA_HAL_H
+#define SIM_XTENSA_HAL_H
+
+#include <stdint.h>
+
+extern uint32_t xthal_get_ccount(void);
+
+#endif
@@ -0,0 +1,400 @@
+/*
+ * Microbenchmarks, see microbench.h
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "7_seg_ui.h"
+#include "microbench.h"
+#include "mastermind.h"
+#include "game.h"
+#include "sim.h"
+
+/* update_display() itself, not the frame counting wrapper in sim_main.c */
+extern void __real_update_display(seven_segment_ui *display);
+
+typedef struct {
+    const char *name;
+    double host_ns;
+    double device_ns;
+    double edges;
+} microbench_result;
+
+typedef struct {
+    const char *name;
+    /* Runs ops operations, returns the number of wrong answers */
+    unsigned long (*run)(seven_segment_ui *display, tm1638_emu *board,
+                         unsigned long ops);
+} microbench;
+
+/* Keeps results alive so the compiler can't drop the work */
+static volatile uint8_t sink;
+
+static const uint8_t hex_segments[16] = {
+    0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07,
+    0x7f, 0x6f, 0x77, 0x7c, 0x39, 0x5e, 0x79, 0x71,
+};
+
+
+static unsigned long bench_digit(seven_segment_ui *display, tm1638_emu *board,
+                                 unsigned long ops)
+{
+    unsigned long i, wrong = 0;
+    uint8_t seg;
+    for (i = 0; i < ops; i++) {
+        seg = display_digit((uint8_t) i);
+        if ((seg & 0x7f) != hex_segments[i % 16])
+            wrong++;
+        sink ^= seg;
+    }
+    return wrong;
+}
+
+static unsigned long bench_timer(seven_segment_ui *display, tm1638_emu *board,
+                                 unsigned long ops)
+{
+    unsigned long i, wrong = 0;
+    int seconds;
+    for (i = 0; i < ops; i++) {
+        /* Mostly the table, sometimes the arithmetic above an hour */
+        seconds = (int) (i % 4000);
+        display_timer(display, seconds);
+        if ((display->display_buffer[14] & 0x7f) != hex_segments[seconds % 10])
+            wrong++;
+    }
+    return wrong;
+}
+
+static unsigned long bench_code(seven_segment_ui *display, tm1638_emu *board,
+                                unsigned long ops)
+{
+    unsigned long i, wrong = 0;
+    uint8_t guess[4];
+    for (i = 0; i < ops; i++) {
+        if (i % 8 == 0) {
+            display_code(display, NULL);
+            if (display->display_buffer[0] != 0x39)
+                wrong++;
+        } else {
+            guess[0] = i % 10;
+            guess[1] = (i / 10) % 10;
+            guess[2] = (i / 100) % 10;
+            guess[3] = (i / 1000) % 10;
+            display_code(display, guess);
+            if (display->display_buffer[6] != hex_segments[guess[3]])
+                wrong++;
+        }
+    }
+    return wrong;
+}
+
+static unsigned long bench_leds(seven_segment_ui *display, tm1638_emu *board,
+                                unsigned long ops)
+{
+    unsigned long i, wrong = 0;
+    for (i = 0; i < ops; i++) {
+        display_leds(display, (uint8_t) i);
+        /* Bit 0 is the rightmost LED */
+        if (display->display_buffer[15] != (i & 0x01) ||
+            display->display_buffer[1] != ((i >> 7) & 0x01))
+            wrong++;
+    }
+    return wrong;
+}
+
+/* A new time every frame, as the game sends them */
+static unsigned long bench_update(seven_segment_ui *display, tm1638_emu *board,
+                                  unsigned long ops)
+{
+    unsigned long i, wrong = 0;
+    char text[9];
+    uint8_t leds;
+    display->flash = 0;
+    for (i = 0; i < ops; i++) {
+        display_timer(display, (int) (i % 3600));
+        __real_update_display(display);
+        if (board->ram[14] != display->display_buffer[14])
+            wrong++;
+    }
+    tm1638_emu_render(board, text, &leds);
+    sink ^= (uint8_t) text[0];
+    return wrong;
+}
+
+/* The same frame with flashing digits, which blink every 500 ms */
+static unsigned long bench_update_flash(seven_segment_ui *display, tm1638_emu *board,
+                                        unsigned long ops)
+{
+    unsigned long i, lit = 0;
+    uint8_t code[4] = {0, 0, 0, 0};
+    display_code(display, code);
+    display->flash = 0xf0;
+    for (i = 0; i < ops; i++) {
+        sim_run_ms(250);
+        __real_update_display(display);
+        if (board->ram[0] != 0)
+            lit++;
+    }
+    display->flash = 0;
+    /* Half the frames should have had the digits on */
+    return (lit * 4 < ops || lit * 4 > ops * 3) ? 1 : 0;
+}
+
+static unsigned long bench_buttons(seven_segment_ui *display, tm1638_emu *board,
+                                   unsigned long ops)
+{
+    unsigned long i, wrong = 0;
+    for (i = 0; i < ops; i++) {
+        tm1638_emu_set_keys(board, (uint8_t) i);
+        if (bb_read_buttons(display) != (uint8_t) i)
+            wrong++;
+    }
+    tm1638_emu_set_keys(board, 0);
+    return wrong;
+}
+
+static unsigned long bench_check_code(seven_segment_ui *display, tm1638_emu *board,
+                                      unsigned long ops)
+{
+    unsigned long i, wrong = 0;
+    uint8_t expect, code[4], secret[4];
+    int d;
+    for (i = 0; i < ops; i++) {
+        expect = 0xf0;
+        for (d = 0; d < 4; d++) {
+            secret[d] = (i >> (2 * d)) % 10;
+            code[d] = (i >> (2 * d + 1)) % 10;
+            if (code[d] == secret[d])
+                expect &= ~(0x80 >> d);
+        }
+        if (game_check(code, secret) != expect)
+            wrong++;
+    }
+    return wrong;
+}
+
+/* Exact and misplaced the long way, as exact * 5 + misplaced */
+static uint8_t reference_score(const uint8_t *guess, const uint8_t *secret)
+{
+    int d, e, exact = 0, common = 0;
+    int counts[10] = {0};
+    for (d = 0; d < 4; d++) {
+        if (guess[d] == secret[d])
+            exact++;
+        counts[secret[d]]++;
+    }
+    for (d = 0; d < 4; d++) {
+        e = guess[d];
+        if (counts[e]) {
+            counts[e]--;
+            common++;
+        }
+    }
+    return (uint8_t) (exact * 5 + common - exact);
+}
+
+static unsigned long bench_score(seven_segment_ui *display, tm1638_emu *board,
+                                 unsigned long ops)
+{
+    unsigned long i, wrong = 0;
+    uint8_t guess[4], secret_digits[4], score;
+    uint16_t g, s;
+    for (i = 0; i < ops; i++) {
+        g = (uint16_t) (i * 7919 % MASTERMIND_CODES);
+        s = (uint16_t) (i % MASTERMIND_CODES);
+        guess[0] = g / 1000; guess[1] = g / 100 % 10; guess[2] = g / 10 % 10; guess[3] = g % 10;
+        secret_digits[0] = s / 1000; secret_digits[1] = s / 100 % 10;
+        secret_digits[2] = s / 10 % 10; secret_digits[3] = s % 10;
+        score = code_score(MASTERMIND_COUNTS, code_pack(guess), code_pack(secret_digits));
+        /* Checking every op would be most of the time */
+        if (i % 16 == 0 && score != reference_score(guess, secret_digits))
+            wrong++;
+        sink ^= score;
+    }
+    return wrong;
+}
+
+/* A whole game solved by the counts rules per op */
+static unsigned long bench_solver(seven_segment_ui *display, tm1638_emu *board,
+                                  unsigned long ops)
+{
+    static solver s;
+    unsigned long i, wrong = 0;
+    uint16_t secret_code, guess;
+    uint8_t response;
+    int n;
+    for (i = 0; i < ops; i++) {
+        secret_code = (uint16_t) (i * 2377 % MASTERMIND_CODES);
+        secret_code = (uint16_t) ((secret_code / 1000) << 12 | (secret_code / 100 % 10) << 8 |
+                                  (secret_code / 10 % 10) << 4 | secret_code % 10);
+        solver_start(&s, MASTERMIND_COUNTS);
+        for (n = 0; n < 10; n++) {
+            guess = solver_guess(&s);
+            response = code_score(MASTERMIND_COUNTS, guess, secret_code);
+            if (response == MASTERMIND_SOLVED_COUNTS)
+                break;
+            solver_response(&s, guess, response);
+            while (solver_step(&s, SOLVER_FRAME_CODES) < SOLVER_READY)
+                ;
+        }
+        if (n == 10)
+            wrong++;
+    }
+    return wrong;
+}
+
+static const microbench benches[] = {
+    {"display_digit", bench_digit},
+    {"display_timer", bench_timer},
+    {"display_code", bench_code},
+    {"display_leds", bench_leds},
+    {"update_display", bench_update},
+    {"update_display_flash", bench_update_flash},
+    {"bb_read_buttons", bench_buttons},
+    {"check_code", bench_check_code},
+    {"code_score", bench_score},
+    {"solver_game", bench_solver},
+};
+#define MICROBENCH_COUNT (sizeof(benches) / sizeof(benches[0]))
+
+static double host_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* The bus benchmarks cost virtual time, so they get fewer ops */
+static unsigned long ops_for(const microbench *bench, unsigned long ops)
+{
+    if (bench->run == bench_update_flash || bench->run == bench_solver)
+        return ops / 1000 ? ops / 1000 : 1;
+    if (bench->run == bench_update || bench->run == bench_buttons)
+        return ops / 10 ? ops / 10 : 1;
+    return ops;
+}
+
+static int load_baseline(const char *path, microbench_result *base)
+{
+    FILE *f = fopen(path, "r");
+    char name[64];
+    double h, d, e;
+    size_t i;
+    int found = 0;
+
+    if (f == NULL)
+        return -1;
+    while (fscanf(f, "%63s %lf %lf %lf", name, &h, &d, &e) == 4) {
+        for (i = 0; i < MICROBENCH_COUNT; i++) {
+            if (strcmp(name, benches[i].name) == 0) {
+                base[i].name = benches[i].name;
+                base[i].host_ns = h;
+                base[i].device_ns = d;
+                base[i].edges = e;
+                found++;
+            }
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+/* Within tolerance, with a little slack for values near 0 */
+static int within(double value, double base, double tolerance, double slack)
+{
+    return value <= base * (1 + tolerance) + slack;
+}
+
+int microbench_run(seven_segment_ui *display, tm1638_emu *board,
+                   unsigned long ops, const char *baseline, int update)
+{
+    microbench_result results[MICROBENCH_COUNT];
+    microbench_result base[MICROBENCH_COUNT];
+    const microbench *bench;
+    unsigned long n, wrong;
+    uint64_t busy, edges;
+    double start, best;
+    size_t i;
+    int run, failures = 0;
+    int have_base = 0;
+    FILE *f;
+
+    memset(base, 0, sizeof(base));
+    if (baseline && !update) {
+        have_base = load_baseline(baseline, base);
+        if (have_base < 0)
+            fprintf(stderr, "no baseline %s, nothing to compare with\n", baseline);
+    }
+
+    printf("%-22s %10s %12s %10s  %s\n", "benchmark", "host ns", "device ns",
+           "edges", "per op");
+    for (i = 0; i < MICROBENCH_COUNT; i++) {
+        bench = &benches[i];
+        n = ops_for(bench, ops);
+        best = 0;
+        wrong = 0;
+        for (run = 0; run < MICROBENCH_RUNS; run++) {
+            busy = sim_busy_ns();
+            edges = board->edges;
+            start = host_ns();
+            wrong += bench->run(display, board, n);
+            start = host_ns() - start;
+            if (run == 0 || start < best)
+                best = start;
+            busy = sim_busy_ns() - busy;
+            edges = board->edges - edges;
+        }
+        results[i].name = bench->name;
+        results[i].host_ns = best / n;
+        results[i].device_ns = (double) busy / n;
+        results[i].edges = (double) edges / n;
+        printf("%-22s %10.1f %12.1f %10.1f", bench->name, results[i].host_ns,
+               results[i].device_ns, results[i].edges);
+        if (wrong) {
+            printf("  WRONG %lu", wrong);
+            failures++;
+        }
+        if (have_base > 0 && base[i].name) {
+            if (!within(results[i].device_ns, base[i].device_ns, MICROBENCH_TOLERANCE, 1) ||
+                !within(results[i].edges, base[i].edges, MICROBENCH_TOLERANCE, 0.5)) {
+                printf("  REGRESSION, baseline %.1f ns %.1f edges",
+                       base[i].device_ns, base[i].edges);
+                failures++;
+            } else if (!within(results[i].host_ns, base[i].host_ns,
+                               MICROBENCH_HOST_FACTOR - 1, 20)) {
+                printf("  REGRESSION, baseline %.1f host ns", base[i].host_ns);
+                failures++;
+            } else if (results[i].device_ns < base[i].device_ns * (1 - MICROBENCH_TOLERANCE) - 1 ||
+                       results[i].edges < base[i].edges * (1 - MICROBENCH_TOLERANCE) - 0.5) {
+                printf("  faster than baseline, update it");
+            }
+        } else if (have_base > 0) {
+            printf("  not in baseline");
+        }
+        putchar('\n');
+    }
+    if (board->protocol_errors) {
+        printf("PROTOCOL ERRORS: %llu\n", (unsigned long long) board->protocol_errors);
+        if (board->timing_errors)
+            printf("TIMING ERRORS: %llu, first %s\n",
+                   (unsigned long long) board->timing_errors, board->timing_error);
+        failures++;
+    }
+
+    if (update && baseline) {
+        f = fopen(baseline, "w");
+        if (f == NULL) {
+            perror(baseline);
+            return failures + 1;
+        }
+        for (i = 0; i < MICROBENCH_COUNT; i++)
+            fprintf(f, "%-22s %10.1f %12.1f %10.1f\n", results[i].name,
+                    results[i].host_ns, results[i].device_ns, results[i].edges);
+        fclose(f);
+        printf("baseline written to %s\n", baseline);
+    }
+    printf("%d failures\n", failures);
+    return failures;
+}
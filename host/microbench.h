@@ -0,0 +1,30 @@
+/*
+ * Microbenchmarks of the display, input and game logic functions
+ *
+ * Each benchmark runs its function against the emulated board and reports
+ * host ns/op, modelled device ns/op (the SIM_*_NS costs, so bus work only)
+ * and bus edges/op.  Results are checked against a baseline file:
+ *
+ *   name host_ns device_ns edges
+ *
+ * device ns and edges are deterministic and must stay within
+ * MICROBENCH_TOLERANCE of the baseline.  Host time depends on the machine,
+ * so it only fails beyond MICROBENCH_HOST_FACTOR times the baseline.
+ * Every benchmark also checks its results, a wrong answer fails too.
+ */
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include "7_seg_ui.h"
+#include "tm1638_emu.h"
+
+#define MICROBENCH_TOLERANCE 0.05
+#define MICROBENCH_HOST_FACTOR 3.0
+/* Host times are the best of this many runs */
+#define MICROBENCH_RUNS 5
+
+/* Returns the number of failures, writes the baseline instead if update */
+extern int microbench_run(seven_segment_ui *display, tm1638_emu *board,
+                          unsigned long ops, const char *baseline, int update);
+
+#endif
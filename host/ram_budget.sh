@@ -0,0 +1,68 @@
+#!/bin/sh
+#
+# Static RAM budget of the firmware, from its symbols
+#
+#   ram_budget.sh NM FILE...
+#
+# FILE is the firmware's objects, or the component archive they went into
+# (build/esp-idf/main/libmain.a for the device, where NM is
+# xtensa-esp32-elf-nm).  Prints each module's initialised (data) and zeroed
+# (bss) RAM, then each task's static stack and TCB from tasks.c.  Read-only
+# data stays in flash on the ESP32 and isn't counted.  Host objects are
+# 64-bit, so their pointers and the sim's stand-in TCBs read larger.
+#
+if [ $# -lt 2 ]; then
+    echo "usage: $0 NM FILE..." >&2
+    exit 2
+fi
+NM=$1
+shift
+
+"$NM" -A -S -t d "$@" | awk '
+NF == 4 && $3 ~ /^[bBdDcC]$/ {
+    # file:address, or archive:member:address
+    n = split($1, part, ":")
+    module = part[n - 1]
+    sub(/.*\//, "", module)
+    sub(/\..*/, "", module)
+    size = $2 + 0
+    if ($3 ~ /[dD]/)
+        data[module] += size
+    else
+        bss[module] += size
+    modules[module] = 1
+    if ($4 ~ /^TASK_.*_(stack|tcb)$/) {
+        task = tolower($4)
+        sub(/^task_/, "", task)
+        if (task ~ /_stack$/) {
+            sub(/_stack$/, "", task)
+            stack[task] = size
+        } else {
+            sub(/_tcb$/, "", task)
+            tcb[task] = size
+        }
+        tasks[task] = 1
+    }
+}
+END {
+    printf "Static RAM by module, bytes:\n"
+    printf "  %-18s %8s %8s %8s\n", "module", "data", "bss", "total"
+    cmd = "sort -k4 -n -r"
+    for (m in modules)
+        printf "  %-18s %8d %8d %8d\n", m, data[m], bss[m], data[m] + bss[m] | cmd
+    close(cmd)
+    for (m in modules) {
+        total_data += data[m]
+        total_bss += bss[m]
+    }
+    printf "  %-18s %8d %8d %8d\n", "total", total_data, total_bss, total_data + total_bss
+    printf "Task stacks and TCBs, bytes:\n"
+    printf "  %-18s %8s %8s %8s\n", "task", "stack", "tcb", "total"
+    for (t in tasks) {
+        printf "  %-18s %8d %8d %8d\n", t, stack[t], tcb[t], stack[t] + tcb[t] | cmd
+        total_stack += stack[t]
+        total_tcb += tcb[t]
+    }
+    close(cmd)
+    printf "  %-18s %8d %8d %8d\n", "total", total_stack, total_tcb, total_stack + total_tcb
+}'
@@ -0,0 +1,107 @@
+/*
+ * Host simulation of the countdown firmware
+ *
+ * The firmware sources in ../main are compiled unchanged against the stub
+ * headers in include/ and linked with:
+ *   sim_os.c     - cooperative FreeRTOS shim with a virtual clock
+ *   sim_gpio.c   - GPIO driver that forwards pin activity to emulated boards
+ *   sim_spi.c    - SPI master driver clocking transactions into the boards
+ *   sim_flash.c  - flash partitions held in memory, optionally in a file
+ *   tm1638_emu.c - TM1638 display/key-scan board emulator
+ */
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "tm1638_emu.h"
+
+/* Modelled CPU cost of driving a pin through the GPIO driver API */
+#define SIM_GPIO_API_NS 250
+/* ... of a direct GPIO register access */
+#define SIM_GPIO_REG_NS 25
+/* ... of reading the CPU cycle counter in a busy wait loop */
+#define SIM_CCOUNT_NS 10
+/* ... of setting up and queueing one SPI transaction, the DMA is free */
+#define SIM_SPI_QUEUE_NS 5000
+/* Time from the end of an SPI transaction to its interrupt calling post_cb,
+ * and from there to the next transaction's pre_cb */
+#define SIM_SPI_ISR_NS 1000
+/* ... of erasing a 4 KB flash sector, programming a byte, reading one */
+#define SIM_FLASH_ERASE_NS 45000000
+#define SIM_FLASH_WRITE_NS 2700
+#define SIM_FLASH_READ_NS 100
+/* CPUs, see sim_set_cores() */
+#define SIM_CORES 2
+
+/* What the power management stand-in saw, see esp_pm.h */
+typedef struct {
+    int configured;
+    int min_mhz;
+    int max_mhz;
+    int light_sleep;
+    uint64_t busy_max_ns;       /* Busy at the full clock */
+    uint64_t busy_min_ns;       /* Busy at the minimum clock, already scaled */
+    uint64_t idle_ns;           /* Nothing to run but awake */
+    uint64_t sleep_ns;          /* Nothing to run for long enough to light sleep */
+    unsigned long sleeps;       /* Each one ends in a wakeup */
+} sim_pm_stats;
+
+/* What the buzzer would have played */
+typedef struct {
+    unsigned long notes;        /* Times the output came on */
+    unsigned long fades;
+    unsigned long freq_changes;
+    uint32_t last_freq;
+    uint64_t on_ns;
+} sim_sound_stats;
+
+/* What the flash saw */
+typedef struct {
+    unsigned long reads;
+    unsigned long writes;
+    unsigned long erases;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t busy_ns;           /* Modelled time the CPUs were stalled */
+    unsigned long overwrites;   /* Writes that needed a 0 bit to go back to 1 */
+    unsigned long sector_erases_min;
+    unsigned long sector_erases_max;
+} sim_flash_stats;
+
+/* Virtual clock */
+extern uint64_t sim_now_ns(void);
+extern void sim_advance_ns(uint64_t ns);
+extern uint64_t sim_busy_ns(void);
+extern uint64_t sim_core_busy_ns(int core);
+extern void sim_set_cores(int n);
+extern void sim_run_ms(uint32_t ms);
+extern void sim_seed(uint32_t seed);
+extern int sim_log_verbosity(const char *name);
+extern void sim_pm_get_stats(sim_pm_stats *stats);
+
+/* Blocking primitives used by the FreeRTOS shim */
+extern void sim_block(const void *object, uint64_t deadline_ns);
+extern void sim_wake(const void *object);
+extern unsigned long sim_task_wakeups(const char *name);
+extern uint32_t sim_task_stack_used(TaskHandle_t task);
+
+/* GPIO */
+extern void sim_gpio_attach(tm1638_emu *board);
+extern void sim_gpio_drive(int pin, int level);
+extern void sim_gpio_bus_edge(int pin, int level, uint64_t ns);
+extern void sim_gpio_at(uint64_t ns);
+extern int sim_gpio_sample(int pin);
+extern void sim_sound_get_stats(sim_sound_stats *stats);
+
+/* Flash, the partitions in partitions.csv */
+extern int sim_flash_load(const char *path);
+extern int sim_flash_save(const char *path);
+extern void sim_flash_get_stats(sim_flash_stats *stats);
+
+/* Characters typed at the console UART */
+extern void sim_uart_input(const char *text);
+
+#endif
@@ -0,0 +1,180 @@
+/*
+ * Flash partitions for the host simulation
+ *
+ * The data partitions of partitions.csv are held in memory, erased to
+ * 0xff, and behave like NOR flash: a write can only clear bits, and only
+ * an erase of whole 4 KB sectors sets them again.  Each operation costs
+ * the calling task the SIM_FLASH_*_NS time.  On the device a flash
+ * operation also stalls the other CPU, which this doesn't model.
+ *
+ * sim_flash_load() and sim_flash_save() keep the partitions in a file, so
+ * what the firmware wrote survives from one run to the next, as it would
+ * a reboot.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_partition.h"
+#include "esp_spi_flash.h"
+
+#include "sim.h"
+
+#define SIM_STATS_SIZE (64 * 1024)
+
+static const esp_partition_t partitions[] = {
+    { ESP_PARTITION_TYPE_DATA, 0x40, 0x110000, SIM_STATS_SIZE, "stats", false },
+};
+#define SIM_PARTITIONS (sizeof(partitions) / sizeof(partitions[0]))
+
+static uint8_t stats_image[SIM_STATS_SIZE];
+static uint8_t *images[SIM_PARTITIONS] = { stats_image };
+static unsigned long sector_erases[SIM_STATS_SIZE / SPI_FLASH_SEC_SIZE];
+static int erased;
+static sim_flash_stats flash;
+
+
+static void sim_flash_init(void)
+{
+    unsigned i;
+    if (erased)
+        return;
+    for (i = 0; i < SIM_PARTITIONS; i++)
+        memset(images[i], 0xff, partitions[i].size);
+    erased = 1;
+}
+
+static uint8_t *sim_flash_image(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    unsigned i;
+    sim_flash_init();
+    for (i = 0; i < SIM_PARTITIONS; i++) {
+        if (partition == &partitions[i])
+            return offset + size <= partitions[i].size ? images[i] + offset : NULL;
+    }
+    return NULL;
+}
+
+static void sim_flash_busy(uint64_t ns)
+{
+    flash.busy_ns += ns;
+    sim_advance_ns(ns);
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    unsigned i;
+    for (i = 0; i < SIM_PARTITIONS; i++) {
+        if (partitions[i].type == type &&
+            (subtype == ESP_PARTITION_SUBTYPE_ANY || partitions[i].subtype == subtype) &&
+            (label == NULL || strcmp(partitions[i].label, label) == 0))
+            return &partitions[i];
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition,
+                             size_t src_offset, void *dst, size_t size)
+{
+    uint8_t *image = sim_flash_image(partition, src_offset, size);
+    if (image == NULL)
+        return ESP_ERR_INVALID_ARG;
+    memcpy(dst, image, size);
+    flash.reads++;
+    flash.bytes_read += size;
+    sim_flash_busy((uint64_t) size * SIM_FLASH_READ_NS);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition,
+                              size_t dst_offset, const void *src, size_t size)
+{
+    uint8_t *image = sim_flash_image(partition, dst_offset, size);
+    const uint8_t *data = src;
+    size_t i;
+    int overwrite = 0;
+
+    if (image == NULL)
+        return ESP_ERR_INVALID_ARG;
+    for (i = 0; i < size; i++) {
+        if (data[i] & ~image[i])
+            overwrite = 1;
+        image[i] &= data[i];
+    }
+    if (overwrite)
+        flash.overwrites++;
+    flash.writes++;
+    flash.bytes_written += size;
+    sim_flash_busy((uint64_t) size * SIM_FLASH_WRITE_NS);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition,
+                                    size_t start_addr, size_t size)
+{
+    uint8_t *image = sim_flash_image(partition, start_addr, size);
+    size_t sector;
+
+    if (image == NULL || start_addr % SPI_FLASH_SEC_SIZE || size % SPI_FLASH_SEC_SIZE)
+        return ESP_ERR_INVALID_ARG;
+    memset(image, 0xff, size);
+    for (sector = start_addr / SPI_FLASH_SEC_SIZE;
+         sector < (start_addr + size) / SPI_FLASH_SEC_SIZE; sector++) {
+        if (partition == &partitions[0])
+            sector_erases[sector]++;
+        flash.erases++;
+        sim_flash_busy(SIM_FLASH_ERASE_NS);
+    }
+    return ESP_OK;
+}
+
+/* Start from the partitions saved in path, if there is anything there */
+int sim_flash_load(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    unsigned i;
+    int rc = 0;
+
+    sim_flash_init();
+    if (f == NULL)
+        return -1;
+    for (i = 0; i < SIM_PARTITIONS; i++) {
+        if (fread(images[i], 1, partitions[i].size, f) != partitions[i].size)
+            rc = -1;
+    }
+    fclose(f);
+    return rc;
+}
+
+int sim_flash_save(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    unsigned i;
+    int rc = 0;
+
+    if (f == NULL)
+        return -1;
+    sim_flash_init();
+    for (i = 0; i < SIM_PARTITIONS; i++) {
+        if (fwrite(images[i], 1, partitions[i].size, f) != partitions[i].size)
+            rc = -1;
+    }
+    return fclose(f) == 0 ? rc : -1;
+}
+
+/* Erases per sector are of the stats partition */
+void sim_flash_get_stats(sim_flash_stats *stats)
+{
+    size_t i;
+    *stats = flash;
+    stats->sector_erases_min = sector_erases[0];
+    stats->sector_erases_max = sector_erases[0];
+    for (i = 1; i < sizeof(sector_erases) / sizeof(sector_erases[0]); i++) {
+        if (sector_erases[i] < stats->sector_erases_min)
+            stats->sector_erases_min = sector_erases[i];
+        if (sector_erases[i] > stats->sector_erases_max)
+            stats->sector_erases_max = sector_erases[i];
+    }
+}
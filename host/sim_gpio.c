@@ -0,0 +1,362 @@
+/*
+ * GPIO driver for the host simulation
+ *
+ * Output levels are forwarded to every attached TM1638 emulator, inputs
+ * are either driven by an emulator (the key scan data line) or by the
+ * simulation itself through sim_gpio_drive(), which also fires any
+ * installed pin ISR.  Every driver call is charged SIM_GPIO_API_NS of
+ * virtual CPU time and every register access SIM_GPIO_REG_NS.  Edges reach
+ * the emulators stamped with the virtual time they happen at.
+ */
+#include <stdio.h>
+
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+
+#include "sim.h"
+
+#define SIM_GPIO_COUNT 40
+#define SIM_MAX_BOARDS 8
+
+typedef struct {
+    gpio_mode_t mode;
+    uint8_t level;
+    uint8_t input;
+    gpio_int_type_t intr_type;
+    gpio_isr_t isr;
+    void *isr_arg;
+} sim_pin;
+
+static sim_pin pins[SIM_GPIO_COUNT];
+static tm1638_emu *boards[SIM_MAX_BOARDS];
+static int board_count;
+static uint32_t ledc_duty;
+static uint32_t ledc_output;        /* Duty actually being played */
+static uint64_t ledc_on_since;
+static sim_sound_stats sound;
+static uint64_t edge_at;            /* Time for edges from outside a task */
+
+static int valid(gpio_num_t gpio_num)
+{
+    return gpio_num >= 0 && gpio_num < SIM_GPIO_COUNT;
+}
+
+static void charge(uint64_t ns)
+{
+    sim_advance_ns(ns);
+}
+
+void sim_gpio_attach(tm1638_emu *board)
+{
+    if (board_count < SIM_MAX_BOARDS)
+        boards[board_count++] = board;
+}
+
+/* Drive an input pin from outside, e.g. the tilt switch */
+void sim_gpio_drive(int pin, int level)
+{
+    sim_pin *p;
+    int rising, falling;
+    if (!valid(pin))
+        return;
+    p = &pins[pin];
+    level = level ? 1 : 0;
+    rising = level && !p->input;
+    falling = !level && p->input;
+    p->input = level;
+    if (p->isr == NULL)
+        return;
+    /* Level interrupts only fire as the level is reached, the firmware
+     * is expected to change the type in its ISR rather than be retriggered */
+    if ((p->intr_type == GPIO_INTR_ANYEDGE && (rising || falling)) ||
+        ((p->intr_type == GPIO_INTR_POSEDGE || p->intr_type == GPIO_INTR_HIGH_LEVEL) && rising) ||
+        ((p->intr_type == GPIO_INTR_NEGEDGE || p->intr_type == GPIO_INTR_LOW_LEVEL) && falling))
+        p->isr(p->isr_arg);
+}
+
+void gpio_pad_select_gpio(uint8_t gpio_num)
+{
+    (void) gpio_num;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    if (!valid(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+    charge(SIM_GPIO_API_NS);
+    pins[gpio_num].mode = mode;
+    return ESP_OK;
+}
+
+/*
+ * Time driver calls from here on as at ns rather than now, 0 to go back
+ * For callbacks the SPI peripheral makes in its own time
+ */
+void sim_gpio_at(uint64_t ns)
+{
+    edge_at = ns;
+}
+
+static void set_level(int pin, int level)
+{
+    int i;
+    uint64_t ns = edge_at ? edge_at : sim_now_ns();
+    pins[pin].level = level ? 1 : 0;
+    if (pins[pin].mode & GPIO_MODE_OUTPUT) {
+        for (i = 0; i < board_count; i++)
+            tm1638_emu_pin(boards[i], pin, level, ns);
+    }
+}
+
+static int get_level(int pin)
+{
+    int i;
+    for (i = 0; i < board_count; i++) {
+        if (tm1638_emu_drives(boards[i], pin))
+            return tm1638_emu_data_out(boards[i]);
+    }
+    if (pins[pin].mode & GPIO_MODE_OUTPUT)
+        return pins[pin].level;
+    return pins[pin].input;
+}
+
+/* A peripheral (SPI) driving a pin through the GPIO matrix, no CPU cost */
+void sim_gpio_bus_edge(int pin, int level, uint64_t ns)
+{
+    int i;
+    if (!valid(pin))
+        return;
+    pins[pin].level = level ? 1 : 0;
+    for (i = 0; i < board_count; i++)
+        tm1638_emu_pin(boards[i], pin, level, ns);
+}
+
+int sim_gpio_sample(int pin)
+{
+    return valid(pin) ? get_level(pin) : 0;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!valid(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+    charge(SIM_GPIO_API_NS);
+    set_level(gpio_num, level);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (!valid(gpio_num))
+        return 0;
+    charge(SIM_GPIO_API_NS);
+    return get_level(gpio_num);
+}
+
+
+/*
+ * Direct register access for pins 0-31, as used by the display fast path
+ */
+void sim_reg_write(uint32_t reg, uint32_t value)
+{
+    int i;
+    charge(SIM_GPIO_REG_NS);
+    for (i = 0; i < 32; i++) {
+        if (!(value & (1UL << i)))
+            continue;
+        switch (reg) {
+            case GPIO_OUT_W1TS_REG:
+                set_level(i, 1);
+                break;
+            case GPIO_OUT_W1TC_REG:
+                set_level(i, 0);
+                break;
+            case GPIO_ENABLE_W1TS_REG:
+                pins[i].mode |= GPIO_MODE_OUTPUT;
+                break;
+            case GPIO_ENABLE_W1TC_REG:
+                pins[i].mode &= ~GPIO_MODE_OUTPUT;
+                break;
+            default:
+                fprintf(stderr, "sim: write to unsupported register 0x%08x\n", reg);
+                return;
+        }
+    }
+}
+
+uint32_t sim_reg_read(uint32_t reg)
+{
+    int i;
+    uint32_t value = 0;
+    charge(SIM_GPIO_REG_NS);
+    if (reg != GPIO_IN_REG) {
+        fprintf(stderr, "sim: read of unsupported register 0x%08x\n", reg);
+        return 0;
+    }
+    for (i = 0; i < 32; i++)
+        value |= (uint32_t) get_level(i) << i;
+    return value;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull)
+{
+    if (!valid(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+    /* Nothing connected reads as the pull */
+    if (pull == GPIO_PULLUP_ONLY)
+        pins[gpio_num].input = 1;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (!valid(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+    pins[gpio_num].intr_type = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_config(const gpio_config_t *conf)
+{
+    int i;
+    for (i = 0; i < SIM_GPIO_COUNT; i++) {
+        if (conf->pin_bit_mask & (1ULL << i)) {
+            pins[i].mode = conf->mode;
+            pins[i].intr_type = conf->intr_type;
+            if (conf->pull_up_en)
+                pins[i].input = 1;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    (void) intr_alloc_flags;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr, void *args)
+{
+    if (!valid(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+    pins[gpio_num].isr = isr;
+    pins[gpio_num].isr_arg = args;
+    return ESP_OK;
+}
+
+/* Light sleep wakeup takes over the pin's interrupt type, as on the chip */
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (!valid(gpio_num) ||
+        (intr_type != GPIO_INTR_LOW_LEVEL && intr_type != GPIO_INTR_HIGH_LEVEL))
+        return ESP_ERR_INVALID_ARG;
+    pins[gpio_num].intr_type = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    if (!valid(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+    pins[gpio_num].isr = NULL;
+    return ESP_OK;
+}
+
+
+/*
+ * LEDC: nothing to hear on the host, just keep the duty for inspection
+ */
+esp_err_t ledc_timer_config(const ledc_timer_config_t *timer_conf)
+{
+    (void) timer_conf;
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *ledc_conf)
+{
+    ledc_duty = ledc_conf->duty;
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty)
+{
+    (void) speed_mode;
+    (void) channel;
+    ledc_duty = duty;
+    return ESP_OK;
+}
+
+static void ledc_output_duty(uint32_t duty)
+{
+    if (duty && !ledc_output) {
+        sound.notes++;
+        ledc_on_since = sim_now_ns();
+    } else if (!duty && ledc_output) {
+        sound.on_ns += sim_now_ns() - ledc_on_since;
+    }
+    ledc_output = duty;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    (void) speed_mode;
+    (void) channel;
+    charge(SIM_GPIO_API_NS);
+    ledc_output_duty(ledc_duty);
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_freq(ledc_mode_t speed_mode, ledc_timer_t timer_num, uint32_t freq_hz)
+{
+    (void) speed_mode;
+    (void) timer_num;
+    charge(SIM_GPIO_API_NS);
+    sound.freq_changes++;
+    sound.last_freq = freq_hz;
+    return ESP_OK;
+}
+
+esp_err_t ledc_fade_func_install(int intr_alloc_flags)
+{
+    (void) intr_alloc_flags;
+    return ESP_OK;
+}
+
+/* Fades run in hardware, the note is counted as playing until it is stopped */
+esp_err_t ledc_set_fade_with_time(ledc_mode_t speed_mode, ledc_channel_t channel,
+                                  uint32_t target_duty, int max_fade_time_ms)
+{
+    (void) speed_mode;
+    (void) channel;
+    (void) max_fade_time_ms;
+    ledc_duty = target_duty;
+    return ESP_OK;
+}
+
+esp_err_t ledc_fade_start(ledc_mode_t speed_mode, ledc_channel_t channel,
+                          ledc_fade_mode_t fade_mode)
+{
+    (void) speed_mode;
+    (void) channel;
+    (void) fade_mode;
+    charge(SIM_GPIO_API_NS);
+    sound.fades++;
+    return ESP_OK;
+}
+
+void sim_sound_get_stats(sim_sound_stats *stats)
+{
+    *stats = sound;
+    if (ledc_output)
+        stats->on_ns += sim_now_ns() - ledc_on_since;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    (void) speed_mode;
+    (void) channel;
+    return ledc_duty;
+}
@@ -0,0 +1,1411 @@
+/*
+ * Host simulation driver
+ *
+ *   countdown_sim [--seed N] [--log LEVEL] [--transport bb|spi] [--service]
+ *                 [--unicore] [--flash FILE] [--trace] [--profile] [--baseline FILE]
+ *                 [--update-baseline]
+ *                 [game | idle | timeup [N] | bench [N] | busbench [N] | microbench [N]
+ *                  | chain [N] | solver [N] | selfplay | replay FILE | soak [N] | cores
+ *                  | stats [N] | mirror | budget | boot
+ *                  | latency [N] | sessions [N]]
+ *
+ * game     - play a scripted, winning game1(60) against the emulated board
+ * idle     - run app_main, wait for the tilt switch to arm and knock it
+ * timeup   - leave game1(N) alone and time the countdown and the end sweep
+ * bench    - time back-to-back display_timer()/update_display() refreshes
+ * busbench - bus_bench(): bytes/s through the GPIO driver and register path
+ * microbench - per function costs checked against --baseline, see microbench.h
+ * chain    - bus time per refresh with 1 to DISPLAY_MAX_BOARDS chained boards
+ * solver   - codes scored per second, and N games solved under both rules
+ * selfplay - a game won with the hint button, then attract mode for a while
+ * replay   - replay the session log in FILE, "SL" lines as session_dump() prints
+ * soak     - N games of random presses recorded, then each replayed and checked
+ * cores    - the scripted game with every service running, then how busy each
+ *            core was and how late the game loop got round to its refreshes
+ * stats    - log N made up games to flash, then read the totals back as at boot
+ * mirror   - the scripted game streamed to two WebSocket viewers over loopback,
+ *            one slow to answer, with the bytes a minute it took
+ * budget   - the scripted game with every service, then task_stack_print()
+ * boot     - run app_main, times to the splash and to ready, see boot.h
+ * latency  - a game of presses held and spaced for odd times, then the press
+ *            to display latency of each button, fails over LATENCY_TARGET_MS
+ * sessions - N games off the board on one executor for a virtual minute, each
+ *            with a scripted player, then the host time per session
+ *
+ * --service runs the display service task as app_main does.
+ * --unicore runs every task on one core, as CONFIG_FREERTOS_UNICORE would.
+ * --flash keeps the flash partitions in FILE from one run to the next.
+ * --trace prints trace_dump() at the end, for trace_decode.
+ * --profile prints profile_dump() at the end, through the console in idle.
+ * --session prints session_dump() at the end, the log of the last game.
+ *
+ * game and bench report bus edges per frame, the modelled device CPU time
+ * per frame (see the SIM_*_NS costs in sim.h) and host frames per second.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "7_seg_ui.h"
+#include "7_seg_spi.h"
+#include "bus_bench.h"
+#include "display_service.h"
+#include "input_service.h"
+#include "tilt.h"
+#include "power.h"
+#include "sound.h"
+#include "animation.h"
+#include "trace.h"
+#include "profile.h"
+#include "sim.h"
+#include "microbench.h"
+#include "mastermind.h"
+#include "session.h"
+#include "stats_log.h"
+#include "display_mirror.h"
+#include "tasks.h"
+#include "boot.h"
+#include "latency.h"
+#include "game.h"
+#include "executor.h"
+#include "lwip/sockets.h"
+
+/* Firmware globals from main.c */
+extern seven_segment_ui *display;
+extern const int strobe_pin;
+extern const int clock_pin;
+extern const int data_pin;
+extern game_session board_game;
+extern const int tilt_pin;
+extern const int beep_pin;
+extern const int beep_gnd;
+extern void game1(unsigned int count_from);
+extern void attract(void);
+extern void app_main(void);
+
+static tm1638_emu board;
+static uint64_t zero_ns;
+static display_service *service;
+static uint64_t frames;
+static uint64_t busy_start_ns;
+
+/* Count frames: linked with -Wl,--wrap=update_display */
+extern void __real_update_display(seven_segment_ui *display);
+void __wrap_update_display(seven_segment_ui *display)
+{
+    seven_segment_ui probe = *display;
+
+    /* Note when the timer first shows 00:00 */
+    display_timer(&probe, 0);
+    if (zero_ns == 0 &&
+        memcmp(probe.display_buffer, display->display_buffer, DISPLAY_BUFFER_LENGTH) == 0)
+        zero_ns = sim_now_ns();
+    frames++;
+    __real_update_display(display);
+}
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void press(uint8_t keys)
+{
+    tm1638_emu_set_keys(&board, keys);
+    sim_run_ms(100);
+    tm1638_emu_set_keys(&board, 0x00);
+    sim_run_ms(100);
+}
+
+/* Plays the part of the player: start the game, dial in the secret, check */
+static void player_task(void *pvParameters)
+{
+    int i, n;
+    (void) pvParameters;
+    sim_run_ms(500);
+    press(0x80);
+    for (i = 0; i < 4; i++) {
+        for (n = 0; n < board_game.secret[i]; n++)
+            press(0x80 >> i);
+    }
+    press(0x01);
+    vTaskDelete(NULL);
+}
+
+static void report(const char *title, uint64_t start_ns, double wall)
+{
+    char text[9];
+    uint8_t leds;
+    double f = frames ? (double) frames : 1.0;
+    double bus_us = (sim_busy_ns() - busy_start_ns) / 1000.0 / f;
+    sim_sound_stats sound;
+
+    tm1638_emu_render(&board, text, &leds);
+    printf("%s, %s transport\n", title, display->transport->name);
+    printf("  virtual time      : %.3f s\n", (sim_now_ns() - start_ns) / 1e9);
+    printf("  frames            : %llu\n", (unsigned long long) frames);
+    printf("  bus edges         : %llu (%.1f / frame)\n",
+           (unsigned long long) board.edges, board.edges / f);
+    printf("  bus sessions      : %llu (%.1f / frame)\n",
+           (unsigned long long) board.sessions, board.sessions / f);
+    printf("  display writes    : %llu bytes, key reads: %llu bytes\n",
+           (unsigned long long) board.bytes_written,
+           (unsigned long long) board.bytes_read);
+    printf("  driver bytes      : %lu sent, %lu saved by dirty tracking\n",
+           display->bytes_sent, display->bytes_saved);
+    printf("  modelled CPU time : %.1f us / frame (max %.0f frames/s)\n",
+           bus_us, bus_us > 0 ? 1e6 / bus_us : 0.0);
+    printf("  host              : %.3f s wall, %.0f frames/s\n",
+           wall, wall > 0 ? frames / wall : 0.0);
+    if (service)
+        printf("  display service   : %lu published, %lu presented, %lu superseded\n",
+               service->published, service->presented, service->superseded);
+    sim_sound_get_stats(&sound);
+    printf("  sound             : %lu notes, %lu fades, %.3f s on, %lu dropped\n",
+           sound.notes, sound.fades, sound.on_ns / 1e9, sound_dropped());
+    printf("  display           : \"%s\" leds 0x%02x\n", text, leds);
+    if (board.protocol_errors)
+        printf("  PROTOCOL ERRORS   : %llu\n", (unsigned long long) board.protocol_errors);
+    if (board.timing_errors)
+        printf("  TIMING ERRORS     : %llu, first %s\n",
+               (unsigned long long) board.timing_errors, board.timing_error);
+}
+
+static void reset_counters(void)
+{
+    frames = 0;
+    busy_start_ns = sim_busy_ns();
+    tm1638_emu_reset_stats(&board);
+    display->bytes_sent = 0;
+    display->bytes_saved = 0;
+    if (service) {
+        service->published = 0;
+        service->presented = 0;
+        service->superseded = 0;
+    }
+}
+
+static int run_game(void)
+{
+    uint64_t start_ns;
+    double wall = wall_seconds();
+
+    reset_counters();
+    start_ns = sim_now_ns();
+    xTaskCreate(player_task, "player", 2048, NULL, 5, NULL);
+    game1(60);
+    /* Let a display service catch up with the last frame */
+    sim_run_ms(100);
+    wall = wall_seconds() - wall;
+    report("game1(60), scripted win", start_ns, wall);
+    return board.protocol_errors ? 1 : 0;
+}
+
+static void app_main_task(void *pvParameters)
+{
+    (void) pvParameters;
+    app_main();
+}
+
+/* Knock the tilt switch, it bounces open and closed */
+static void knock(void)
+{
+    sim_gpio_drive(tilt_pin, 0);
+    sim_run_ms(3);
+    sim_gpio_drive(tilt_pin, 1);
+    sim_run_ms(2);
+    sim_gpio_drive(tilt_pin, 0);
+    sim_run_ms(20);
+    sim_gpio_drive(tilt_pin, 1);
+}
+
+static void report_power(const char *title, const power_stats *fa, const power_stats *fb,
+                         const sim_pm_stats *a, const sim_pm_stats *b)
+{
+    int i;
+    power_stats delta;
+    double span = (double) (b->busy_max_ns - a->busy_max_ns) + (b->busy_min_ns - a->busy_min_ns) +
+                  (b->idle_ns - a->idle_ns) + (b->sleep_ns - a->sleep_ns);
+    double minutes = span / 60e9;
+    if (span <= 0)
+        return;
+    delta.uptime = fb->uptime - fa->uptime;
+    delta.wakeups = fb->wakeups - fa->wakeups;
+    for (i = 0; i < POWER_STATES; i++)
+        delta.time[i] = fb->time[i] - fa->time[i];
+    printf("  %-18s: %.1f s\n", title, span / 1e9);
+    printf("    power states    : idle %.1f%%, sound %.2f%%, bus %.2f%%, game %.1f%% "
+           "(locks held)\n",
+           100.0 * delta.time[POWER_IDLE] / delta.uptime,
+           100.0 * delta.time[POWER_SOUND] / delta.uptime,
+           100.0 * delta.time[POWER_BUS] / delta.uptime,
+           100.0 * delta.time[POWER_GAME] / delta.uptime);
+    printf("    CPU             : busy %.3f%% at %d MHz, %.3f%% at %d MHz, awake idle %.2f%%, "
+           "light sleep %.2f%%\n",
+           100.0 * (b->busy_max_ns - a->busy_max_ns) / span, b->max_mhz,
+           100.0 * (b->busy_min_ns - a->busy_min_ns) / span, b->min_mhz,
+           100.0 * (b->idle_ns - a->idle_ns) / span, 100.0 * (b->sleep_ns - a->sleep_ns) / span);
+    printf("    wakeups         : %.0f / minute from sleep, %.0f / minute counted by tasks\n",
+           (b->sleeps - a->sleeps) / minutes, delta.wakeups / (delta.uptime / 60e6));
+}
+
+static int run_idle(void)
+{
+    uint64_t start_ns = sim_now_ns();
+    unsigned long idle_wakeups;
+    double wall = wall_seconds();
+    sim_pm_stats pm_start, pm_idle, pm_end;
+    power_stats fw_start, fw_idle, fw_end;
+
+    /* The switch is closed at rest, held up by the pull-up */
+    sim_gpio_drive(tilt_pin, 1);
+    xTaskCreate(app_main_task, "app_main", 4096, NULL, 1, NULL);
+    sim_run_ms(1000);
+    service = display->service;
+    reset_counters();
+    sim_pm_get_stats(&pm_start);
+    power_get_stats(&fw_start);
+    /* Moved before arming, which puts arming back */
+    sim_run_ms(9000);
+    knock();
+    sim_run_ms(50000);
+    idle_wakeups = sim_task_wakeups("app_main");
+    sim_pm_get_stats(&pm_idle);
+    power_get_stats(&fw_idle);
+    /* Armed now, so this starts a 60-119s countdown that runs out */
+    knock();
+    sim_run_ms(140000);
+    sim_pm_get_stats(&pm_end);
+    power_get_stats(&fw_end);
+    wall = wall_seconds() - wall;
+    report("app_main, tilt to start", start_ns, wall);
+    printf("  app_main wakeups  : %lu in the first minute idle, %lu in total\n",
+           idle_wakeups, sim_task_wakeups("app_main"));
+    printf("  input dropped     : %lu, tilt overruns: %lu\n",
+           input_dropped(), tilt_overruns());
+    report_power("idle, waiting", &fw_start, &fw_idle, &pm_start, &pm_idle);
+    report_power("game and after", &fw_idle, &fw_end, &pm_idle, &pm_end);
+    return board.protocol_errors ? 1 : 0;
+}
+
+/* Start up as on the device, to the splash and then to ready */
+static int run_boot(void)
+{
+    sim_gpio_drive(tilt_pin, 1);
+    xTaskCreate(app_main_task, "app_main", 4096, NULL, 1, NULL);
+    sim_run_ms(1000);
+    printf("boot, app_main from start up\n");
+    printf("  to first frame    : %.3f ms\n", boot_time(BOOT_FIRST_FRAME) / 1e3);
+    printf("  to ready          : %.3f ms\n", boot_time(BOOT_READY) / 1e3);
+    return boot_time(BOOT_READY) < 0 || board.protocol_errors ? 1 : 0;
+}
+
+static int run_timeup(unsigned long count)
+{
+    uint64_t start_ns, end_ns;
+    double wall = wall_seconds();
+
+    reset_counters();
+    start_ns = sim_now_ns();
+    zero_ns = 0;
+    game1((unsigned int) count);
+    end_ns = sim_now_ns();
+    sim_run_ms(100);
+    wall = wall_seconds() - wall;
+    report("game1, left to run out", start_ns, wall);
+    /* From when the game started its clock, on the tick after game1() */
+    printf("  countdown         : %lu s requested, %.3f s measured\n",
+           count, zero_ns ? (zero_ns - board_game.started * 1000) / 1e9 : 0.0);
+    printf("  end of game sweep : %.3f s\n",
+           zero_ns ? (end_ns - zero_ns) / 1e9 : 0.0);
+    return board.protocol_errors ? 1 : 0;
+}
+
+static int run_bench(unsigned long count)
+{
+    unsigned long i;
+    uint64_t start_ns;
+    double wall;
+
+    reset_counters();
+    start_ns = sim_now_ns();
+    wall = wall_seconds();
+    for (i = 0; i < count; i++) {
+        display_timer(display, (int) (i % 3600));
+        update_display(display);
+    }
+    sim_run_ms(100);
+    wall = wall_seconds() - wall;
+    report("display_timer + update_display", start_ns, wall);
+    return board.protocol_errors ? 1 : 0;
+}
+
+static int run_busbench(unsigned long count)
+{
+    int i, n;
+    bus_bench_result results[BUS_BENCH_PATHS];
+    double wall = wall_seconds();
+
+    n = bus_bench(display, (int) count, results);
+    wall = wall_seconds() - wall;
+    printf("bus_bench, %lu frames and key scans per path (modelled device time)\n", count);
+    for (i = 0; i < n; i++)
+        printf("  %-8s write %8lu bytes/s   read %8lu bytes/s\n", results[i].path,
+               results[i].write_bytes_per_sec, results[i].read_bytes_per_sec);
+    printf("  host              : %.3f s wall\n", wall);
+    return board.protocol_errors ? 1 : 0;
+}
+
+/* Strobes of the extra boards in chain mode, board 0 is the usual one */
+static const uint8_t chain_strobes[] = {SEVEN_SEG_STROBE_PIN, 13, 25, 26};
+static tm1638_emu chained[DISPLAY_MAX_BOARDS - 1];
+
+/*
+ * One chain of every board, with the first n boards' digits all changing
+ * each refresh, then only their last digit.  Boards past n don't change
+ * so cost nothing, as with n boards on their own.
+ */
+static int run_chain(unsigned long count, const seven_segment_transport *transport)
+{
+    seven_segment_ui *chain;
+    tm1638_emu *emu;
+    char text[DISPLAY_MAX_DIGITS + 1];
+    unsigned long i;
+    uint64_t busy, bytes;
+    double all_us, one_us;
+    int n, b, d, wrong = 0;
+
+    for (b = 1; b < DISPLAY_MAX_BOARDS; b++) {
+        tm1638_emu_init(&chained[b - 1], chain_strobes[b], clock_pin, data_pin);
+        sim_gpio_attach(&chained[b - 1]);
+    }
+    chain = display_setup_chain(chain_strobes, DISPLAY_MAX_BOARDS, clock_pin, data_pin,
+                                0x01, transport);
+    if (chain == NULL)
+        return 1;
+    display = chain;
+    printf("chained boards, %lu refreshes each, %s transport (modelled device time)\n",
+           count, transport->name);
+    printf("  boards   all digits change         last digit changes\n");
+    for (n = 1; n <= DISPLAY_MAX_BOARDS; n++) {
+        busy = sim_busy_ns();
+        bytes = chain->bytes_sent;
+        for (i = 0; i < count; i++) {
+            for (d = 0; d < n * DISPLAY_DIGITS; d++)
+                text[d] = '0' + (i + d) % 10;
+            text[d] = '\0';
+            display_text(chain, 0, n * DISPLAY_DIGITS, text);
+            update_display(chain);
+        }
+        all_us = (sim_busy_ns() - busy) / 1000.0 / count;
+        bytes = chain->bytes_sent - bytes;
+        busy = sim_busy_ns();
+        for (i = 0; i < count; i++) {
+            text[n * DISPLAY_DIGITS - 1] = '0' + i % 10;
+            display_text(chain, 0, n * DISPLAY_DIGITS, text);
+            update_display(chain);
+        }
+        one_us = (sim_busy_ns() - busy) / 1000.0 / count;
+        /* Every board must show its part */
+        for (b = 0; b < n; b++) {
+            emu = b ? &chained[b - 1] : &board;
+            if (memcmp(emu->ram, &chain->display_buffer[b * DISPLAY_BUFFER_LENGTH],
+                       DISPLAY_BUFFER_LENGTH) != 0)
+                wrong++;
+        }
+        printf("  %6d   %7.1f us %5.1f bytes   %7.1f us\n", n, all_us,
+               (double) bytes / count, one_us);
+    }
+    for (b = 0; b < DISPLAY_MAX_BOARDS; b++) {
+        emu = b ? &chained[b - 1] : &board;
+        if (emu->protocol_errors)
+            wrong++;
+    }
+    if (wrong)
+        printf("  WRONG: %d boards not showing their frame or with protocol errors\n", wrong);
+    return wrong ? 1 : 0;
+}
+
+/* Host scoring rate, rules against the opening for count codes */
+static double scoring_rate(mastermind_rules rules, unsigned long count)
+{
+    unsigned long i;
+    unsigned int total = 0;
+    double wall = wall_seconds();
+    for (i = 0; i < count; i++)
+        total += code_score(rules, MASTERMIND_OPENING,
+                            (uint16_t) ((i % 10) | (i / 10 % 10) << 4 |
+                                        (i / 100 % 10) << 8 | (i / 1000 % 10) << 12));
+    wall = wall_seconds() - wall;
+    /* Keep the work */
+    if (total == 0)
+        printf("  no scores\n");
+    return wall > 0 ? count / wall : 0.0;
+}
+
+/*
+ * Play count games against random secrets, a solver_step() of
+ * SOLVER_FRAME_CODES at a time as the game loop does.  Reports guesses
+ * to win, the passes needed to come up with a guess and the host time
+ * each pass took.
+ */
+static int solve_games(mastermind_rules rules, const char *name, unsigned long count)
+{
+    static solver s;
+    unsigned long game, guesses = 0, max_guesses = 0, passes = 0, max_passes = 0;
+    unsigned long n, work = 0;
+    uint16_t secret_code, guess;
+    uint8_t response, solved = rules == MASTERMIND_COUNTS ?
+        MASTERMIND_SOLVED_COUNTS : MASTERMIND_SOLVED_POSITIONS;
+    double pass, max_pass = 0, total_pass = 0;
+    unsigned long all_passes = 0;
+    int wrong = 0;
+
+    for (game = 0; game < count; game++) {
+        secret_code = (uint16_t) ((esp_random() % 10) << 12 | (esp_random() % 10) << 8 |
+                                  (esp_random() % 10) << 4 | esp_random() % 10);
+        solver_start(&s, rules);
+        for (n = 1; ; n++) {
+            guess = solver_guess(&s);
+            response = code_score(rules, guess, secret_code);
+            if (response == solved)
+                break;
+            solver_response(&s, guess, response);
+            /* Passes of the game loop until the next guess is ready */
+            passes = 0;
+            do {
+                pass = wall_seconds();
+                solver_step(&s, SOLVER_FRAME_CODES);
+                pass = wall_seconds() - pass;
+                if (pass > max_pass)
+                    max_pass = pass;
+                total_pass += pass;
+                passes++;
+            } while (s.state == SOLVER_FILTERING || s.state == SOLVER_SEARCHING);
+            if (passes > max_passes)
+                max_passes = passes;
+            all_passes += passes;
+            if (s.state != SOLVER_READY || n == 20) {
+                wrong++;
+                break;
+            }
+        }
+        guesses += n;
+        if (n > max_guesses)
+            max_guesses = n;
+        work += s.work;
+    }
+    printf("  %-9s %5.2f guesses (max %2lu)  %7.0f codes / game  "
+           "max %3lu passes / guess  %4.0f us / pass (max %4.0f)\n", name,
+           (double) guesses / count, max_guesses, (double) work / count,
+           max_passes, all_passes ? total_pass * 1e6 / all_passes : 0.0, max_pass * 1e6);
+    if (wrong)
+        printf("  WRONG: %d %s games not solved\n", wrong, name);
+    return wrong;
+}
+
+static int run_solver(unsigned long count)
+{
+    int wrong;
+
+    printf("solver, %lu games each, %d codes per pass (host time)\n", count,
+           SOLVER_FRAME_CODES);
+    printf("  scoring   %.1f M codes/s counts, %.1f M codes/s positions\n",
+           scoring_rate(MASTERMIND_COUNTS, 10000000) / 1e6,
+           scoring_rate(MASTERMIND_POSITIONS, 10000000) / 1e6);
+    wrong = solve_games(MASTERMIND_COUNTS, "counts", count);
+    wrong += solve_games(MASTERMIND_POSITIONS, "positions", count);
+    return wrong ? 1 : 0;
+}
+
+/* Ask for a hint and check it until the game is won */
+static void hinted_player_task(void *pvParameters)
+{
+    int n;
+    (void) pvParameters;
+    sim_run_ms(500);
+    press(0x80);
+    for (n = 1; n <= 20; n++) {
+        /* Give the solver time to think */
+        sim_run_ms(1000);
+        press(0x02);
+        press(0x01);
+        if ((display->flash & 0xf0) == 0x00)
+            break;
+    }
+    printf("  hinted game       : %s after %d hints\n",
+           (display->flash & 0xf0) == 0x00 ? "won" : "LOST", n);
+    vTaskDelete(NULL);
+}
+
+/* Let attract mode play for a while, then stop it */
+static void attract_stopper_task(void *pvParameters)
+{
+    (void) pvParameters;
+    sim_run_ms(60000);
+    press(0x01);
+    vTaskDelete(NULL);
+}
+
+static int run_selfplay(void)
+{
+    uint64_t start_ns;
+    profile_stats stats;
+
+    profile_reset();
+    start_ns = sim_now_ns();
+    xTaskCreate(hinted_player_task, "player", 2048, NULL, 5, NULL);
+    game1(600);
+    printf("  game              : %.3f s virtual\n", (sim_now_ns() - start_ns) / 1e9);
+    start_ns = sim_now_ns();
+    xTaskCreate(attract_stopper_task, "stopper", 2048, NULL, 5, NULL);
+    attract();
+    printf("  attract mode      : %.3f s virtual, stopped by a key\n",
+           (sim_now_ns() - start_ns) / 1e9);
+    profile_get_stats(PROFILE_SOLVER_STEP, &stats);
+    printf("  solver_step       : %lu passes\n", (unsigned long) stats.count);
+    return board.protocol_errors ? 1 : 0;
+}
+
+/* Read the "SL" lines of a serial capture into log, returns its length */
+static size_t read_session(const char *path, uint8_t *log, size_t size)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    const char *p;
+    unsigned int byte;
+    size_t length = 0;
+
+    if (f == NULL) {
+        perror(path);
+        return 0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "SL ", 3) != 0)
+            continue;
+        for (p = line + 3; length < size && sscanf(p, "%2x", &byte) == 1; p += 2)
+            log[length++] = (uint8_t) byte;
+    }
+    fclose(f);
+    return length;
+}
+
+/* Game length as recorded at the start of a session log */
+static unsigned int session_count_from(const uint8_t *log, size_t length)
+{
+    unsigned int count = 0;
+    size_t pos = 1;
+    int shift = 0;
+
+    if (length < 2 || log[0] != SESSION_START)
+        return 0;
+    /* Skip the time, then the length */
+    while (pos < length && (log[pos] & 0x80))
+        pos++;
+    for (pos++; pos < length; pos++, shift += 7) {
+        count |= (unsigned int) (log[pos] & 0x7f) << shift;
+        if (!(log[pos] & 0x80))
+            break;
+    }
+    return count;
+}
+
+static int replay_session(const uint8_t *log, size_t length, session_stats *stats)
+{
+    session_replay(log, length);
+    game1(session_count_from(log, length));
+    session_get_stats(stats);
+    return stats->mismatches || stats->missing ? 1 : 0;
+}
+
+static int run_replay(const char *path)
+{
+    static uint8_t log[SESSION_LOG_SIZE];
+    size_t length = read_session(path, log, sizeof(log));
+    session_stats stats;
+    uint64_t start_ns = sim_now_ns();
+    double wall = wall_seconds();
+    int rc;
+
+    if (length == 0) {
+        fprintf(stderr, "no session log in %s\n", path);
+        return 1;
+    }
+    rc = replay_session(log, length, &stats);
+    wall = wall_seconds() - wall;
+    printf("replay of %s, %u bytes, game1(%u)\n", path, (unsigned) length,
+           session_count_from(log, length));
+    printf("  records           : %lu replayed, %lu mismatches, %lu missing\n",
+           stats.records, stats.mismatches, stats.missing);
+    printf("  time              : %.3f s virtual, %.3f s wall (%.0fx real time)\n",
+           (sim_now_ns() - start_ns) / 1e9, wall,
+           wall > 0 ? (sim_now_ns() - start_ns) / 1e9 / wall : 0.0);
+    return rc;
+}
+
+static volatile int soak_playing;
+static uint32_t soak_seed;
+/* From --seed, so parallel soaks can play different games */
+static uint32_t seed;
+
+static uint32_t soak_rand(void)
+{
+    soak_seed = soak_seed * 1103515245 + 12345;
+    return soak_seed >> 8;
+}
+
+/* Presses anything at random times, now and then the right code */
+static void random_player_task(void *pvParameters)
+{
+    int i, n;
+    uint32_t r;
+    (void) pvParameters;
+    while (soak_playing) {
+        sim_run_ms(soak_rand() % 2000);
+        if (!soak_playing)
+            break;
+        r = soak_rand() % 100;
+        if (r < 60) {
+            press(0x80 >> (soak_rand() % 4));
+        } else if (r < 80) {
+            press(0x01);
+        } else if (r < 90) {
+            press(0x02);
+        } else {
+            for (i = 0; i < 4; i++)
+                for (n = 0; n < (board_game.secret[i] + 10 - display->display_buffer[2 * i]) % 10 && n < 10; n++)
+                    press(0x80 >> i);
+            press(0x01);
+        }
+    }
+    soak_playing = -1;
+    vTaskDelete(NULL);
+}
+
+/*
+ * Record count games of random presses through the full stack, then
+ * replay each as the replay mode does and check the replay saw the same
+ * display at every button and at the end
+ */
+static int run_soak(unsigned long count)
+{
+    static uint8_t log[SESSION_LOG_SIZE];
+    const uint8_t *recorded;
+    uint8_t *logs = NULL, *grown;
+    size_t *lengths, length, total = 0, longest = 0;
+    session_stats stats;
+    TaskHandle_t input_task;
+    int rc;
+    unsigned long game, failed = 0, records = 0;
+    uint64_t start_ns = sim_now_ns(), replay_ns;
+    double wall = wall_seconds(), replay_wall;
+
+    lengths = malloc(count * sizeof(*lengths));
+    if (lengths == NULL && count)
+        return 2;
+    for (game = 0; game < count; game++) {
+        soak_seed = (uint32_t) game * 2654435761u + seed + 1;
+        soak_playing = 1;
+        xTaskCreate(random_player_task, "player", 2048, NULL, 5, NULL);
+        game1(10 + soak_rand() % 51);
+        soak_playing = 0;
+        while (soak_playing == 0)
+            sim_run_ms(10);
+
+        length = session_log(&recorded);
+        grown = realloc(logs, total + length);
+        if (grown == NULL) {
+            free(logs);
+            free(lengths);
+            return 2;
+        }
+        logs = grown;
+        memcpy(logs + total, recorded, length);
+        lengths[game] = length;
+        total += length;
+        if (length > longest)
+            longest = length;
+    }
+
+    /* Replays take their buttons from the log, so without the input
+     * service scanning the keys all the while */
+    input_task = xTaskGetHandle("input");
+    if (input_task)
+        vTaskSuspend(input_task);
+    replay_wall = wall_seconds();
+    replay_ns = sim_now_ns();
+    for (game = 0, length = 0; game < count; length += lengths[game++]) {
+        memcpy(log, logs + length, lengths[game]);
+        rc = replay_session(log, lengths[game], &stats);
+        if (rc) {
+            if (failed++ == 0)
+                printf("  game %lu diverged on replay: %lu mismatches, %lu missing\n",
+                       game, stats.mismatches, stats.missing);
+        }
+        records += stats.records;
+    }
+    replay_ns = sim_now_ns() - replay_ns;
+    replay_wall = wall_seconds() - replay_wall;
+    wall = wall_seconds() - wall;
+    free(logs);
+    free(lengths);
+
+    printf("soak, %lu games recorded and replayed\n", count);
+    printf("  session logs      : %.0f bytes mean, %u max, %lu records replayed\n",
+           count ? (double) total / count : 0.0, (unsigned) longest, records);
+    printf("  time              : %.1f s virtual, %.3f s wall (%.0fx real time)\n",
+           (sim_now_ns() - start_ns) / 1e9, wall,
+           wall > 0 ? (sim_now_ns() - start_ns) / 1e9 / wall : 0.0);
+    printf("  replays           : %.1f s virtual, %.3f s wall (%.0fx real time, %.0f games/s)\n",
+           replay_ns / 1e9, replay_wall, replay_wall > 0 ? replay_ns / 1e9 / replay_wall : 0.0,
+           replay_wall > 0 ? count / replay_wall : 0.0);
+    printf("  replays diverged  : %lu\n", failed);
+    return failed || board.protocol_errors ? 1 : 0;
+}
+
+static int unicore;
+
+static int run_cores(void)
+{
+    char stats[1024];
+    profile_stats late;
+    uint64_t start_ns, elapsed_ns, busy[SIM_CORES];
+    int c;
+
+    for (c = 0; c < SIM_CORES; c++)
+        busy[c] = sim_core_busy_ns(c);
+    profile_reset();
+    start_ns = sim_now_ns();
+    xTaskCreate(player_task, "player", 2048, NULL, 5, NULL);
+    game1(60);
+    elapsed_ns = sim_now_ns() - start_ns;
+
+    printf("cores, game1(60) scripted win, %s, display refreshed %s\n",
+           unicore ? "every task on one core" : "layout as in main.c",
+           service ? "by its service" : "from the game loop");
+    for (c = 0; c < (unicore ? 1 : SIM_CORES); c++)
+        printf("  core %d busy       : %.1f %% (%.3f s of %.3f s)\n", c,
+               (sim_core_busy_ns(c) - busy[c]) * 100.0 / elapsed_ns,
+               (sim_core_busy_ns(c) - busy[c]) / 1e9, elapsed_ns / 1e9);
+    c = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ;
+    profile_get_stats(PROFILE_GAME_LATENESS, &late);
+    if (late.count) {
+        printf("  refresh lateness  : %u us min, %.0f us mean, %u us max over %u refreshes\n",
+               (unsigned) late.min / c, (double) late.total / late.count / c,
+               (unsigned) late.max / c, (unsigned) late.count);
+        printf("  game loop jitter  : %u us\n", (unsigned) (late.max - late.min) / c);
+    }
+    profile_get_stats(PROFILE_GAME_LOOP, &late);
+    if (late.count)
+        printf("  game loop         : %.1f us min, %.1f us mean, %.1f us max over %u passes\n",
+               (double) late.min / c, (double) late.total / late.count / c,
+               (double) late.max / c, (unsigned) late.count);
+    vTaskGetRunTimeStats(stats);
+    printf("  CPU time per task since start, us and %% of elapsed:\n%s", stats);
+    return board.protocol_errors ? 1 : 0;
+}
+
+/* The log's own totting up, done again independently */
+static void stats_expect(stats_summary *summary, const stats_game *game)
+{
+    unsigned bucket = game->duration_ms / 1000 / STATS_HIST_SECONDS;
+    summary->games++;
+    summary->hints += game->hints;
+    if (game->outcome == STATS_CORRECT) {
+        summary->wins++;
+        summary->guesses += game->guesses;
+        summary->solve_ms += game->duration_ms;
+        summary->solve_hist[bucket < STATS_HIST_BUCKETS ? bucket : STATS_HIST_BUCKETS - 1]++;
+    }
+}
+
+static void print_summary(const char *title, const stats_summary *summary)
+{
+    printf("  %-18s: %u games, %u won, median win %.1f s, mean win %.1f s, %.1f guesses a win\n",
+           title, (unsigned) summary->games, (unsigned) summary->wins,
+           stats_median_solve_ms(summary) / 1e3,
+           summary->wins ? summary->solve_ms / 1e3 / summary->wins : 0.0,
+           summary->wins ? (double) summary->guesses / summary->wins : 0.0);
+}
+
+/* Games a second apart, like a very keen player, then a reboot's read back */
+static int run_stats(unsigned long count)
+{
+    stats_summary boot, expect, loaded, written;
+    stats_game game;
+    sim_flash_stats flash;
+    uint64_t start_ns, stall_ns, read;
+    unsigned long i, waits = 0;
+    int rc = 0;
+
+    stats_log_get_summary(&boot);
+    printf("stats, %lu games logged\n", count);
+    print_summary("at boot", &boot);
+    expect = boot;
+    for (i = 0; i < count; i++) {
+        memset(&game, 0, sizeof(game));
+        game.count_from = 60;
+        game.outcome = esp_random() % 3 ? STATS_CORRECT : STATS_TIMEUP;
+        game.duration_ms = game.outcome == STATS_CORRECT ? 5000 + esp_random() % 55000 : 60000;
+        game.guesses = 1 + esp_random() % 12;
+        game.hints = esp_random() % 3;
+        while (!stats_log_game(&game)) {
+            waits++;
+            sim_run_ms(STATS_BATCH_MS);
+        }
+        stats_expect(&expect, &game);
+        sim_run_ms(1000);
+    }
+    while (stats_log_pending())
+        sim_run_ms(STATS_BATCH_MS);
+
+    stats_log_get_summary(&written);
+    sim_flash_get_stats(&flash);
+    stall_ns = flash.busy_ns;
+    read = flash.bytes_read;
+    start_ns = sim_now_ns();
+    stats_log_load(&loaded);
+    sim_flash_get_stats(&flash);
+    print_summary("written", &written);
+    print_summary("read back", &loaded);
+    printf("  read back took    : %.2f ms, %llu bytes\n", (sim_now_ns() - start_ns) / 1e6,
+           (unsigned long long) (flash.bytes_read - read));
+    printf("  flash             : %lu writes, %llu bytes, %lu erases, %.3f s stalled writing\n",
+           flash.writes, (unsigned long long) flash.bytes_written, flash.erases,
+           stall_ns / 1e9);
+    printf("  erases per sector : %lu to %lu\n", flash.sector_erases_min, flash.sector_erases_max);
+    printf("  queue full        : %lu waits, %lu dropped\n", waits, stats_log_dropped());
+    if (memcmp(&loaded, &expect, sizeof(expect)) != 0 ||
+        memcmp(&written, &expect, sizeof(expect)) != 0) {
+        print_summary("EXPECTED", &expect);
+        rc = 1;
+    }
+    if (flash.overwrites) {
+        printf("  FLASH OVERWRITES  : %lu\n", flash.overwrites);
+        rc = 1;
+    }
+    return rc;
+}
+
+/*
+ * A viewer of the display mirror, as a browser's script would be
+ * ack_delay_ms holds each answer back, for a viewer on a slow link.
+ */
+typedef struct {
+    const char *name;
+    uint32_t ack_delay_ms;
+    int fd;
+    int open;
+    uint8_t rx[2048];
+    size_t rx_length;
+    /* Frames applied, by number, to decode against */
+    uint16_t numbers[16];
+    uint8_t frames[16][DISPLAY_CHAIN_LENGTH];
+    uint8_t frame[DISPLAY_CHAIN_LENGTH];
+    unsigned long received;
+    unsigned long errors;
+    unsigned long long bytes;
+} mirror_viewer;
+
+static int viewer_connect(mirror_viewer *viewer, int port)
+{
+    static const char request[] =
+        "GET / HTTP/1.1\r\nHost: countdown\r\nUpgrade: websocket\r\n"
+        "Connection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n\r\n";
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    viewer->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (viewer->fd < 0 || connect(viewer->fd, (struct sockaddr *) &addr, sizeof(addr)) != 0)
+        return -1;
+    fcntl(viewer->fd, F_SETFL, O_NONBLOCK);
+    return send(viewer->fd, request, sizeof(request) - 1, 0) == sizeof(request) - 1 ? 0 : -1;
+}
+
+static void viewer_ack(mirror_viewer *viewer, uint16_t number)
+{
+    static const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+    uint8_t message[8] = {0x82, 0x80 | 2, 0x12, 0x34, 0x56, 0x78};
+
+    message[6] = (number & 0xff) ^ mask[0];
+    message[7] = (number >> 8) ^ mask[1];
+    if (send(viewer->fd, message, sizeof(message), 0) != sizeof(message))
+        viewer->errors++;
+}
+
+/* Apply one frame message, returns its number or 0 if it was no good */
+static uint16_t viewer_apply(mirror_viewer *viewer, const uint8_t *m, int size)
+{
+    static const uint8_t blank[DISPLAY_CHAIN_LENGTH];
+    uint16_t number = m[0] | m[1] << 8, base = m[2] | m[3] << 8;
+    const uint8_t *from = base ? NULL : blank;
+    int i, slot = number % 16;
+
+    for (i = 0; i < 16 && !from; i++) {
+        if (viewer->numbers[i] == base)
+            from = viewer->frames[i];
+    }
+    if (size < MIRROR_HEADER_BYTES || from == NULL || m[4] > DISPLAY_CHAIN_LENGTH ||
+        mirror_delta_decode(from, m + MIRROR_HEADER_BYTES, size - MIRROR_HEADER_BYTES,
+                            m[4], viewer->frames[slot]) != 0)
+        return 0;
+    viewer->numbers[slot] = number;
+    memcpy(viewer->frame, viewer->frames[slot], DISPLAY_CHAIN_LENGTH);
+    return number;
+}
+
+static void viewer_task(void *pvParameters)
+{
+    mirror_viewer *viewer = pvParameters;
+    uint16_t pending[64];
+    uint32_t pending_at[64];
+    int n, length, waiting = 0;
+    char *end;
+
+    for (;;) {
+        vTaskDelay(1);
+        /* Answer what has been applied long enough ago */
+        while (waiting && xTaskGetTickCount() - pending_at[0] >=
+               viewer->ack_delay_ms / portTICK_PERIOD_MS) {
+            viewer_ack(viewer, pending[0]);
+            memmove(pending, pending + 1, --waiting * sizeof(pending[0]));
+            memmove(pending_at, pending_at + 1, waiting * sizeof(pending_at[0]));
+        }
+        n = recv(viewer->fd, viewer->rx + viewer->rx_length,
+                 sizeof(viewer->rx) - viewer->rx_length, 0);
+        if (n <= 0)
+            continue;
+        viewer->rx_length += n;
+        viewer->bytes += n;
+        if (!viewer->open) {
+            viewer->rx[viewer->rx_length] = '\0';
+            end = strstr((char *) viewer->rx, "\r\n\r\n");
+            if (end == NULL)
+                continue;
+            if (strstr((char *) viewer->rx, "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == NULL)
+                viewer->errors++;
+            viewer->open = 1;
+            n = end + 4 - (char *) viewer->rx;
+            viewer->rx_length -= n;
+            memmove(viewer->rx, viewer->rx + n, viewer->rx_length);
+        }
+        while (viewer->rx_length >= 2 &&
+               viewer->rx_length >= 2 + (size_t) (length = viewer->rx[1] & 0x7f)) {
+            if (viewer->rx[0] != 0x82 || (viewer->rx[1] & 0x80) ||
+                (n = viewer_apply(viewer, viewer->rx + 2, length)) == 0) {
+                viewer->errors++;
+            } else {
+                viewer->received++;
+                if (waiting < 64) {
+                    pending[waiting] = n;
+                    pending_at[waiting++] = xTaskGetTickCount();
+                }
+            }
+            viewer->rx_length -= 2 + length;
+            memmove(viewer->rx, viewer->rx + 2 + length, viewer->rx_length);
+        }
+    }
+}
+
+/* The scripted game watched through the mirror, by a quick and a slow viewer */
+static int run_mirror(void)
+{
+    mirror_viewer viewers[] = {
+        {.name = "prompt viewer", .ack_delay_ms = 20},
+        {.name = "slow viewer", .ack_delay_ms = 1000},
+    };
+    display_mirror *mirror;
+    display_mirror_stats stats;
+    uint64_t start_ns;
+    double minutes;
+    int i, rc = 0;
+
+    mirror = display_mirror_start(display, 0, 0, 2);
+    if (mirror == NULL)
+        return 1;
+    for (i = 0; i < 2; i++) {
+        if (viewer_connect(&viewers[i], display_mirror_port(mirror)) != 0) {
+            perror("connect");
+            return 1;
+        }
+        xTaskCreate(viewer_task, viewers[i].name, 2048, &viewers[i], 3, NULL);
+    }
+    start_ns = sim_now_ns();
+    xTaskCreate(player_task, "player", 2048, NULL, 5, NULL);
+    game1(60);
+    /* Let the last frame through, and its answer back */
+    sim_run_ms(2500);
+    minutes = (sim_now_ns() - start_ns) / 60e9;
+    display_mirror_get_stats(mirror, &stats);
+
+    printf("mirror, game1(60) scripted win watched on port %d, %.1f s virtual\n",
+           display_mirror_port(mirror), minutes * 60);
+    printf("  frames            : %lu from the display, %lu sent, %lu put off, %lu clients dropped\n",
+           stats.frames, stats.sent, stats.stalled, stats.dropped);
+    printf("  sent              : %llu bytes, %.0f bytes/min a viewer\n", stats.bytes,
+           stats.bytes / minutes / 2);
+    printf("  whole frames      : %llu bytes, %.0f bytes/min a viewer (%.1fx)\n",
+           stats.raw_bytes, stats.raw_bytes / minutes / 2,
+           stats.bytes ? (double) stats.raw_bytes / stats.bytes : 0.0);
+    for (i = 0; i < 2; i++) {
+        printf("  %-18s: %lu frames, %llu bytes, %s%s\n", viewers[i].name,
+               viewers[i].received, viewers[i].bytes,
+               memcmp(viewers[i].frame, display->shadow,
+                      display->boards * DISPLAY_BUFFER_LENGTH) == 0 ?
+               "shows the display" : "OUT OF STEP",
+               viewers[i].errors ? ", DECODE ERRORS" : "");
+        if (viewers[i].errors ||
+            memcmp(viewers[i].frame, display->shadow, display->boards * DISPLAY_BUFFER_LENGTH))
+            rc = 1;
+    }
+    return rc || board.protocol_errors ? 1 : 0;
+}
+
+/* The scripted game with every service, then each task's stack use */
+static int run_budget(void)
+{
+    xTaskCreate(player_task, "player", 2048, NULL, 5, NULL);
+    game1(60);
+    sim_run_ms(STATS_BATCH_MS);
+    task_stack_print();
+    return board.protocol_errors ? 1 : 0;
+}
+
+/* Presses of S1 to S4 at every phase of the scans and refreshes, then the win */
+static void latency_player_task(void *pvParameters)
+{
+    unsigned long i, presses = (unsigned long) pvParameters;
+    uint8_t key;
+    sim_run_ms(500);
+    press(0x80);
+    for (i = 0; i < presses; i++) {
+        key = 0x80 >> (i % 4);
+        tm1638_emu_set_keys(&board, key);
+        sim_run_ms(40 + (i * 7) % 53);
+        tm1638_emu_set_keys(&board, 0x00);
+        sim_run_ms(40 + (i * 11) % 47);
+    }
+    for (i = 0; i < 4; i++) {
+        while (board_game.code[i] != board_game.secret[i])
+            press(0x80 >> i);
+    }
+    press(0x01);
+    vTaskDelete(NULL);
+}
+
+static int run_latency(unsigned long count)
+{
+    latency_stats stats;
+    int b, over = 0;
+
+    latency_reset();
+    xTaskCreate(latency_player_task, "player", 2048, (void *) count, 5, NULL);
+    game1(600);
+    sim_run_ms(100);
+    printf("latency, %lu presses%s\n", count, service ? ", display service" : "");
+    latency_print();
+    for (b = 0; b < LATENCY_BUTTONS; b++) {
+        latency_get_stats(b, &stats);
+        over += stats.over;
+    }
+    if (over)
+        printf("  %d presses over %d ms\n", over, LATENCY_TARGET_MS);
+    return over || board.protocol_errors ? 1 : 0;
+}
+
+/*
+ * Games off the board, all on one executor with a scripted player each
+ */
+#define SIM_SESSIONS_MAX 1024
+#define SIM_SESSIONS_SECONDS 60
+
+typedef struct {
+    executor_job job;           /* First, for the step */
+    game_session *game;
+    uint32_t rand;
+    unsigned long games;
+    unsigned long presses;
+} sim_session_player;
+
+static executor sessions;
+static game_session session_games[SIM_SESSIONS_MAX];
+static seven_segment_ui session_displays[SIM_SESSIONS_MAX];
+static sim_session_player session_players[SIM_SESSIONS_MAX];
+static unsigned long sim_mallocs;
+
+/* Heap use from here on is counted: linked with -Wl,--wrap=malloc,--wrap=calloc */
+extern void *__real_malloc(size_t size);
+extern void *__real_calloc(size_t count, size_t size);
+void *__wrap_malloc(size_t size)
+{
+    sim_mallocs++;
+    return __real_malloc(size);
+}
+void *__wrap_calloc(size_t count, size_t size)
+{
+    sim_mallocs++;
+    return __real_calloc(count, size);
+}
+
+static uint32_t session_rand(sim_session_player *player)
+{
+    player->rand = player->rand * 1103515245 + 12345;
+    return player->rand >> 8;
+}
+
+/* Press something every 150 to 400 ms, and start another game after each */
+static int64_t session_player_step(executor_job *job, int64_t now)
+{
+    sim_session_player *player = (sim_session_player *) job;
+    game_session *game = player->game;
+    uint32_t r = session_rand(player) % 100;
+    int i;
+
+    if (game->state == GAME_OVER) {
+        game_start(game, game->display, 30 + session_rand(player) % 31, 0);
+        executor_add(&sessions, &game->job, game_step, 0);
+        player->games++;
+    } else if (r < 60) {
+        game_press(game, 0x80 >> (session_rand(player) % 4));
+    } else if (r < 85) {
+        game_press(game, 0x01);
+    } else if (r < 90) {
+        game_press(game, 0x02);
+    } else {
+        /* Dial it in, as if the player had worked it out */
+        for (i = 0; i < 4; i++)
+            game->code[i] = (game->secret[i] + 9) % 10;
+        game_press(game, 0xf1);
+    }
+    player->presses++;
+    return now + DEADLINE_MS(150 + session_rand(player) % 250);
+}
+
+static int run_sessions(unsigned long count)
+{
+    unsigned long i, games = 0, presses = 0, mallocs;
+    int64_t earliest, end;
+    double busy_ns = 0, longest_ns = 0, t, per_second;
+    uint64_t start_ns;
+    esp_log_level_t level = sim_log_level;
+    int woken = 0;
+
+    if (count > SIM_SESSIONS_MAX)
+        count = SIM_SESSIONS_MAX;
+    executor_init(&sessions);
+    for (i = 0; i < count; i++) {
+        session_displays[i].boards = 1;
+        session_games[i].display = &session_displays[i];
+        session_games[i].state = GAME_OVER;
+        session_players[i].game = &session_games[i];
+        session_players[i].rand = (uint32_t) i * 2654435761u + seed + 1;
+        executor_add(&sessions, &session_players[i].job, session_player_step, 0);
+    }
+    /* A log line a guess would be most of the time */
+    if (sim_log_level > ESP_LOG_WARN)
+        sim_log_level = ESP_LOG_WARN;
+    start_ns = sim_now_ns();
+    end = deadline_now() + DEADLINE_MS(SIM_SESSIONS_SECONDS * 1000);
+    mallocs = sim_mallocs;
+    while (deadline_now() - end < 0) {
+        t = wall_seconds();
+        earliest = executor_pass(&sessions, woken);
+        t = (wall_seconds() - t) * 1e9;
+        busy_ns += t;
+        if (t > longest_ns)
+            longest_ns = t;
+        if (earliest - end > 0)
+            earliest = end;
+        woken = ulTaskNotifyTake(pdTRUE, executor_ticks(earliest, deadline_now())) != 0;
+    }
+    mallocs = sim_mallocs - mallocs;
+    sim_log_level = level;
+    for (i = 0; i < count; i++) {
+        games += session_players[i].games;
+        presses += session_players[i].presses;
+    }
+
+    per_second = busy_ns / 1e3 / count / ((sim_now_ns() - start_ns) / 1e9);
+    printf("sessions, %lu games off the board on one executor\n", count);
+    printf("  virtual time      : %.1f s, %lu games started, %lu presses\n",
+           (sim_now_ns() - start_ns) / 1e9, games, presses);
+    printf("  executor          : %lu passes, %lu steps, longest pass %.0f us\n",
+           sessions.passes, sessions.steps, longest_ns / 1e3);
+    printf("  host time         : %.3f s, %.1f us per session a second\n",
+           busy_ns / 1e9, per_second);
+    printf("  sessions per core : %.0f on this host\n", per_second > 0 ? 1e6 / per_second : 0.0);
+    printf("  memory            : %u bytes per session, %lu heap allocations\n",
+           (unsigned) (sizeof(game_session) + sizeof(seven_segment_ui)), mallocs);
+    return mallocs || games < count ? 1 : 0;
+}
+
+static const char *baseline;
+static int update_baseline;
+static const char *mode_arg;
+
+static int run_mode(const char *mode, unsigned long count, int use_service)
+{
+    if (use_service && strcmp(mode, "busbench") != 0)
+        service = display_service_start(display, 1, 20, 5);
+    if (strcmp(mode, "game") == 0 || strcmp(mode, "timeup") == 0 ||
+        strcmp(mode, "selfplay") == 0 || strcmp(mode, "replay") == 0 ||
+        strcmp(mode, "soak") == 0 || strcmp(mode, "cores") == 0 ||
+        strcmp(mode, "mirror") == 0 || strcmp(mode, "budget") == 0 ||
+        strcmp(mode, "latency") == 0) {
+        animation_start(display);
+        /* A replay takes its buttons from the log */
+        if (strcmp(mode, "replay") != 0)
+            input_service_start(display, 0, 6);
+        sound_start(beep_pin, beep_gnd, 1, 4);
+    }
+    if (strcmp(mode, "game") == 0 || strcmp(mode, "selfplay") == 0 ||
+        strcmp(mode, "soak") == 0 || strcmp(mode, "stats") == 0 ||
+        strcmp(mode, "budget") == 0)
+        stats_log_start(0, 1);
+
+    if (strcmp(mode, "game") == 0)
+        return run_game();
+    if (strcmp(mode, "timeup") == 0)
+        return run_timeup(count < 100000 ? count : 60);
+    if (strcmp(mode, "bench") == 0)
+        return run_bench(count);
+    if (strcmp(mode, "busbench") == 0)
+        return run_busbench(count < 100000 ? count : 10000);
+    if (strcmp(mode, "microbench") == 0)
+        return microbench_run(display, &board, count, baseline, update_baseline) ? 1 : 0;
+    if (strcmp(mode, "solver") == 0)
+        return run_solver(count < 100000 ? count : 200);
+    if (strcmp(mode, "selfplay") == 0)
+        return run_selfplay();
+    if (strcmp(mode, "replay") == 0)
+        return mode_arg ? run_replay(mode_arg) : 2;
+    if (strcmp(mode, "soak") == 0)
+        return run_soak(count < 100000 ? count : 100);
+    if (strcmp(mode, "cores") == 0)
+        return run_cores();
+    if (strcmp(mode, "mirror") == 0)
+        return run_mirror();
+    if (strcmp(mode, "budget") == 0)
+        return run_budget();
+    if (strcmp(mode, "latency") == 0)
+        return run_latency(count < 100000 ? count : 200);
+    if (strcmp(mode, "sessions") == 0)
+        return run_sessions(count < 100000 ? count : 64);
+    if (strcmp(mode, "stats") == 0)
+        return run_stats(count < 100000 ? count : 10000);
+    fprintf(stderr, "unknown mode %s\n", mode);
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+    const char *mode = "game";
+    unsigned long count = 100000;
+    const seven_segment_transport *transport = &bb_transport;
+    int use_service = 0;
+    int dump_trace = 0;
+    int dump_profile = 0;
+    int dump_session = 0;
+    const char *flash_file = NULL;
+    int rc;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t) strtoul(argv[++i], NULL, 0);
+            sim_seed(seed);
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            if (sim_log_verbosity(argv[++i]) != 0) {
+                fprintf(stderr, "unknown log level %s\n", argv[i]);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--service") == 0) {
+            use_service = 1;
+        } else if (strcmp(argv[i], "--flash") == 0 && i + 1 < argc) {
+            flash_file = argv[++i];
+            sim_flash_load(flash_file);
+        } else if (strcmp(argv[i], "--unicore") == 0) {
+            unicore = 1;
+            sim_set_cores(1);
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            dump_trace = 1;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            dump_profile = 1;
+        } else if (strcmp(argv[i], "--session") == 0) {
+            dump_session = 1;
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "--update-baseline") == 0) {
+            update_baseline = 1;
+        } else if (strcmp(argv[i], "--transport") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "spi") == 0) {
+                transport = &spi_transport;
+            } else if (strcmp(argv[i], "bb") != 0) {
+                fprintf(stderr, "unknown transport %s\n", argv[i]);
+                return 2;
+            }
+        } else if (argv[i][0] != '-') {
+            mode = argv[i];
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                mode_arg = argv[++i];
+                count = strtoul(mode_arg, NULL, 0);
+            }
+        } else {
+            fprintf(stderr, "usage: %s [--seed N] [--log LEVEL] [--transport bb|spi] [--service] [--unicore] "
+                    "[--flash FILE] [--trace] [--profile] [--session] [--baseline FILE] [--update-baseline] "
+                    "[game | idle | timeup [N] | bench [N] | busbench [N] | microbench [N] | chain [N] "
+                    "| solver [N] | selfplay | replay FILE | soak [N] | cores | stats [N] | mirror | budget | boot "
+                    "| latency [N] | sessions [N]]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    tm1638_emu_init(&board, strobe_pin, clock_pin, data_pin);
+    sim_gpio_attach(&board);
+    if (strcmp(mode, "chain") == 0) {
+        rc = run_chain(count < 100000 ? count : 1000, transport);
+    } else if (strcmp(mode, "boot") == 0) {
+        rc = run_boot();
+    } else if (strcmp(mode, "idle") == 0) {
+        rc = run_idle();
+        if (dump_profile) {
+            /* Ask app_main's console, as on the device */
+            sim_uart_input("p");
+            sim_run_ms(10);
+            dump_profile = 0;
+        }
+    } else {
+        display = display_setup_transport(strobe_pin, clock_pin, data_pin, 0x01, transport);
+        if (display == NULL)
+            return 1;
+        rc = run_mode(mode, count, use_service);
+    }
+    if (dump_trace)
+        trace_dump();
+    if (dump_profile)
+        profile_dump();
+    if (dump_session)
+        session_dump();
+    /* Give the stats log its chance to write the last games, as power off would not */
+    while (flash_file && stats_log_pending())
+        sim_run_ms(STATS_BATCH_MS);
+    if (flash_file && sim_flash_save(flash_file) != 0) {
+        fprintf(stderr, "unable to save flash to %s\n", flash_file);
+        rc = 1;
+    }
+    return rc;
+}
@@ -0,0 +1,852 @@
+/*
+ * Cooperative FreeRTOS shim for the host simulation
+ *
+ * Every task gets its own ucontext stack and they all share one host thread.
+ * A task runs until it delays or blocks; the scheduler then picks the next
+ * runnable task, advancing the virtual clock to the earliest wake time if
+ * nobody is ready.  Simulated minutes therefore pass in host milliseconds,
+ * and the firmware's timing (clock(), tick counts) is fully deterministic.
+ *
+ * The highest priority task ready goes first, and one woken on the core
+ * of a lower priority one takes over from it there and then.  Otherwise
+ * nothing is preempted: a task runs until it blocks or delays.
+ *
+ * There are two cores, as on the ESP32.  Tasks run on the core they are
+ * pinned to, unpinned ones on whichever is free, and only one at a time
+ * per core.  A task busy on one core (sim_advance_ns()) is put aside as
+ * soon as a task on the other core is due before it would finish, so the
+ * two overlap in virtual time.  sim_set_cores(1) puts everything on one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "esp_system.h"
+#include "esp_spi_flash.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "driver/uart.h"
+#include "xtensa/hal.h"
+
+#include "sim.h"
+
+#define SIM_STACK_SIZE (256 * 1024)
+/* Fills a new stack, so what a task has used can be seen */
+#define SIM_STACK_PAINT 0xa5
+#define SIM_TICK_NS (1000000ULL * portTICK_PERIOD_MS)
+#define SIM_FOREVER UINT64_MAX
+
+struct sim_task {
+    ucontext_t ctx;
+    TaskFunction_t fn;
+    void *arg;
+    const char *name;
+    UBaseType_t priority;
+    BaseType_t core;
+    uint64_t wake_ns;
+    const void *waiting_on;
+    int alive;
+    int busy;                   /* Put aside part way through sim_advance_ns() */
+    int run_core;               /* Where it runs, or last ran */
+    unsigned long wakeups;
+    uint64_t run_ns;            /* Modelled CPU time, see sim_advance_ns() */
+    uint32_t notify;
+    void *stack;
+    uint32_t stack_depth;       /* As asked for, the device's size */
+    struct sim_task *next;
+};
+
+struct sim_event_group {
+    EventBits_t bits;
+};
+
+struct sim_queue {
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t *data;
+};
+
+struct sim_pm_lock {
+    const char *name;
+    esp_pm_lock_type_t type;
+    int count;
+};
+
+esp_log_level_t sim_log_level = ESP_LOG_WARN;
+
+/* app_main runs on the PRO CPU */
+static struct sim_task main_task = { .name = "main", .alive = 1, .priority = 1, .core = 0,
+                                     .stack_depth = CONFIG_MAIN_TASK_STACK_SIZE };
+static struct sim_task *tasks = &main_task;
+static struct sim_task *current = &main_task;
+static uint64_t now_ns;
+static uint64_t busy_ns;
+static int cores = SIM_CORES;
+/* Running, or busy and put aside, on each core */
+static struct sim_task *holder[SIM_CORES] = {&main_task};
+static uint64_t core_busy_ns[SIM_CORES];
+/* Earliest a task could start on a core other than the current task's */
+static uint64_t other_due_ns = UINT64_MAX;
+static uint32_t rng_state = 0x2545f491;
+static sim_pm_stats pm;
+static int pm_cpu_locks;
+static int pm_locks;
+
+
+/*
+ * Virtual clock
+ */
+uint64_t sim_now_ns(void)
+{
+    return now_ns;
+}
+
+static void sim_schedule(void);
+
+/* Account for CPU time spent busy, e.g. bit-banging the bus */
+void sim_advance_ns(uint64_t ns)
+{
+    /* The costs are for the default CPU frequency */
+    if (pm.configured && pm_cpu_locks == 0) {
+        ns = ns * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ / pm.min_mhz;
+        pm.busy_min_ns += ns;
+    } else {
+        pm.busy_max_ns += ns;
+    }
+    busy_ns += ns;
+    core_busy_ns[current->run_core] += ns;
+    current->run_ns += ns;
+    if (now_ns + ns > other_due_ns) {
+        /* Let the other core run meanwhile, we carry on when this is done */
+        current->busy = 1;
+        current->wake_ns = now_ns + ns;
+        sim_schedule();
+        current->busy = 0;
+        return;
+    }
+    now_ns += ns;
+}
+
+/* Total modelled CPU time, as opposed to time spent delayed or blocked */
+uint64_t sim_busy_ns(void)
+{
+    return busy_ns;
+}
+
+/* ... on one core */
+uint64_t sim_core_busy_ns(int core)
+{
+    return core >= 0 && core < SIM_CORES ? core_busy_ns[core] : 0;
+}
+
+/* Run every task on core 0, as with CONFIG_FREERTOS_UNICORE, call first */
+void sim_set_cores(int n)
+{
+    cores = n < 1 ? 1 : n > SIM_CORES ? SIM_CORES : n;
+}
+
+void sim_seed(uint32_t seed)
+{
+    rng_state = seed ? seed : 1;
+}
+
+int sim_log_verbosity(const char *name)
+{
+    static const char *names[] = {"none", "error", "warn", "info", "debug", "verbose"};
+    int i;
+    for (i = 0; i < 6; i++) {
+        if (strcasecmp(name, names[i]) == 0) {
+            sim_log_level = (esp_log_level_t) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* The firmware is built with CLOCKS_PER_SEC == 1000, see sim_newlib.h */
+clock_t clock(void)
+{
+    return (clock_t) (now_ns / 1000000ULL);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t) (now_ns / 1000ULL);
+}
+
+uint32_t xthal_get_ccount(void)
+{
+    sim_advance_ns(SIM_CCOUNT_NS);
+    return (uint32_t) (now_ns * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ / 1000ULL);
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t) (now_ns / 1000000ULL);
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void) tag;
+    sim_log_level = level;
+}
+
+
+/*
+ * Scheduler
+ */
+
+/* The core a task would run on now, or -1 if it has to wait for one */
+static int sim_core_for(const struct sim_task *t)
+{
+    int c;
+
+    if (cores == 1)
+        return 0;
+    if (t->busy)
+        return t->run_core;
+    if (t->core != tskNO_AFFINITY)
+        return holder[t->core] == NULL || holder[t->core] == t ? t->core : -1;
+    for (c = 0; c < cores; c++) {
+        if (holder[c] == NULL || holder[c] == t)
+            return c;
+    }
+    return -1;
+}
+
+/* Work out when the running task has to make way for the other core */
+static void sim_update_due(void)
+{
+    struct sim_task *t;
+    int c;
+
+    other_due_ns = UINT64_MAX;
+    if (cores == 1)
+        return;
+    for (t = tasks; t != NULL; t = t->next) {
+        if (!t->alive || t == current || t->wake_ns >= other_due_ns)
+            continue;
+        c = sim_core_for(t);
+        if (c >= 0 && c != current->run_core)
+            other_due_ns = t->wake_ns;
+    }
+}
+
+static void sim_schedule(void)
+{
+    struct sim_task *t, *next = NULL, *prev = current;
+    uint64_t earliest = SIM_FOREVER;
+    int c, busy = 0;
+
+    /* Give up the core unless busy and only put aside */
+    if (!prev->busy && holder[prev->run_core] == prev)
+        holder[prev->run_core] = NULL;
+
+    /* The highest priority of whoever is ready now, round robin between
+     * equals starting after the current task */
+    t = current;
+    do {
+        t = t->next ? t->next : tasks;
+        if (t->alive && t->wake_ns <= now_ns && sim_core_for(t) >= 0 &&
+            (next == NULL || t->priority > next->priority))
+            next = t;
+    } while (t != current);
+
+    if (next == NULL) {
+        /* Nobody ready: jump the clock to the next wake up */
+        for (t = tasks; t != NULL; t = t->next) {
+            if (t->alive && t->busy)
+                busy = 1;
+            if (t->alive && sim_core_for(t) >= 0 &&
+                (t->wake_ns < earliest ||
+                 (t->wake_ns == earliest && next && t->priority > next->priority))) {
+                earliest = t->wake_ns;
+                next = t;
+            }
+        }
+        if (next == NULL || earliest == SIM_FOREVER) {
+            fprintf(stderr, "sim: deadlock, every task is blocked forever\n");
+            exit(2);
+        }
+        /* The CPU idles until then, asleep if it is worth it and allowed,
+         * unless the other core is busy meanwhile */
+        if (busy) {
+        } else if (pm.light_sleep && pm_locks == 0 &&
+            earliest - now_ns >= CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP * SIM_TICK_NS) {
+            pm.sleep_ns += earliest - now_ns;
+            pm.sleeps++;
+        } else {
+            pm.idle_ns += earliest - now_ns;
+        }
+        now_ns = earliest;
+    }
+
+    c = sim_core_for(next);
+    next->run_core = c;
+    holder[c] = next;
+    next->waiting_on = NULL;
+    current = next;
+    sim_update_due();
+    if (next != prev)
+        swapcontext(&prev->ctx, &next->ctx);
+}
+
+void sim_block(const void *object, uint64_t deadline_ns)
+{
+    current->waiting_on = object;
+    current->wake_ns = deadline_ns;
+    sim_schedule();
+    current->wakeups++;
+}
+
+/* Times the named task has come back from blocking or delaying */
+unsigned long sim_task_wakeups(const char *name)
+{
+    struct sim_task *t;
+    unsigned long wakeups = 0;
+    for (t = tasks; t != NULL; t = t->next) {
+        if (strcmp(t->name, name) == 0)
+            wakeups += t->wakeups;
+    }
+    return wakeups;
+}
+
+/* Waking a higher priority task on this core hands the core straight over */
+void sim_wake(const void *object)
+{
+    struct sim_task *t;
+    int preempt = 0;
+    for (t = tasks; t != NULL; t = t->next) {
+        if (t->alive && t->waiting_on == object) {
+            t->waiting_on = NULL;
+            t->wake_ns = now_ns;
+            if (t->priority > current->priority &&
+                (cores == 1 || t->core == current->run_core))
+                preempt = 1;
+        }
+    }
+    sim_update_due();
+    if (preempt) {
+        current->wake_ns = now_ns;
+        sim_schedule();
+    }
+}
+
+/* Timeouts expire on a tick like the real kernel */
+static uint64_t sim_deadline(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY)
+        return SIM_FOREVER;
+    return (now_ns / SIM_TICK_NS + ticks) * SIM_TICK_NS;
+}
+
+/* Run the rest of the system for a while from the calling task */
+void sim_run_ms(uint32_t ms)
+{
+    sim_block(NULL, now_ns + (uint64_t) ms * 1000000ULL);
+}
+
+static void sim_task_entry(void)
+{
+    current->fn(current->arg);
+    /* FreeRTOS tasks must not return, but be forgiving */
+    vTaskDelete(NULL);
+}
+
+
+/*
+ * FreeRTOS task API
+ */
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                   uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core)
+{
+    struct sim_task *t = calloc(1, sizeof(*t));
+    struct sim_task **tail;
+
+    if (t == NULL)
+        return pdFAIL;
+    t->stack = malloc(SIM_STACK_SIZE);
+    if (t->stack == NULL) {
+        free(t);
+        return pdFAIL;
+    }
+    memset(t->stack, SIM_STACK_PAINT, SIM_STACK_SIZE);
+    t->stack_depth = stack_depth;
+    t->fn = fn;
+    t->arg = arg;
+    t->name = name;
+    t->priority = priority;
+    t->core = cores == 1 ? 0 : core;
+    t->alive = 1;
+    t->wake_ns = now_ns;
+    getcontext(&t->ctx);
+    t->ctx.uc_stack.ss_sp = t->stack;
+    t->ctx.uc_stack.ss_size = SIM_STACK_SIZE;
+    t->ctx.uc_link = NULL;
+    makecontext(&t->ctx, sim_task_entry, 0);
+
+    for (tail = &tasks; *tail != NULL; tail = &(*tail)->next)
+        ;
+    *tail = t;
+    if (handle)
+        *handle = t;
+    sim_update_due();
+    return pdPASS;
+}
+
+/* Host code needs far more stack than the device's, so the buffers go unused */
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name,
+                                           uint32_t stack_depth, void *arg,
+                                           UBaseType_t priority, StackType_t *stack,
+                                           StaticTask_t *tcb, BaseType_t core)
+{
+    TaskHandle_t handle = NULL;
+    (void) stack;
+    (void) tcb;
+    xTaskCreatePinnedToCore(fn, name, stack_depth, arg, priority, &handle, core);
+    return handle;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name,
+                       uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, arg, priority,
+                                   handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL)
+        task = current;
+    task->alive = 0;
+    task->busy = 0;
+    if (task != current && holder[task->run_core] == task)
+        holder[task->run_core] = NULL;
+    /* The stack is leaked: we may still be running on it */
+    if (task == current)
+        sim_schedule();
+}
+
+/* Nothing resumes a task yet, so it is as good as blocked forever */
+void vTaskSuspend(TaskHandle_t task)
+{
+    static const char suspended;
+    if (task == NULL)
+        task = current;
+    task->waiting_on = &suspended;
+    task->wake_ns = SIM_FOREVER;
+    task->busy = 0;
+    if (task != current && holder[task->run_core] == task)
+        holder[task->run_core] = NULL;
+    if (task == current)
+        sim_schedule();
+    else
+        sim_update_due();
+}
+
+TaskHandle_t xTaskGetHandle(const char *name)
+{
+    struct sim_task *t;
+    for (t = tasks; t != NULL; t = t->next) {
+        if (t->alive && strcmp(t->name, name) == 0)
+            return t;
+    }
+    return NULL;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    /* Wake on a tick boundary like the real kernel */
+    uint64_t tick_now = now_ns / SIM_TICK_NS;
+    sim_block(NULL, (tick_now + ticks) * SIM_TICK_NS);
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period)
+{
+    *previous_wake += period;
+    sim_block(NULL, (uint64_t) *previous_wake * SIM_TICK_NS);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    uint64_t deadline = sim_deadline(ticks);
+    struct sim_task *self = current;
+    uint32_t value;
+    while (self->notify == 0) {
+        if (now_ns >= deadline)
+            return 0;
+        sim_block(self, deadline);
+    }
+    value = self->notify;
+    self->notify = clear_on_exit ? 0 : value - 1;
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    task->notify++;
+    sim_wake(task);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_woken)
+{
+    xTaskNotifyGive(task);
+    if (higher_priority_woken)
+        *higher_priority_woken = pdFALSE;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current;
+}
+
+/*
+ * Like the kernel's, from each task's modelled CPU time, in us, with an
+ * IDLE task per core for the rest.  Percentages are of the elapsed time,
+ * so with two cores they add up to 200.
+ */
+void vTaskGetRunTimeStats(char *buffer)
+{
+    struct sim_task *t;
+    uint64_t total_us = now_ns / 1000 ? now_ns / 1000 : 1;
+    char name[16];
+    int c;
+
+    *buffer = '\0';
+    for (t = tasks; t != NULL; t = t->next) {
+        if (t->alive)
+            buffer += sprintf(buffer, "%s\t\t%u\t\t%u%%\r\n", t->name,
+                              (unsigned) (t->run_ns / 1000),
+                              (unsigned) (t->run_ns / 1000 * 100 / total_us));
+    }
+    for (c = 0; c < cores; c++) {
+        snprintf(name, sizeof(name), "IDLE%d", c);
+        buffer += sprintf(buffer, "%s\t\t%u\t\t%u%%\r\n", name,
+                          (unsigned) ((now_ns - core_busy_ns[c]) / 1000),
+                          (unsigned) ((now_ns - core_busy_ns[c]) / 1000 * 100 / total_us));
+    }
+}
+
+/* Bytes of its host stack a task has touched, 0 for main's which isn't painted */
+uint32_t sim_task_stack_used(TaskHandle_t task)
+{
+    const uint8_t *p;
+
+    if (task->stack == NULL)
+        return 0;
+    /* Stacks grow down */
+    for (p = task->stack; p < (uint8_t *) task->stack + SIM_STACK_SIZE; p++) {
+        if (*p != SIM_STACK_PAINT)
+            break;
+    }
+    return (uint8_t *) task->stack + SIM_STACK_SIZE - p;
+}
+
+/* Against the size the firmware asked for, so 0 when the host used more */
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    uint32_t used = sim_task_stack_used(task);
+    return used < task->stack_depth ? task->stack_depth - used : 0;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t) (now_ns / SIM_TICK_NS);
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return current->run_core;
+}
+
+
+/*
+ * Event groups
+ */
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return calloc(1, sizeof(struct sim_event_group));
+}
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *buffer)
+{
+    (void) buffer;
+    return xEventGroupCreate();
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    group->bits |= bits;
+    sim_wake(group);
+    return group->bits;
+}
+
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t group, EventBits_t bits,
+                                     BaseType_t *higher_priority_woken)
+{
+    xEventGroupSetBits(group, bits);
+    if (higher_priority_woken)
+        *higher_priority_woken = pdFALSE;
+    return pdPASS;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits,
+                                BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks)
+{
+    uint64_t deadline = sim_deadline(ticks);
+    EventBits_t value;
+    for (;;) {
+        value = group->bits;
+        if (wait_for_all ? (value & bits) == bits : (value & bits) != 0)
+            break;
+        if (now_ns >= deadline)
+            return value;
+        sim_block(group, deadline);
+    }
+    if (clear_on_exit)
+        group->bits &= ~bits;
+    return value;
+}
+
+
+/*
+ * Queues
+ * Senders and receivers wait on the queue itself, any change wakes them all
+ */
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct sim_queue *q = calloc(1, sizeof(*q));
+    if (q == NULL)
+        return NULL;
+    q->data = calloc(length, item_size);
+    if (q->data == NULL) {
+        free(q);
+        return NULL;
+    }
+    q->length = length;
+    q->item_size = item_size;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    free(queue->data);
+    free(queue);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    uint64_t deadline = sim_deadline(ticks);
+    while (queue->count == queue->length) {
+        if (now_ns >= deadline)
+            return pdFAIL;
+        sim_block(queue, deadline);
+    }
+    memcpy(queue->data + ((queue->head + queue->count) % queue->length) * queue->item_size,
+           item, queue->item_size);
+    queue->count++;
+    sim_wake(queue);
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item,
+                             BaseType_t *higher_priority_woken)
+{
+    if (higher_priority_woken)
+        *higher_priority_woken = pdFALSE;
+    return xQueueSendToBack(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    uint64_t deadline = sim_deadline(ticks);
+    while (queue->count == 0) {
+        if (now_ns >= deadline)
+            return pdFAIL;
+        sim_block(queue, deadline);
+    }
+    memcpy(item, queue->data + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    sim_wake(queue);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->count;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    queue->head = 0;
+    queue->count = 0;
+    sim_wake(queue);
+    return pdPASS;
+}
+
+
+/*
+ * Power management
+ */
+esp_err_t esp_pm_configure(const void *config)
+{
+    const esp_pm_config_esp32_t *c = config;
+    if (c->min_freq_mhz <= 0 || c->min_freq_mhz > c->max_freq_mhz)
+        return ESP_ERR_INVALID_ARG;
+    pm.configured = 1;
+    pm.min_mhz = c->min_freq_mhz;
+    pm.max_mhz = c->max_freq_mhz;
+    pm.light_sleep = c->light_sleep_enable;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg,
+                             const char *name, esp_pm_lock_handle_t *out_handle)
+{
+    struct sim_pm_lock *lock = calloc(1, sizeof(*lock));
+    (void) arg;
+    if (lock == NULL)
+        return ESP_ERR_NO_MEM;
+    lock->name = name;
+    lock->type = lock_type;
+    *out_handle = lock;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+    if (handle->count++ == 0) {
+        /* Any lock keeps us out of light sleep */
+        pm_locks++;
+        if (handle->type == ESP_PM_CPU_FREQ_MAX)
+            pm_cpu_locks++;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle)
+{
+    if (handle->count == 0)
+        return ESP_ERR_INVALID_STATE;
+    if (--handle->count == 0) {
+        pm_locks--;
+        if (handle->type == ESP_PM_CPU_FREQ_MAX)
+            pm_cpu_locks--;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_dump_locks(FILE *stream)
+{
+    fprintf(stream, "sim: %d locks held, %d of them CPU frequency\n", pm_locks, pm_cpu_locks);
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_uart_wakeup(int uart_num)
+{
+    (void) uart_num;
+    return ESP_OK;
+}
+
+
+/*
+ * UART receive, typed in by sim_uart_input()
+ */
+static char uart_rx[256];
+static size_t uart_rx_head, uart_rx_tail;
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size,
+                              int tx_buffer_size, int queue_size,
+                              QueueHandle_t *uart_queue, int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t uart_set_wakeup_threshold(uart_port_t uart_num, int wakeup_threshold)
+{
+    return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t uart_num, uint8_t *buf, uint32_t length,
+                    TickType_t ticks_to_wait)
+{
+    uint64_t deadline = sim_deadline(ticks_to_wait);
+    uint32_t n = 0;
+
+    while (n < length) {
+        if (uart_rx_tail == uart_rx_head) {
+            if (now_ns >= deadline)
+                break;
+            sim_block(uart_rx, deadline);
+            continue;
+        }
+        buf[n++] = (uint8_t) uart_rx[uart_rx_tail++ % sizeof(uart_rx)];
+    }
+    return (int) n;
+}
+
+void sim_uart_input(const char *text)
+{
+    while (*text && uart_rx_head - uart_rx_tail < sizeof(uart_rx))
+        uart_rx[uart_rx_head++ % sizeof(uart_rx)] = *text++;
+    sim_wake(uart_rx);
+}
+
+void sim_pm_get_stats(sim_pm_stats *stats)
+{
+    *stats = pm;
+}
+
+
+/*
+ * esp_system
+ */
+uint32_t esp_random(void)
+{
+    /* xorshift32: deterministic for a given sim_seed() */
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+void esp_chip_info(esp_chip_info_t *out_info)
+{
+    memset(out_info, 0, sizeof(*out_info));
+    out_info->cores = 2;
+    out_info->features = CHIP_FEATURE_WIFI_BGN | CHIP_FEATURE_BT | CHIP_FEATURE_BLE;
+}
+
+size_t spi_flash_get_chip_size(void)
+{
+    return 4 * 1024 * 1024;
+}
@@ -0,0 +1,174 @@
+/*
+ * SPI master driver for the host simulation
+ *
+ * Transactions are clocked bit by bit into the attached boards as soon as
+ * they are queued (mode 3: clock idles high, data sampled on the rising
+ * edge), so the TM1638 emulator decodes them exactly as it decodes the
+ * bit-banged bus.  Each edge is stamped with the time it would happen:
+ * the bus runs transactions back to back at the device clock, with
+ * SIM_SPI_ISR_NS for the interrupt to call post_cb after one and again
+ * before the next one's pre_cb.  Queueing costs the CPU SIM_SPI_QUEUE_NS,
+ * and waiting for a result blocks the calling task until the transaction
+ * would have finished.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "driver/spi_master.h"
+
+#include "sim.h"
+
+#define SIM_SPI_HOSTS 3
+#define SIM_SPI_QUEUE 16
+
+struct sim_spi_device {
+    spi_host_device_t host;
+    spi_device_interface_config_t cfg;
+    spi_transaction_t *queue[SIM_SPI_QUEUE];
+    uint64_t done_ns[SIM_SPI_QUEUE];
+    int head;
+    int count;
+};
+
+static spi_bus_config_t buses[SIM_SPI_HOSTS];
+static uint8_t bus_used[SIM_SPI_HOSTS];
+static int bus_devices[SIM_SPI_HOSTS];
+static uint64_t bus_free_ns[SIM_SPI_HOSTS];
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config, int dma_chan)
+{
+    (void) dma_chan;
+    if (host >= SIM_SPI_HOSTS || bus_used[host])
+        return ESP_ERR_INVALID_STATE;
+    buses[host] = *bus_config;
+    bus_used[host] = 1;
+    sim_gpio_bus_edge(bus_config->sclk_io_num, 1, sim_now_ns());
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *dev_config,
+                             spi_device_handle_t *handle)
+{
+    struct sim_spi_device *dev;
+    if (host >= SIM_SPI_HOSTS || !bus_used[host] || dev_config->clock_speed_hz <= 0)
+        return ESP_ERR_INVALID_ARG;
+    dev = calloc(1, sizeof(*dev));
+    if (dev == NULL)
+        return ESP_FAIL;
+    dev->host = host;
+    dev->cfg = *dev_config;
+    bus_devices[host]++;
+    *handle = dev;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle)
+{
+    if (handle == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (handle->count)
+        return ESP_ERR_INVALID_STATE;
+    bus_devices[handle->host]--;
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host)
+{
+    if (host >= SIM_SPI_HOSTS || !bus_used[host] || bus_devices[host])
+        return ESP_ERR_INVALID_STATE;
+    bus_used[host] = 0;
+    return ESP_OK;
+}
+
+static int tx_bit(const struct sim_spi_device *dev, const uint8_t *data, size_t i)
+{
+    if (dev->cfg.flags & SPI_DEVICE_TXBIT_LSBFIRST)
+        return (data[i / 8] >> (i % 8)) & 0x01;
+    return (data[i / 8] >> (7 - i % 8)) & 0x01;
+}
+
+/* Clock one transaction onto the pins from start, returns when it ends */
+static uint64_t clock_out(struct sim_spi_device *dev, spi_transaction_t *t, uint64_t start)
+{
+    const spi_bus_config_t *bus = &buses[dev->host];
+    int data_pin = bus->mosi_io_num;
+    int in_pin = (dev->cfg.flags & SPI_DEVICE_3WIRE) ? bus->mosi_io_num : bus->miso_io_num;
+    const uint8_t *tx = (t->flags & SPI_TRANS_USE_TXDATA) ? t->tx_data : t->tx_buffer;
+    uint8_t *rx = (t->flags & SPI_TRANS_USE_RXDATA) ? t->rx_data : t->rx_buffer;
+    size_t rxlength = t->rxlength;
+    uint64_t half = 500000000ULL / dev->cfg.clock_speed_hz;
+    uint64_t ns = start;
+    size_t i;
+
+    sim_gpio_at(start);
+    if (dev->cfg.pre_cb)
+        dev->cfg.pre_cb(t);
+    for (i = 0; i < t->length; i++) {
+        sim_gpio_bus_edge(bus->sclk_io_num, 0, ns);
+        sim_gpio_bus_edge(data_pin, tx_bit(dev, tx, i), ns);
+        sim_gpio_bus_edge(bus->sclk_io_num, 1, ns + half);
+        ns += 2 * half;
+    }
+    if (rxlength)
+        memset(rx, 0, (rxlength + 7) / 8);
+    for (i = 0; i < rxlength; i++) {
+        int bit;
+        sim_gpio_bus_edge(bus->sclk_io_num, 0, ns);
+        sim_gpio_bus_edge(bus->sclk_io_num, 1, ns + half);
+        ns += 2 * half;
+        bit = sim_gpio_sample(in_pin);
+        if (dev->cfg.flags & SPI_DEVICE_RXBIT_LSBFIRST)
+            rx[i / 8] |= bit << (i % 8);
+        else
+            rx[i / 8] |= bit << (7 - i % 8);
+    }
+    sim_gpio_at(ns + SIM_SPI_ISR_NS);
+    if (dev->cfg.post_cb)
+        dev->cfg.post_cb(t);
+    sim_gpio_at(0);
+    return ns;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t dev, spi_transaction_t *t, TickType_t ticks_to_wait)
+{
+    uint64_t start;
+    int slot;
+    (void) ticks_to_wait;
+    if (dev->count == SIM_SPI_QUEUE || dev->count == dev->cfg.queue_size)
+        return ESP_ERR_TIMEOUT;
+    sim_advance_ns(SIM_SPI_QUEUE_NS);
+    start = sim_now_ns() > bus_free_ns[dev->host] ? sim_now_ns() : bus_free_ns[dev->host];
+    /* Free again once the interrupt has finished with it */
+    bus_free_ns[dev->host] = clock_out(dev, t, start) + 2 * SIM_SPI_ISR_NS;
+    slot = (dev->head + dev->count) % SIM_SPI_QUEUE;
+    dev->queue[slot] = t;
+    dev->done_ns[slot] = bus_free_ns[dev->host] - SIM_SPI_ISR_NS;
+    dev->count++;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t dev, spi_transaction_t **t, TickType_t ticks_to_wait)
+{
+    (void) ticks_to_wait;
+    if (dev->count == 0)
+        return ESP_ERR_TIMEOUT;
+    /* The CPU is free while the DMA runs */
+    while (sim_now_ns() < dev->done_ns[dev->head])
+        sim_block(dev, dev->done_ns[dev->head]);
+    *t = dev->queue[dev->head];
+    dev->head = (dev->head + 1) % SIM_SPI_QUEUE;
+    dev->count--;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t dev, spi_transaction_t *t)
+{
+    spi_transaction_t *done;
+    esp_err_t err = spi_device_queue_trans(dev, t, portMAX_DELAY);
+    if (err != ESP_OK)
+        return err;
+    return spi_device_get_trans_result(dev, &done, portMAX_DELAY);
+}
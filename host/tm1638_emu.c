@@ -0,0 +1,212 @@
+/*
+ * TM1638 "LED&KEY" board emulator, see tm1638_emu.h
+ *
+ * Like the real chip, data is sampled LSB first on the rising clock edge
+ * and key scan data is clocked out on the falling edge.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "tm1638_emu.h"
+
+/* Segment patterns (PGFEDCBA) and the characters they are rendered as */
+static const struct {
+    uint8_t seg;
+    char ch;
+} glyphs[] = {
+    {0x00, ' '}, {0x3f, '0'}, {0x06, '1'}, {0x5b, '2'}, {0x4f, '3'},
+    {0x66, '4'}, {0x6d, '5'}, {0x7d, '6'}, {0x07, '7'}, {0x7f, '8'},
+    {0x6f, '9'}, {0x77, 'A'}, {0x7c, 'b'}, {0x39, 'C'}, {0x5e, 'd'},
+    {0x79, 'E'}, {0x71, 'F'}, {0x40, '-'},
+};
+
+void tm1638_emu_init(tm1638_emu *emu, uint8_t strobe_pin,
+                     uint8_t clock_pin, uint8_t data_pin)
+{
+    memset(emu, 0, sizeof(*emu));
+    emu->strobe_pin = strobe_pin;
+    emu->clock_pin = clock_pin;
+    emu->data_pin = data_pin;
+    emu->stb = 1;
+    emu->clk = 1;
+    emu->dio = 1;
+    /* Idle for ever before the first edge */
+    emu->clk_ns = INT64_MIN / 2;
+    emu->clk_rise_ns = INT64_MIN / 2;
+    emu->dio_ns = INT64_MIN / 2;
+    emu->stb_rise_ns = INT64_MIN / 2;
+    emu->command_ns = INT64_MIN / 2;
+}
+
+void tm1638_emu_reset_stats(tm1638_emu *emu)
+{
+    emu->edges = 0;
+    emu->sessions = 0;
+    emu->commands = 0;
+    emu->bytes_written = 0;
+    emu->bytes_read = 0;
+    emu->protocol_errors = 0;
+    emu->timing_errors = 0;
+    emu->timing_error = NULL;
+}
+
+/* Check that at least min ns passed since a line last moved */
+static void check_time(tm1638_emu *emu, int64_t ns, int64_t since, int64_t min,
+                       const char *what)
+{
+    if (ns - since >= min)
+        return;
+    if (emu->timing_errors++ == 0)
+        emu->timing_error = what;
+    emu->protocol_errors++;
+}
+
+/*
+ * Key scan byte n as the chip would send it:
+ * bit 0 is S(n+1) and bit 4 is S(n+5)
+ */
+static uint8_t key_byte(const tm1638_emu *emu, int n)
+{
+    return ((emu->keys >> (7 - n)) & 0x01) | (((emu->keys >> (3 - n)) & 0x01) << 4);
+}
+
+static void handle_byte(tm1638_emu *emu, uint8_t value)
+{
+    if (emu->bytes_in_session++ == 0) {
+        emu->commands++;
+        switch (value & 0xc0) {
+            case 0x40:
+                emu->data_cmd = value;
+                if (value & 0x02) {
+                    emu->reading = 1;
+                    emu->read_bits = 0;
+                }
+                break;
+            case 0x80:
+                emu->control = value;
+                break;
+            case 0xc0:
+                emu->address = value & 0x0f;
+                break;
+            default:
+                emu->protocol_errors++;
+        }
+    } else {
+        /* Display data following an address command */
+        emu->ram[emu->address] = value;
+        emu->bytes_written++;
+        if (!(emu->data_cmd & 0x04))
+            emu->address = (emu->address + 1) & 0x0f;
+    }
+}
+
+void tm1638_emu_pin(tm1638_emu *emu, int pin, int level, uint64_t at)
+{
+    int64_t ns = (int64_t) at;
+    level = level ? 1 : 0;
+    if (pin == emu->strobe_pin) {
+        if (level == emu->stb)
+            return;
+        emu->edges++;
+        emu->stb = level;
+        if (level == 0) {
+            check_time(emu, ns, emu->stb_rise_ns, TM1638_PW_STB_NS, "strobe pulse width");
+            emu->clocked = 0;
+            emu->sessions++;
+            emu->bits = 0;
+            emu->shift = 0;
+            emu->bytes_in_session = 0;
+        } else {
+            if (emu->clocked)
+                check_time(emu, ns, emu->clk_rise_ns, TM1638_CLK_STB_NS, "clock to strobe");
+            emu->stb_rise_ns = ns;
+            if (emu->bits != 0)
+                emu->protocol_errors++;
+            emu->reading = 0;
+        }
+    } else if (pin == emu->clock_pin) {
+        if (level == emu->clk)
+            return;
+        emu->edges++;
+        emu->clk = level;
+        if (emu->stb) {
+            emu->clk_ns = ns;
+            return;
+        }
+        check_time(emu, ns, emu->clk_ns, TM1638_PW_CLK_NS, "clock pulse width");
+        emu->clk_ns = ns;
+        emu->clocked = 1;
+        if (level == 1)
+            emu->clk_rise_ns = ns;
+        if (emu->reading) {
+            if (level == 0) {
+                /* Shift out the next key scan bit */
+                int n = (emu->read_bits / 8) & 0x03;
+                if (emu->read_bits == 0)
+                    check_time(emu, ns, emu->command_ns, TM1638_WAIT_NS, "Twait");
+                emu->out_bit = (key_byte(emu, n) >> (emu->read_bits % 8)) & 0x01;
+                if (++emu->read_bits % 8 == 0)
+                    emu->bytes_read++;
+            }
+        } else if (level == 1) {
+            check_time(emu, ns, emu->dio_ns, TM1638_SETUP_NS, "data setup");
+            emu->shift |= emu->dio << emu->bits;
+            if (++emu->bits == 8) {
+                emu->command_ns = ns;
+                handle_byte(emu, emu->shift);
+                emu->bits = 0;
+                emu->shift = 0;
+            }
+        }
+    } else if (pin == emu->data_pin) {
+        if (level == emu->dio)
+            return;
+        emu->edges++;
+        emu->dio = level;
+        if (!emu->stb && !emu->reading)
+            check_time(emu, ns, emu->clk_rise_ns, TM1638_HOLD_NS, "data hold");
+        emu->dio_ns = ns;
+    }
+}
+
+/* Is the chip currently driving this pin? */
+int tm1638_emu_drives(const tm1638_emu *emu, int pin)
+{
+    return pin == emu->data_pin && emu->reading && !emu->stb;
+}
+
+int tm1638_emu_data_out(const tm1638_emu *emu)
+{
+    return emu->out_bit;
+}
+
+void tm1638_emu_set_keys(tm1638_emu *emu, uint8_t keys)
+{
+    emu->keys = keys;
+}
+
+/*
+ * Render the 8 digits as text (9 bytes including the terminator, decimal
+ * points are ignored) and the LED row as a bitmask with LED 1 in bit 7
+ */
+void tm1638_emu_render(const tm1638_emu *emu, char *text, uint8_t *leds)
+{
+    int i, j;
+    uint8_t row = 0;
+    for (i = 0; i < 8; i++) {
+        uint8_t seg = emu->ram[2 * i] & 0x7f;
+        char ch = '?';
+        for (j = 0; j < (int) (sizeof(glyphs) / sizeof(glyphs[0])); j++) {
+            if (glyphs[j].seg == seg) {
+                ch = glyphs[j].ch;
+                break;
+            }
+        }
+        text[i] = ch;
+        if (emu->ram[2 * i + 1] & 0x01)
+            row |= 0x80 >> i;
+    }
+    text[8] = '\0';
+    if (leds)
+        *leds = row;
+}
@@ -0,0 +1,90 @@
+/*
+ * TM1638 "LED&KEY" board emulator
+ *
+ * Decodes strobe/clock/data edges into the chip's commands:
+ *   0x40 / 0x44 - data command, auto-increment / fixed address write
+ *   0x42        - key scan read, the chip then clocks out 4 bytes
+ *   0x8?        - display control
+ *   0xC?        - set address, followed by display data
+ * and keeps counters of everything seen on the bus so the host simulation
+ * can report bus edges per frame.
+ *
+ * Each edge comes with its time on the virtual clock and is checked against
+ * the datasheet's timings.  A violation counts as a protocol error as well
+ * as a timing error, so every sim mode fails on one:
+ *   TM1638_PW_CLK_NS    clock high or low
+ *   TM1638_SETUP_NS     data before the rising clock edge it is sampled on
+ *   TM1638_HOLD_NS      data after that edge
+ *   TM1638_WAIT_NS      Twait, the read command's last rising clock edge
+ *                       to the first falling edge of the key scan
+ *   TM1638_CLK_STB_NS   the last rising clock edge to the strobe going high
+ *   TM1638_PW_STB_NS    strobe high between transfers
+ */
+#ifndef TM1638_EMU_H
+#define TM1638_EMU_H
+
+#include <stdint.h>
+
+#define TM1638_RAM_SIZE 16
+
+#define TM1638_PW_CLK_NS 400
+#define TM1638_SETUP_NS 100
+#define TM1638_HOLD_NS 100
+#define TM1638_WAIT_NS 1000
+#define TM1638_CLK_STB_NS 1000
+#define TM1638_PW_STB_NS 1000
+
+typedef struct tm1638_emu {
+    uint8_t strobe_pin;
+    uint8_t clock_pin;
+    uint8_t data_pin;
+
+    /* Last seen pin levels */
+    uint8_t stb;
+    uint8_t clk;
+    uint8_t dio;
+
+    /* Transfer decoding */
+    uint8_t shift;
+    uint8_t bits;
+    uint8_t bytes_in_session;
+    uint8_t reading;
+    uint8_t read_bits;
+    uint8_t out_bit;
+    uint8_t data_cmd;
+    uint8_t address;
+
+    /* When each line last moved, ns */
+    int64_t clk_ns;
+    int64_t clk_rise_ns;
+    int64_t dio_ns;
+    int64_t stb_rise_ns;
+    int64_t command_ns;     /* Last rising edge of a read command */
+    uint8_t clocked;        /* Clock edges since the strobe went low */
+
+    /* Chip state */
+    uint8_t ram[TM1638_RAM_SIZE];
+    uint8_t control;
+    uint8_t keys;            /* S1..S8 as bit 7..bit 0, as read_buttons() reports */
+
+    /* Statistics */
+    uint64_t edges;          /* level transitions on any of the three pins */
+    uint64_t sessions;       /* strobe low..high transfers */
+    uint64_t commands;       /* first byte of a session */
+    uint64_t bytes_written;  /* display RAM writes */
+    uint64_t bytes_read;     /* key scan bytes clocked out */
+    uint64_t protocol_errors;
+    uint64_t timing_errors;
+    const char *timing_error;   /* The first one, by name */
+} tm1638_emu;
+
+extern void tm1638_emu_init(tm1638_emu *emu, uint8_t strobe_pin,
+                            uint8_t clock_pin, uint8_t data_pin);
+extern void tm1638_emu_reset_stats(tm1638_emu *emu);
+extern void tm1638_emu_pin(tm1638_emu *emu, int pin, int level, uint64_t ns);
+extern int tm1638_emu_drives(const tm1638_emu *emu, int pin);
+extern int tm1638_emu_data_out(const tm1638_emu *emu);
+extern void tm1638_emu_set_keys(tm1638_emu *emu, uint8_t keys);
+extern void tm1638_emu_render(const tm1638_emu *emu, char *text, uint8_t *leds);
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Decode trace_dump() output into log lines
+ *
+ *   trace_decode [FILE]
+ *
+ * Reads a serial capture (or stdin), picks out the TR lines trace_dump()
+ * printed and ignores everything else.  Records from both cores are put
+ * back into time order and formatted with the strings from TRACE_EVENTS
+ * in main/trace.h, so the device never has to.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "trace.h"
+
+typedef struct {
+    int core;
+    uint64_t time;              /* us, unwrapped */
+    unsigned event;
+    uint32_t a;
+    uint32_t b;
+    unsigned long order;        /* Keeps equal times in dump order */
+} decoded;
+
+#define TRACE_EVENT(id, tag, format) {tag, format},
+static const struct {
+    const char *tag;
+    const char *format;
+} events[TRACE_EVENT_COUNT] = {
+    TRACE_EVENTS
+};
+#undef TRACE_EVENT
+
+static int by_time(const void *x, const void *y)
+{
+    const decoded *p = x, *q = y;
+    if (p->time != q->time)
+        return p->time < q->time ? -1 : 1;
+    return p->order < q->order ? -1 : p->order > q->order;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    char line[256];
+    decoded *records = NULL;
+    size_t count = 0, size = 0, i;
+    uint64_t base[8] = {0};
+    uint32_t last[8] = {0};
+    unsigned core, time, event, a, b;
+
+    if (argc > 1 && (in = fopen(argv[1], "r")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), in)) {
+        if (sscanf(line, "TR %u %x %x %x %x", &core, &time, &event, &a, &b) != 5 ||
+            core >= 8)
+            continue;
+        if (count == size) {
+            size = size ? 2 * size : 1024;
+            records = realloc(records, size * sizeof(*records));
+            if (records == NULL) {
+                perror("realloc");
+                return 1;
+            }
+        }
+        /* Each core's records are in order, so going backwards is a wrap */
+        if (time < last[core])
+            base[core] += (uint64_t) 1 << 32;
+        last[core] = time;
+        records[count].core = (int) core;
+        records[count].time = base[core] + time;
+        records[count].event = event;
+        records[count].a = a;
+        records[count].b = b;
+        records[count].order = count;
+        count++;
+    }
+    qsort(records, count, sizeof(*records), by_time);
+    for (i = 0; i < count; i++) {
+        printf("T (%llu.%03llu) [%d] ", (unsigned long long) (records[i].time / 1000),
+               (unsigned long long) (records[i].time % 1000), records[i].core);
+        if (records[i].event < TRACE_EVENT_COUNT) {
+            printf("%s: ", events[records[i].event].tag);
+            printf(events[records[i].event].format, records[i].a, records[i].b);
+        } else {
+            printf("event %04x: %08x %08x", records[i].event, records[i].a, records[i].b);
+        }
+        putchar('\n');
+    }
+    fprintf(stderr, "%zu records\n", count);
+    free(records);
+    return 0;
+}
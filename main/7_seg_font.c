@@ -0,0 +1,65 @@
+#include <stdint.h>
+
+#include "7_seg_font.h"
+
+/*
+ * Letters that 7 segments cannot really do (K, M, V, W, X) get the
+ * nearest look-alike
+ */
+const uint8_t seven_seg_font[SEVEN_SEG_FONT_LAST - SEVEN_SEG_FONT_FIRST + 1] = {
+    /*  ' '   !     "     #     $     %     &     '  */
+        0x00, 0x86, 0x22, 0x7e, 0x6d, 0xd2, 0x46, 0x20,
+    /*  (     )     *     +     ,     -     .     /  */
+        0x39, 0x0f, 0x63, 0x70, 0x10, 0x40, 0x80, 0x52,
+    /*  0     1     2     3     4     5     6     7  */
+        0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07,
+    /*  8     9     :     ;     <     =     >     ?  */
+        0x7f, 0x6f, 0x09, 0x0d, 0x58, 0x48, 0x4c, 0xd3,
+    /*  @     A     B     C     D     E     F     G  */
+        0x5f, 0x77, 0x7c, 0x39, 0x5e, 0x79, 0x71, 0x3d,
+    /*  H     I     J     K     L     M     N     O  */
+        0x76, 0x30, 0x1e, 0x75, 0x38, 0x15, 0x37, 0x3f,
+    /*  P     Q     R     S     T     U     V     W  */
+        0x73, 0x6b, 0x33, 0x6d, 0x78, 0x3e, 0x3e, 0x2a,
+    /*  X     Y     Z     [     \     ]     ^     _  */
+        0x76, 0x6e, 0x5b, 0x39, 0x64, 0x0f, 0x23, 0x08,
+    /*  `     a     b     c     d     e     f     g  */
+        0x02, 0x5f, 0x7c, 0x58, 0x5e, 0x7b, 0x71, 0x6f,
+    /*  h     i     j     k     l     m     n     o  */
+        0x74, 0x10, 0x0c, 0x75, 0x30, 0x14, 0x54, 0x5c,
+    /*  p     q     r     s     t     u     v     w  */
+        0x73, 0x67, 0x50, 0x6d, 0x78, 0x1c, 0x1c, 0x14,
+    /*  x     y     z     {     |     }     ~        */
+        0x76, 0x6e, 0x5b, 0x46, 0x30, 0x70, 0x01,
+};
+
+/* A decimal digit as a constant expression, so the tables below fold */
+#define DIGIT(n) ((n) == 0 ? 0x3f : (n) == 1 ? 0x06 : (n) == 2 ? 0x5b : \
+                  (n) == 3 ? 0x4f : (n) == 4 ? 0x66 : (n) == 5 ? 0x6d : \
+                  (n) == 6 ? 0x7d : (n) == 7 ? 0x07 : (n) == 8 ? 0x7f : 0x6f)
+
+#define PAIR(n) {DIGIT((n) / 10), DIGIT((n) % 10)}
+#define PAIRS10(n) PAIR(n), PAIR(n + 1), PAIR(n + 2), PAIR(n + 3), PAIR(n + 4), \
+                   PAIR(n + 5), PAIR(n + 6), PAIR(n + 7), PAIR(n + 8), PAIR(n + 9)
+
+const uint8_t seven_seg_pairs[100][2] = {
+    PAIRS10(0), PAIRS10(10), PAIRS10(20), PAIRS10(30), PAIRS10(40),
+    PAIRS10(50), PAIRS10(60), PAIRS10(70), PAIRS10(80), PAIRS10(90),
+};
+
+#define MMSS(s) {DIGIT((s) / 600), \
+                 DIGIT((s) / 60 % 10) | ((s) % 2 == 0 ? SEVEN_SEG_DP : 0), \
+                 DIGIT((s) % 60 / 10), \
+                 DIGIT((s) % 10)}
+#define MMSS10(s) MMSS(s), MMSS(s + 1), MMSS(s + 2), MMSS(s + 3), MMSS(s + 4), \
+                  MMSS(s + 5), MMSS(s + 6), MMSS(s + 7), MMSS(s + 8), MMSS(s + 9)
+#define MMSS60(s) MMSS10(s), MMSS10(s + 10), MMSS10(s + 20), \
+                  MMSS10(s + 30), MMSS10(s + 40), MMSS10(s + 50)
+#define MMSS600(s) MMSS60(s), MMSS60(s + 60), MMSS60(s + 120), MMSS60(s + 180), \
+                   MMSS60(s + 240), MMSS60(s + 300), MMSS60(s + 360), \
+                   MMSS60(s + 420), MMSS60(s + 480), MMSS60(s + 540)
+
+const uint8_t seven_seg_timer[SEVEN_SEG_TIMER_SECONDS][4] = {
+    MMSS600(0), MMSS600(600), MMSS600(1200),
+    MMSS600(1800), MMSS600(2400), MMSS600(3000),
+};
@@ -0,0 +1,34 @@
+#ifndef SEVEN_SEG_FONT_H
+#define SEVEN_SEG_FONT_H
+
+#include <stdint.h>
+
+/*
+ * Glyph tables for the 7-segment digits
+ * Everything here is built by the compiler from the macros in
+ * 7_seg_font.c and, being const, stays in flash.  Bit 0 is segment A
+ * through to bit 6 for G, bit 7 is the decimal point.
+ */
+#define SEVEN_SEG_DP 0x80
+
+/* Printable ASCII, ' ' to '~' */
+#define SEVEN_SEG_FONT_FIRST ' '
+#define SEVEN_SEG_FONT_LAST '~'
+extern const uint8_t seven_seg_font[SEVEN_SEG_FONT_LAST - SEVEN_SEG_FONT_FIRST + 1];
+
+/* Segments for a character, unknown ones are blank */
+#define SEVEN_SEG_GLYPH(ch) \
+    (((ch) >= SEVEN_SEG_FONT_FIRST && (ch) <= SEVEN_SEG_FONT_LAST) ? \
+     seven_seg_font[(ch) - SEVEN_SEG_FONT_FIRST] : 0x00)
+
+/* 00 to 99 as two digits */
+extern const uint8_t seven_seg_pairs[100][2];
+
+/*
+ * MM:SS for every second up to SEVEN_SEG_TIMER_SECONDS, with the decimal
+ * point after the minutes lit on even seconds
+ */
+#define SEVEN_SEG_TIMER_SECONDS 3600
+extern const uint8_t seven_seg_timer[SEVEN_SEG_TIMER_SECONDS][4];
+
+#endif
@@ -0,0 +1,187 @@
+#include "freertos/FreeRTOS.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+
+#include "7_seg_ui.h"
+#include "7_seg_spi.h"
+
+static const char *TAG = "7-seg-spi";
+
+/* Writes that can be in flight at once */
+#define SPI_SLOTS 4
+
+typedef struct {
+    spi_device_handle_t device;
+    spi_device_handle_t reader;
+    int head;
+    int in_flight;
+    spi_transaction_t trans[SPI_SLOTS];
+    /* DMA reads whole words, keep each buffer word aligned */
+    uint32_t buffer[SPI_SLOTS][(DISPLAY_FRAME_BYTES + 3) / 4];
+} spi_context;
+
+/* There is the one SPI host for the displays, so the one context */
+static DMA_ATTR spi_context spi_ctx;
+
+
+/*
+ * Wait until no more than keep writes are still in flight
+ * Results come back in the order they were queued
+ */
+static void spi_wait(spi_context *ctx, int keep)
+{
+    spi_transaction_t *done;
+    while (ctx->in_flight > keep) {
+        spi_device_get_trans_result(ctx->device, &done, portMAX_DELAY);
+        ctx->in_flight--;
+    }
+}
+
+
+/*
+ * Queue one strobe framed transfer
+ * The data is copied, so the caller's buffer can be reused straight away
+ */
+static void spi_write(seven_segment_ui *display, const uint8_t *data, int len)
+{
+    spi_context *ctx = display->transport_ctx;
+    spi_transaction_t *t;
+
+    if (len > DISPLAY_FRAME_BYTES) {
+        ESP_LOGE(TAG, "Transfer of %d bytes is too long", len);
+        return;
+    }
+    /* The oldest slot is free once at most SPI_SLOTS - 1 are in flight */
+    spi_wait(ctx, SPI_SLOTS - 1);
+    t = &ctx->trans[ctx->head];
+    memcpy(ctx->buffer[ctx->head], data, len);
+    memset(t, 0, sizeof(*t));
+    t->length = len * 8;
+    t->tx_buffer = ctx->buffer[ctx->head];
+    /* The strobe to frame it with, the display may select another board
+     * before this one goes out */
+    t->user = (void *) (intptr_t) display->strobe_pin;
+    if (spi_device_queue_trans(ctx->device, t, portMAX_DELAY) != ESP_OK) {
+        ESP_LOGE(TAG, "Unable to queue transfer");
+        return;
+    }
+    ctx->in_flight++;
+    ctx->head = (ctx->head + 1) % SPI_SLOTS;
+}
+
+
+/*
+ * Key scan as a single half-duplex transaction
+ * 0x42 goes out, then the 4 key bytes are read back on the same wire.
+ * The TM1638 needs 1us between the command and the first read clock, which
+ * there is no way to ask the SPI peripheral for, so reads use a second
+ * device on the bus clocked slowly enough that half a period covers it.
+ */
+static void spi_read_keys(seven_segment_ui *display, uint8_t *keys)
+{
+    spi_context *ctx = display->transport_ctx;
+    spi_transaction_t t;
+
+    spi_wait(ctx, 0);
+    memset(&t, 0, sizeof(t));
+    t.flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA;
+    t.length = 8;
+    t.rxlength = 32;
+    t.tx_data[0] = 0x42;
+    t.user = (void *) (intptr_t) display->strobe_pin;
+    if (spi_device_transmit(ctx->reader, &t) != ESP_OK) {
+        ESP_LOGE(TAG, "Key scan failed");
+        memset(keys, 0, 4);
+        return;
+    }
+    memcpy(keys, t.rx_data, 4);
+}
+
+
+/*
+ * The strobe is driven from the transaction callbacks rather than as a
+ * hardware chip select, so both devices can share it
+ */
+static void IRAM_ATTR spi_strobe_low(spi_transaction_t *t)
+{
+    gpio_set_level((intptr_t) t->user, 0);
+}
+
+static void IRAM_ATTR spi_strobe_high(spi_transaction_t *t)
+{
+    gpio_set_level((intptr_t) t->user, 1);
+}
+
+
+static int spi_init(seven_segment_ui *display)
+{
+    spi_context *ctx = &spi_ctx;
+    esp_err_t err;
+    int b;
+
+    spi_bus_config_t bus = {
+        .mosi_io_num = display->data_pin,
+        .miso_io_num = -1,
+        .sclk_io_num = display->clock_pin,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = DISPLAY_FRAME_BYTES,
+    };
+    spi_device_interface_config_t dev = {
+        .mode = 3,                      /* Clock idles high, sample on rising edge */
+        .clock_speed_hz = SEVEN_SEG_SPI_CLOCK_HZ,
+        .spics_io_num = -1,
+        .flags = SPI_DEVICE_3WIRE | SPI_DEVICE_HALFDUPLEX | SPI_DEVICE_BIT_LSBFIRST,
+        .queue_size = SPI_SLOTS,
+        .pre_cb = spi_strobe_low,
+        .post_cb = spi_strobe_high,
+    };
+    spi_device_interface_config_t reader = dev;
+    reader.clock_speed_hz = SEVEN_SEG_SPI_READ_CLOCK_HZ;
+    reader.queue_size = 1;
+
+    if (ctx->device != NULL) {
+        ESP_LOGE(TAG, "SPI transport already in use");
+        return -1;
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    for (b=0; b<display->boards; b++) {
+        gpio_pad_select_gpio(display->strobe_pins[b]);
+        gpio_set_direction(display->strobe_pins[b], GPIO_MODE_OUTPUT);
+        gpio_set_level(display->strobe_pins[b], 1);
+    }
+    /* The transfer buffers are static, the bus holds the DMA channel */
+    err = spi_bus_initialize(SEVEN_SEG_SPI_HOST, &bus, SEVEN_SEG_SPI_DMA_CHAN);
+    if (err == ESP_OK) {
+        err = spi_bus_add_device(SEVEN_SEG_SPI_HOST, &dev, &ctx->device);
+        if (err == ESP_OK) {
+            err = spi_bus_add_device(SEVEN_SEG_SPI_HOST, &reader, &ctx->reader);
+            /* Undo what did work, last first */
+            if (err != ESP_OK)
+                spi_bus_remove_device(ctx->device);
+        }
+        if (err != ESP_OK)
+            spi_bus_free(SEVEN_SEG_SPI_HOST);
+    }
+    if (err != ESP_OK) {
+        /* So the transport can be tried again */
+        memset(ctx, 0, sizeof(*ctx));
+        ESP_LOGE(TAG, "SPI setup failed: %d", err);
+        return -1;
+    }
+    display->transport_ctx = ctx;
+    return 0;
+}
+
+const seven_segment_transport spi_transport = {
+    .name = "spi",
+    .init = spi_init,
+    .write = spi_write,
+    .read_keys = spi_read_keys,
+};
@@ -0,0 +1,30 @@
+#ifndef SEVEN_SEG_SPI_H
+#define SEVEN_SEG_SPI_H
+
+#include "7_seg_ui.h"
+
+/*
+ * SPI transport for the TM1638
+ * Uses the HSPI peripheral in 3-wire half-duplex LSB-first mode, with the
+ * strobe acting as chip select.  Writes are queued as DMA transactions so
+ * the CPU is free while a frame is on the wire.  With the data command only
+ * sent when it changes, a bulk refresh is a single transaction.
+ */
+#ifndef SEVEN_SEG_SPI_HOST
+#define SEVEN_SEG_SPI_HOST HSPI_HOST
+#endif
+#ifndef SEVEN_SEG_SPI_DMA_CHAN
+#define SEVEN_SEG_SPI_DMA_CHAN 1
+#endif
+/* The TM1638 is rated to 1MHz */
+#ifndef SEVEN_SEG_SPI_CLOCK_HZ
+#define SEVEN_SEG_SPI_CLOCK_HZ 1000000
+#endif
+/* Half a period at 500kHz is the 1us the chip needs before key data */
+#ifndef SEVEN_SEG_SPI_READ_CLOCK_HZ
+#define SEVEN_SEG_SPI_READ_CLOCK_HZ 500000
+#endif
+
+extern const seven_segment_transport spi_transport;
+
+#endif
@@ -2,12 +2,27 @@
 #include "freertos/task.h"
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include "7_seg_ui.h"
+#include "7_seg_font.h"
 
 #include "esp_system.h"
 #include "esp_log.h"
+#include "driver/gpio.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "xtensa/hal.h"
 
 #include "esp_useful.h"
+#include "display_service.h"
+#include "power.h"
+#include "animation.h"
+#include "display_mirror.h"
+#include "latency.h"
+#include "deadline.h"
+#include "trace.h"
+#include "profile.h"
 
 static const char *TAG = "7-seg";
 
@@ -35,21 +50,117 @@ uint8_t set_all[] = {0xff, 0x01, 0xff, 0x01, 0xff, 0x01, 0xff, 0x01,
 uint8_t set_none[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
                                 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 
+/*
+ * Keep the TM1638's minimum timings between edges
+ * Called just before an edge, waits until more than cycles have passed
+ * since the previous one, so the pin changes themselves count.  More
+ * than, as the counter can tick just after one edge and just before the
+ * next.  Each edge must follow its wait straight away.
+ */
+static uint32_t bb_last_edge;
+
+static inline void bb_wait(uint32_t cycles)
+{
+    uint32_t now;
+    if (cycles == 0)
+        return;
+    do {
+        now = xthal_get_ccount();
+    } while (now - bb_last_edge <= cycles);
+    bb_last_edge = now;
+}
+
+/* Each clock phase above the 400ns minimum pulse width */
+static inline void bb_clock_edge(void)
+{
+    bb_wait(SEVEN_SEG_HALF_PERIOD_CYCLES);
+}
+
+#if SEVEN_SEG_FAST_PATH
+/*
+ * Register-level fast path
+ * The clock and data pins are fixed at compile time so every pin change
+ * is a single store of a constant mask to the W1TS (set) or W1TC (clear)
+ * register.  The strobe mask follows the selected board.
+ */
+#define FAST_CLK (1UL << SEVEN_SEG_CLOCK_PIN)
+#define FAST_DAT (1UL << SEVEN_SEG_DATA_PIN)
+
+static inline void fast_send_byte(uint8_t value)
+{
+    int i;
+    for (i=0; i<8; i++) {
+        /* Take the clock low and set the data bit */
+        bb_clock_edge();
+        REG_WRITE(GPIO_OUT_W1TC_REG, FAST_CLK);
+        REG_WRITE(value & 0x01 ? GPIO_OUT_W1TS_REG : GPIO_OUT_W1TC_REG, FAST_DAT);
+        /* Take the clock high, the display samples on this edge */
+        bb_clock_edge();
+        REG_WRITE(GPIO_OUT_W1TS_REG, FAST_CLK);
+        value >>= 1;
+    }
+}
+
+/* Read one key scan byte, LSB first */
+static inline uint8_t fast_read_byte(void)
+{
+    int i;
+    uint8_t value = 0;
+    for (i=0; i<8; i++) {
+        bb_clock_edge();
+        REG_WRITE(GPIO_OUT_W1TC_REG, FAST_CLK);
+        bb_clock_edge();
+        REG_WRITE(GPIO_OUT_W1TS_REG, FAST_CLK);
+        value |= ((REG_READ(GPIO_IN_REG) >> SEVEN_SEG_DATA_PIN) & 0x01) << i;
+    }
+    return value;
+}
+#endif
+
+
+/*
+ * Set the strobe (chip select) level
+ */
+static inline void bb_strobe(seven_segment_ui *display, int level)
+{
+    /* 1us from the last clock edge to strobe high, and strobe high for
+     * 1us between transfers */
+    bb_wait(SEVEN_SEG_WAIT_CYCLES);
+#if SEVEN_SEG_FAST_PATH
+    if (display->fast) {
+        REG_WRITE(level ? GPIO_OUT_W1TS_REG : GPIO_OUT_W1TC_REG, display->strobe_mask);
+        return;
+    }
+#endif
+    gpio_set_level(display->strobe_pin, level);
+    /* Time the next wait from the edge rather than the driver call, in
+     * case the fast path makes it */
+    bb_last_edge = xthal_get_ccount();
+}
+
+
 /* 
  * Bit-banging to talk to the display
  * This function clocks a single byte out to the display
  */
-void bb_send_byte(seven_segment_ui *display, uint8_t value)
+static void bb_send_byte(seven_segment_ui *display, uint8_t value)
 {
     int i;
+#if SEVEN_SEG_FAST_PATH
+    if (display->fast) {
+        fast_send_byte(value);
+        return;
+    }
+#endif
     /* Loop through the data */
-    ESP_LOGV(TAG, "Sending byte: %02x", value);
+    TRACE_V(TRACE_BUS_BYTE, value, 0);
     for (i=0; i<16; i++) {
+        bb_clock_edge();
         if (i % 2 == 0) {
-            /* Set the data bit */
-            gpio_set_level(display->data_pin, (value >> i/2) & 0x01);
             /* Take the clock low */
             gpio_set_level(display->clock_pin, 0);
+            /* Set the data bit */
+            gpio_set_level(display->data_pin, (value >> i/2) & 0x01);
         } else {
             /* Take the clock high */
             gpio_set_level(display->clock_pin, 1);
@@ -58,6 +169,123 @@ void bb_send_byte(seven_segment_ui *display, uint8_t value)
 }
 
 
+/*
+ * Clock a single byte in from the display, LSB first
+ * The data pin must already be an input
+ */
+static uint8_t bb_read_byte(seven_segment_ui *display)
+{
+    int i;
+    uint8_t value = 0;
+#if SEVEN_SEG_FAST_PATH
+    if (display->fast)
+        return fast_read_byte();
+#endif
+    for (i=0; i<8; i++) {
+        /* Take the clock low, the display sets the data bit */
+        bb_clock_edge();
+        gpio_set_level(display->clock_pin, 0);
+        /* Take the clock high and read the data bit */
+        bb_clock_edge();
+        gpio_set_level(display->clock_pin, 1);
+        value |= (gpio_get_level(display->data_pin) & 0x01) << i;
+    }
+    return value;
+}
+
+
+/*
+ * Bit-bang transport: one strobe framed transfer
+ */
+static void bb_write(seven_segment_ui *display, const uint8_t *data, int len)
+{
+    int i;
+    /* Set the strobe low */
+    bb_strobe(display, 0);
+    for (i=0; i<len; i++)
+        bb_send_byte(display, data[i]);
+    /* Set the strobe high */
+    bb_strobe(display, 1);
+}
+
+
+/*
+ * Bit-bang transport: send the read command and clock in the 4 key bytes
+ */
+static void bb_read_keys(seven_segment_ui *display, uint8_t *keys)
+{
+    int i;
+    /* Set the strobe low */
+    bb_strobe(display, 0);
+    bb_send_byte(display, 0x42); // Read data command
+#if SEVEN_SEG_FAST_PATH
+    if (display->fast)
+        REG_WRITE(GPIO_ENABLE_W1TC_REG, FAST_DAT);
+    else
+#endif
+        gpio_set_direction(display->data_pin, GPIO_MODE_INPUT);
+    /* Twait: 1us from the command's last rising clock edge to the first
+     * falling one of the read */
+    bb_wait(SEVEN_SEG_WAIT_CYCLES);
+    for (i=0; i<4; i++)
+        keys[i] = bb_read_byte(display);
+#if SEVEN_SEG_FAST_PATH
+    if (display->fast)
+        REG_WRITE(GPIO_ENABLE_W1TS_REG, FAST_DAT);
+    else
+#endif
+        gpio_set_direction(display->data_pin, GPIO_MODE_OUTPUT);
+    /* Set the strobe high */
+    bb_strobe(display, 1);
+}
+
+
+/*
+ * Bit-bang transport: set up the pins
+ */
+static int bb_init(seven_segment_ui *display)
+{
+    int b;
+    display->fast = SEVEN_SEG_FAST_PATH &&
+                    display->clock_pin == SEVEN_SEG_CLOCK_PIN &&
+                    display->data_pin == SEVEN_SEG_DATA_PIN;
+    gpio_pad_select_gpio(display->data_pin);
+    gpio_pad_select_gpio(display->clock_pin);
+    gpio_set_direction(display->data_pin, GPIO_MODE_OUTPUT);
+    gpio_set_direction(display->clock_pin, GPIO_MODE_OUTPUT);
+    for (b=0; b<display->boards; b++) {
+        /* Any strobe the registers can reach will do */
+        if (display->strobe_pins[b] >= 32)
+            display->fast = 0;
+        gpio_pad_select_gpio(display->strobe_pins[b]);
+        gpio_set_direction(display->strobe_pins[b], GPIO_MODE_OUTPUT);
+        gpio_set_level(display->strobe_pins[b], 1);
+    }
+    gpio_set_level(display->clock_pin, 1);
+    ESP_LOGD(TAG, "Register fast path: %s", display->fast ? "yes" : "no");
+    return 0;
+}
+
+const seven_segment_transport bb_transport = {
+    .name = "bit-bang",
+    .init = bb_init,
+    .write = bb_write,
+    .read_keys = bb_read_keys,
+};
+
+
+/*
+ * Talk to board from now on
+ * Each board keeps its own data command, so that is tracked per board.
+ */
+void display_select(seven_segment_ui *display, int board)
+{
+    display->board = board;
+    display->strobe_pin = display->strobe_pins[board];
+    display->strobe_mask = 1UL << (display->strobe_pin & 0x1f);
+}
+
+
 /*
  * The display expects the initial command to be sent on its own
  * surrounded by chip select (strobe)
@@ -69,103 +297,179 @@ void bb_send_byte(seven_segment_ui *display, uint8_t value)
  */
 void bb_send_cmd(seven_segment_ui *display, uint8_t cmd)
 {
-    /* Set the strobe low */
-    gpio_set_level(display->strobe_pin, 0);
-    bb_send_byte(display, cmd);
-    /* Set the strobe high */
-    gpio_set_level(display->strobe_pin, 1);
+    display->transport->write(display, &cmd, 1);
+    display->bytes_sent++;
+}
+
+
+/*
+ * Data commands (0x4?) stay in effect until the next one,
+ * so only send one when the mode actually changes
+ */
+static void bb_data_cmd(seven_segment_ui *display, uint8_t cmd)
+{
+    if (display->data_cmd[display->board] != cmd) {
+        bb_send_cmd(display, cmd);
+        display->data_cmd[display->board] = cmd;
+    }
 }
 
 
 /*
- * A wrapper command to send data using auto-increment addressing
+ * A wrapper command to send a whole frame using auto-increment addressing
  */
-void bb_send(seven_segment_ui *display){
-    ESP_LOGV(TAG, "bb_send");
-    bb_send_cmd(display, 0x40); // Bulk update
+void bb_send(seven_segment_ui *display, const uint8_t *frame){
+    TRACE_V(TRACE_BUS_FRAME, 0, 0);
+    PROFILE_START(PROFILE_BB_SEND);
+    uint8_t data[DISPLAY_BUFFER_LENGTH + 1];
     int i;
-    /* Set the strobe low */
-    gpio_set_level(display->strobe_pin, 0);
-    bb_send_byte(display, 0xc0); // Start address
+    bb_data_cmd(display, 0x40); // Bulk update
+    data[0] = 0xc0; // Start address
     for (i=0; i<DISPLAY_BUFFER_LENGTH; i++){
-        bb_send_byte(display, display->display_buffer[i]);
+        data[i + 1] = frame[i];
     }
-    /* Set the strobe high */
-    gpio_set_level(display->strobe_pin, 1);
+    display->transport->write(display, data, sizeof(data));
+    display->bytes_sent += sizeof(data);
+    PROFILE_END(PROFILE_BB_SEND);
 }
 
 
 /*
- * Write a value to a single address
+ * Write a value to a single address, 2 bytes on the bus
+ * plus the fixed address command if we were not in that mode
  */
 void bb_send_address(seven_segment_ui *display, uint8_t address, uint8_t value)
 {
-    ESP_LOGV(TAG, "bb_send_address");
-    /* Set the strobe low */
-    gpio_set_level(display->strobe_pin, 0);
-    bb_send_byte(display, 0x44);
-    bb_send_byte(display, address);
-    bb_send_byte(display, value);
-    /* Set the strobe high */
-    gpio_set_level(display->strobe_pin, 1);
+    TRACE_V(TRACE_BUS_ADDRESS, address, value);
+    uint8_t data[2];
+    bb_data_cmd(display, 0x44); // Fixed address
+    data[0] = 0xc0 | (address & 0x0f);
+    data[1] = value;
+    display->transport->write(display, data, sizeof(data));
+    display->bytes_sent += sizeof(data);
 }
 
 /*
- * Read the buttons
+ * Read the buttons on board 0
  * This is polling only, you can't interrupt on press
+ * Key byte n holds S(n+1) in bit 0 and S(n+5) in bit 4,
+ * which are returned as S1 in bit 7 down to S8 in bit 0
  */
 uint8_t bb_read_buttons(seven_segment_ui *display)
 {
-    ESP_LOGV(TAG, "bb_read_buttons");
-    int i, j;
-    uint8_t value = 0;
-    uint8_t bit;
+    TRACE_V(TRACE_BUS_READ, 0, 0);
+    PROFILE_START(PROFILE_BB_READ_BUTTONS);
+    int i;
+    uint8_t keys[4];
     uint8_t buttons = 0;
-    /* Set the strobe low */
-    gpio_set_level(display->strobe_pin, 0);
-    bb_send_byte(display, 0x42); // Read data command
-    gpio_set_direction(display->data_pin, GPIO_MODE_INPUT);
+    display_select(display, 0);
+    display->transport->read_keys(display, keys);
+    display->key_scans++;
+    display->data_cmd[0] = 0x42;
     for (i=0; i<4; i++) {
-        for (j=0; j<16; j++) {
-            if (j % 2 == 0) {
-                /* Take the clock low */
-                gpio_set_level(display->clock_pin, 0);
-            } else {
-                /* Take the clock high */
-                gpio_set_level(display->clock_pin, 1);
-                /* Read the data bit */
-                bit = gpio_get_level(display->data_pin);
-                value = value << 1;
-                value |= (bit & 0x01);
-            }
-        }
-        buttons |= value >> i;
+        if (keys[i] & 0x01)
+            buttons |= 0x80 >> i;
+        if (keys[i] & 0x10)
+            buttons |= 0x08 >> i;
     }
-    gpio_set_direction(display->data_pin, GPIO_MODE_OUTPUT);
-    /* Set the strobe high */
-    gpio_set_level(display->strobe_pin, 1);
     if (buttons != 0)
-        ESP_LOGD(TAG, "Buttons: 0x%02x", buttons);
+        TRACE(TRACE_BUTTONS, buttons, 0);
+    PROFILE_END(PROFILE_BB_READ_BUTTONS);
     return buttons;
 }
 
 
 /*
- * Update the display with the values in the display buffer
+ * Send a frame and its flash mask to the display
+ * Only what changed since the last frame sent is sent, board by board
+ * in one pass over the bus:
+ * * Nothing changed - nothing is sent
+ * * A few bytes changed - single address writes, 2 bytes per change
+ * * Otherwise - a bulk write of the whole board
  */
-void update_display(seven_segment_ui *display)
+void display_present(seven_segment_ui *display, const uint8_t *buffer,
+                     uint8_t flash)
 {
-    int i;
-    ESP_LOGV(TAG, "Update display");
+    int i, b;
+    int changed;
+    int single, bulk;
+    int dirty = 0;
+    unsigned long sent;
+    uint8_t frame[DISPLAY_CHAIN_LENGTH];
+    uint8_t *board, *shadow;
+    PROFILE_START(PROFILE_DISPLAY_PRESENT);
+    memcpy(frame, buffer, display->boards * DISPLAY_BUFFER_LENGTH);
     /* Deal with flashing digits */
     if (((clock_ms() / 500) % 2) == 0) {
         for (i=0; i<8; i++){
-            if (display->flash & (0x01 << i)) {
-                display->display_buffer[2*(7-i)] = 0x00;
+            if (flash & (0x01 << i)) {
+                frame[2*(7-i)] = 0x00;
             }
         }
     }
-    bb_send(display);
+    for (b=0; b<display->boards; b++) {
+        board = &frame[b * DISPLAY_BUFFER_LENGTH];
+        shadow = &display->shadow[b * DISPLAY_BUFFER_LENGTH];
+        /* Work out how much has changed */
+        changed = 0;
+        for (i=0; i<DISPLAY_BUFFER_LENGTH; i++) {
+            if (board[i] != shadow[i])
+                changed++;
+        }
+        if (changed == 0 && display->shadow_valid) {
+            display->bytes_saved += DISPLAY_FRAME_BYTES;
+            continue;
+        }
+        dirty = 1;
+        display_select(display, b);
+        /* Cost of each way in bytes, including any change of data command */
+        single = 2 * changed + (display->data_cmd[b] != 0x44);
+        bulk = DISPLAY_BUFFER_LENGTH + 1 + (display->data_cmd[b] != 0x40);
+        sent = display->bytes_sent;
+        if (!display->shadow_valid || single >= bulk) {
+            bb_send(display, board);
+        } else {
+            for (i=0; i<DISPLAY_BUFFER_LENGTH; i++) {
+                if (board[i] != shadow[i])
+                    bb_send_address(display, i, board[i]);
+            }
+        }
+        display->bytes_saved += DISPLAY_FRAME_BYTES - (display->bytes_sent - sent);
+        memcpy(shadow, board, DISPLAY_BUFFER_LENGTH);
+    }
+    display->shadow_valid = 1;
+    if (dirty && display->mirror)
+        display_mirror_frame(display->mirror, display->shadow,
+                             display->boards * DISPLAY_BUFFER_LENGTH);
+    latency_presented();
+    PROFILE_END(PROFILE_DISPLAY_PRESENT);
+}
+
+
+/*
+ * Update the display with the values in the display buffer
+ * With the display service running this only hands the frame over to it
+ */
+void update_display(seven_segment_ui *display)
+{
+    TRACE_V(TRACE_UPDATE, 0, 0);
+    PROFILE_START(PROFILE_UPDATE_DISPLAY);
+    if (display->service) {
+        display_service_publish(display->service, display->display_buffer,
+                                display->flash);
+    } else {
+        uint8_t frame[DISPLAY_CHAIN_LENGTH];
+        const uint8_t *buffer = display->display_buffer;
+
+        if (animation_compose(display->animations, deadline_now(), buffer, frame))
+            buffer = frame;
+        latency_published();
+        latency_presenting();
+        power_lock(POWER_BUS);
+        display_present(display, buffer, display->flash);
+        power_unlock(POWER_BUS);
+    }
+    PROFILE_END(PROFILE_UPDATE_DISPLAY);
 }
 
 
@@ -177,8 +481,8 @@ void display_blank(seven_segment_ui *display)
 {
     int i;
     /* Blank the display */
-    for (i=0; i<DISPLAY_BUFFER_LENGTH; i++) 
-        display->display_buffer[i] = set_none[i];
+    for (i=0; i<display->boards * DISPLAY_BUFFER_LENGTH; i++) 
+        display->display_buffer[i] = set_none[i % DISPLAY_BUFFER_LENGTH];
 }
 
 
@@ -189,42 +493,96 @@ void display_blank(seven_segment_ui *display)
 void display_all(seven_segment_ui *display)
 {
     int i;
-    for (i=0; i<DISPLAY_BUFFER_LENGTH; i++) 
-        display->display_buffer[i] = set_all[i];
+    for (i=0; i<display->boards * DISPLAY_BUFFER_LENGTH; i++) 
+        display->display_buffer[i] = set_all[i % DISPLAY_BUFFER_LENGTH];
+}
+
+
+/*
+ * Display handles
+ * A fixed pool rather than malloc, there are only ever a couple.
+ */
+static seven_segment_ui display_pool[DISPLAY_POOL_SIZE];
+static uint8_t display_pool_used[DISPLAY_POOL_SIZE];
+static portMUX_TYPE display_pool_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static seven_segment_ui* display_take(void)
+{
+    seven_segment_ui *display = NULL;
+    int i;
+    portENTER_CRITICAL(&display_pool_mux);
+    for (i=0; i<DISPLAY_POOL_SIZE; i++) {
+        if (!display_pool_used[i]) {
+            display_pool_used[i] = 1;
+            display = &display_pool[i];
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&display_pool_mux);
+    return display;
 }
 
 
 /*
- * Initialise the display
+ * Give a display handle back to the pool
+ * Nothing may use it afterwards, including a display service.
+ */
+void display_release(seven_segment_ui *display)
+{
+    int i = display - display_pool;
+    if (i < 0 || i >= DISPLAY_POOL_SIZE)
+        return;
+    portENTER_CRITICAL(&display_pool_mux);
+    display_pool_used[i] = 0;
+    portEXIT_CRITICAL(&display_pool_mux);
+}
+
+
+/*
+ * Initialise a chain of boards sharing the clock and data pins
+ * Board 0 is the leftmost and is the one whose buttons are read.
  * You get back a display handle that you can use in subsequent calls
  */
-seven_segment_ui* display_setup(uint8_t strobe_pin, 
-                            uint8_t clock_pin, 
-                            uint8_t data_pin, 
-                            uint8_t brightness)
+seven_segment_ui* display_setup_chain(const uint8_t *strobe_pins,
+                            int boards,
+                            uint8_t clock_pin,
+                            uint8_t data_pin,
+                            uint8_t brightness,
+                            const seven_segment_transport *transport)
 {
-    ESP_LOGI(TAG, "Display Init: str: %d, clk: %d, dat: %d", strobe_pin, clock_pin, data_pin);
-    seven_segment_ui *display = malloc(sizeof(seven_segment_ui));
+    int b;
+    ESP_LOGI(TAG, "Display Init: %d board(s), str: %d, clk: %d, dat: %d, %s",
+             boards, strobe_pins[0], clock_pin, data_pin, transport->name);
+    if (boards < 1 || boards > DISPLAY_MAX_BOARDS) {
+        ESP_LOGE(TAG, "Can't chain %d boards, at most %d", boards, DISPLAY_MAX_BOARDS);
+        return NULL;
+    }
+    seven_segment_ui *display = display_take();
     if (display == NULL) {
-        ESP_LOGE(TAG, "Unable to allocate memory for display");
+        ESP_LOGE(TAG, "No display handles left, see DISPLAY_POOL_SIZE");
     } else {
-        display->strobe_pin = strobe_pin;
+        memset(display, 0, sizeof(*display));
+        memcpy(display->strobe_pins, strobe_pins, boards);
+        display->boards = boards;
         display->clock_pin = clock_pin;
         display->data_pin = data_pin;
-        display->flash = 0;
+        display->transport = transport;
+        display_select(display, 0);
 
         /* Set up the pins */
-        gpio_pad_select_gpio(display->data_pin);
-        gpio_pad_select_gpio(display->clock_pin);
-        gpio_pad_select_gpio(display->strobe_pin);
-        gpio_set_direction(display->data_pin, GPIO_MODE_OUTPUT);
-        gpio_set_direction(display->clock_pin, GPIO_MODE_OUTPUT);
-        gpio_set_direction(display->strobe_pin, GPIO_MODE_OUTPUT);
+        if (transport->init(display) != 0) {
+            ESP_LOGE(TAG, "Unable to set up %s transport", transport->name);
+            display_release(display);
+            return NULL;
+        }
         /* Enable display and set brightness */
         uint8_t enable_display = 0x88 | (brightness & 0x07);
         ESP_LOGD(TAG, "Enabling display with: 0x%02x", enable_display);
-        bb_send_cmd(display, enable_display);
-        vTaskDelay(1);
+        for (b=0; b<boards; b++) {
+            display_select(display, b);
+            bb_send_cmd(display, enable_display);
+        }
+        /* The TM1638 takes data straight after the display command */
         display_blank(display);
         update_display(display);
         display->initialized = 1;
@@ -233,6 +591,33 @@ seven_segment_ui* display_setup(uint8_t strobe_pin,
 }
 
 
+/*
+ * Initialise a single board over a given transport
+ */
+seven_segment_ui* display_setup_transport(uint8_t strobe_pin, 
+                            uint8_t clock_pin, 
+                            uint8_t data_pin, 
+                            uint8_t brightness,
+                            const seven_segment_transport *transport)
+{
+    return display_setup_chain(&strobe_pin, 1, clock_pin, data_pin,
+                               brightness, transport);
+}
+
+
+/*
+ * Initialise a display driven by bit-banging the pins
+ */
+seven_segment_ui* display_setup(uint8_t strobe_pin, 
+                            uint8_t clock_pin, 
+                            uint8_t data_pin, 
+                            uint8_t brightness)
+{
+    return display_setup_transport(strobe_pin, clock_pin, data_pin,
+                                   brightness, &bb_transport);
+}
+
+
 /*
  * The 7-segment display and single LEDS are interleaved in address
  * So not easy just to set one or the other
@@ -245,8 +630,8 @@ seven_segment_ui* display_setup(uint8_t strobe_pin,
 void display_leds(seven_segment_ui *display, uint8_t value) 
 {
     int i;
+    TRACE(TRACE_LEDS, value, 0);
     for (i=0; i<8; i++) {
-        ESP_LOGV(TAG, "Setting display[%d] = %d", ((i*2)+1), ((value >> i) & 0x01));
         display->display_buffer[((7-i)*2)+1] = (uint8_t) ((value >> i) & 0x01);
     }
 }
@@ -255,35 +640,38 @@ void display_leds(seven_segment_ui *display, uint8_t value)
 /*
  * Convert number into a display digit
  * It will take a digit and does the following:
- * * If the digit is negative the digit will be blanked
  * * check if it greater than 15 - if so set the decimal point
  * * Get a value < 16 using modulus and convert it into a display digit
  */
 uint8_t display_digit(uint8_t digit)
 {
-    int i;
     uint8_t seg;
-    uint8_t d;
-    if (digit < 0) {
-        /* Blank the display */
-        seg = 0x00;
-    } else {
-        /* Show hex digit */
-        d = digit % 16;
-        seg = led_digits[d];
-        /* Set the decimal point */
-        seg |= (digit > 15) ? 0x80 : 0x00;
-    }
+    /* Show hex digit */
+    seg = led_digits[digit % 16];
+    /* Set the decimal point */
+    seg |= (digit > 15) ? 0x80 : 0x00;
     return seg;
 }
 
+/*
+ * Show MM:SS on the right hand four digits
+ * Up to an hour this is a single lookup in the precomputed table.
+ */
 void display_timer(seven_segment_ui *display, int seconds) 
 {
+    const uint8_t *mmss;
+    PROFILE_START(PROFILE_DISPLAY_TIMER);
     if (seconds < 0) {
         display->display_buffer[8] = 0x00;
         display->display_buffer[10] = 0x00;
         display->display_buffer[12] = 0x00;
         display->display_buffer[14] = 0x00;
+    } else if (seconds < SEVEN_SEG_TIMER_SECONDS) {
+        mmss = seven_seg_timer[seconds];
+        display->display_buffer[8] = mmss[0];
+        display->display_buffer[10] = mmss[1];
+        display->display_buffer[12] = mmss[2];
+        display->display_buffer[14] = mmss[3];
     } else {
         uint8_t minutes = seconds / 60;
         seconds = seconds - (minutes * 60);
@@ -299,6 +687,7 @@ void display_timer(seven_segment_ui *display, int seconds)
         if (seconds % 2 == 0)
             display->display_buffer[10] |= 0x80;
     }
+    PROFILE_END(PROFILE_DISPLAY_TIMER);
 }
 
 
@@ -306,8 +695,7 @@ void display_code(seven_segment_ui *display, uint8_t *code)
 {
     /* Display the word c0de of no code supplied */
     if (code == NULL) {
-        uint8_t codeword[] = {12, 0, 13, 14};
-        display_code(display, codeword);
+        display_text(display, 0, 4, "C0dE");
     } else {
         /* Display the code numbers */
         int i;
@@ -317,7 +705,138 @@ void display_code(seven_segment_ui *display, uint8_t *code)
     }
 }
 
+/*
+ * Write text into count digits starting at first, blanking what is left
+ * A '.' lights the decimal point of the character before it.
+ */
+void display_text(seven_segment_ui *display, int first, int count,
+                  const char *text)
+{
+    int digit = first;
+    int last = first + count;
+    uint8_t *buffer = display->display_buffer;
+
+    if (last > display->boards * DISPLAY_DIGITS)
+        last = display->boards * DISPLAY_DIGITS;
+    while (*text && digit < last) {
+        if (*text == '.' && digit > first && !(buffer[2*(digit-1)] & SEVEN_SEG_DP)) {
+            buffer[2*(digit-1)] |= SEVEN_SEG_DP;
+        } else {
+            buffer[2*digit] = SEVEN_SEG_GLYPH(*text);
+            digit++;
+        }
+        text++;
+    }
+    for (; digit < last; digit++)
+        buffer[2*digit] = 0x00;
+}
+
+
+/*
+ * Write a decimal number right aligned into count digits starting at first
+ * Digits are taken two at a time from the pairs table.  Numbers that do
+ * not fit show as dashes.
+ */
+void display_number(seven_segment_ui *display, int first, int count,
+                    long value)
+{
+    uint8_t segments[DISPLAY_MAX_DIGITS + 2];
+    int digits = display->boards * DISPLAY_DIGITS;
+    unsigned long rest = (value < 0) ? -(unsigned long) value : (unsigned long) value;
+    const uint8_t *pair;
+    int pair_value;
+    int n = 0;
+    int i;
+
+    if (first + count > digits)
+        count = digits - first;
+    if (count <= 0)
+        return;
+    /* Least significant digit first */
+    do {
+        pair_value = rest % 100;
+        pair = seven_seg_pairs[pair_value];
+        rest /= 100;
+        segments[n++] = pair[1];
+        if (rest || pair_value >= 10)
+            segments[n++] = pair[0];
+    } while (rest && n < digits);
+    if (value < 0)
+        segments[n++] = SEVEN_SEG_GLYPH('-');
+
+    for (i=0; i<count; i++) {
+        if (rest || n > count)
+            display->display_buffer[2*(first+i)] = SEVEN_SEG_GLYPH('-');
+        else
+            display->display_buffer[2*(first+i)] = (count-1-i < n) ? segments[count-1-i] : 0x00;
+    }
+}
+
+
+/*
+ * Turn text into segments ready to scroll, it starts off the right hand side
+ */
+void display_marquee_start(display_marquee *marquee, const char *text)
+{
+    int i;
+    int n = 0;
+
+    for (i=0; i<DISPLAY_DIGITS; i++)
+        marquee->segments[n++] = 0x00;
+    for (; *text && n < DISPLAY_MARQUEE_LENGTH + DISPLAY_DIGITS; text++) {
+        if (*text == '.' && n > DISPLAY_DIGITS && !(marquee->segments[n-1] & SEVEN_SEG_DP))
+            marquee->segments[n-1] |= SEVEN_SEG_DP;
+        else
+            marquee->segments[n++] = SEVEN_SEG_GLYPH(*text);
+    }
+    marquee->length = n;
+    marquee->offset = 0;
+}
+
+
+/*
+ * Show the next window of the marquee on all digits and move it on one
+ */
+void display_marquee_step(seven_segment_ui *display, display_marquee *marquee)
+{
+    int i;
+    int index = marquee->offset;
+
+    for (i=0; i<DISPLAY_DIGITS; i++) {
+        display->display_buffer[2*i] = marquee->segments[index];
+        if (++index == marquee->length)
+            index = 0;
+    }
+    if (++marquee->offset == marquee->length)
+        marquee->offset = 0;
+}
+
+
+/*
+ * Read the buttons
+ * With the display service running it owns the bus, so this returns the
+ * result of its last key scan instead
+ */
 uint8_t read_buttons(seven_segment_ui *display)
 {
-    return bb_read_buttons(display);
+    uint32_t scan;
+    return read_buttons_scan(display, &scan);
+}
+
+
+/*
+ * Read the buttons, and which key scan of the bus they came from
+ * Reads of the display service's scan between two of its scans give the
+ * same number, so a caller can tell a fresh scan from one it has seen.
+ */
+uint8_t read_buttons_scan(seven_segment_ui *display, uint32_t *scan)
+{
+    uint8_t keys;
+    if (display->service)
+        return display_service_keys(display->service, scan);
+    power_lock(POWER_BUS);
+    keys = bb_read_buttons(display);
+    power_unlock(POWER_BUS);
+    *scan = display->key_scans;
+    return keys;
 }
\ No newline at end of file
@@ -3,29 +3,164 @@
 
 #include <stdint.h>
 
+/*
+ * Register-level fast path
+ * A display set up on exactly these pins is driven by writing constant
+ * masks to the GPIO W1TS/W1TC registers instead of calling the GPIO driver.
+ * All three pins must be below 32.  Any other pins use the generic path.
+ */
+#ifndef SEVEN_SEG_FAST_PATH
+#define SEVEN_SEG_FAST_PATH 1
+#endif
+#ifndef SEVEN_SEG_STROBE_PIN
+#define SEVEN_SEG_STROBE_PIN 12
+#endif
+#ifndef SEVEN_SEG_CLOCK_PIN
+#define SEVEN_SEG_CLOCK_PIN 14
+#endif
+#ifndef SEVEN_SEG_DATA_PIN
+#define SEVEN_SEG_DATA_PIN 27
+#endif
+/* Bit-bang busy wait per clock phase, 64 cycles is 400ns at 160MHz */
+#ifndef SEVEN_SEG_HALF_PERIOD_CYCLES
+#define SEVEN_SEG_HALF_PERIOD_CYCLES 64
+#endif
+/* ... for the 1us waits: read command to the first read clock, last clock
+ * to strobe high and strobe high between transfers */
+#ifndef SEVEN_SEG_WAIT_CYCLES
+#define SEVEN_SEG_WAIT_CYCLES 160
+#endif
+
+/*
+ * Chained boards
+ * Several boards can share the clock and data lines, each with its own
+ * strobe, and be driven as one display.  Board b's digits and LEDs are
+ * bytes 16b to 16b + 15 of the display buffer, so digit d of the whole
+ * chain is always at byte 2d.  The functions that know about a single
+ * board (timer, code, LEDs, flash, animations, buttons) use board 0.
+ */
+#ifndef DISPLAY_MAX_BOARDS
+#define DISPLAY_MAX_BOARDS 4
+#endif
+/* Displays that can be set up at once, handles come from a static pool */
+#ifndef DISPLAY_POOL_SIZE
+#define DISPLAY_POOL_SIZE 2
+#endif
+
+/* Per board */
 #define DISPLAY_BUFFER_LENGTH 16
+#define DISPLAY_DIGITS 8
+/* The whole chain */
+#define DISPLAY_CHAIN_LENGTH (DISPLAY_MAX_BOARDS * DISPLAY_BUFFER_LENGTH)
+#define DISPLAY_MAX_DIGITS (DISPLAY_MAX_BOARDS * DISPLAY_DIGITS)
+/* Longest text a marquee can scroll */
+#ifndef DISPLAY_MARQUEE_LENGTH
+#define DISPLAY_MARQUEE_LENGTH 64
+#endif
+/* Bytes on the bus for a full refresh: 0x40 command, 0xC0 address, data */
+#define DISPLAY_FRAME_BYTES (DISPLAY_BUFFER_LENGTH + 2)
+
+struct ui;
+struct display_service;
+struct animation_player;
+struct display_mirror;
+
+/*
+ * How bytes get to and from the TM1638
+ * Each write() is one transfer framed by the strobe, the first byte being
+ * the command.  read_keys() sends the 0x42 command and returns the 4 key
+ * scan bytes as the chip sends them.  A transport may queue writes and
+ * return before they are on the wire, but must keep them in order.
+ */
+typedef struct seven_segment_transport {
+    const char *name;
+    int (*init)(struct ui *display);
+    void (*write)(struct ui *display, const uint8_t *data, int len);
+    void (*read_keys)(struct ui *display, uint8_t *keys);
+} seven_segment_transport;
 
 typedef struct ui {
     uint8_t data_pin;
     uint8_t clock_pin;
-    uint8_t strobe_pin;
-    uint8_t display_buffer[DISPLAY_BUFFER_LENGTH];
+    uint8_t strobe_pin;         /* Strobe of the board being talked to */
+    uint8_t strobe_pins[DISPLAY_MAX_BOARDS];
+    uint8_t boards;
+    uint8_t board;              /* Board being talked to */
+    uint32_t strobe_mask;       /* ... for the fast path */
+    uint8_t fast;
+    const seven_segment_transport *transport;
+    void *transport_ctx;
+    /* Set while a display service task owns the bus, see display_service.h */
+    struct display_service *service;
+    /* Animations laid over each frame, see animation.h */
+    struct animation_player *animations;
+    /* Frames copied out to remote viewers, see display_mirror.h */
+    struct display_mirror *mirror;
+    uint8_t data_cmd[DISPLAY_MAX_BOARDS];
+    uint8_t display_buffer[DISPLAY_CHAIN_LENGTH];
     uint8_t flash;
     uint8_t initialized;
+    /* Last frame sent to the display, used to only send what changed */
+    uint8_t shadow[DISPLAY_CHAIN_LENGTH];
+    uint8_t shadow_valid;
+    unsigned long bytes_sent;
+    unsigned long bytes_saved;
+    uint32_t key_scans;         /* Key scans made on the bus */
 } seven_segment_ui;
 
+/*
+ * Text scrolling across all the digits
+ * The text is turned into segments once, each step is then just copies.
+ */
+typedef struct {
+    uint8_t segments[DISPLAY_MARQUEE_LENGTH + DISPLAY_DIGITS];
+    uint8_t length;             /* Including a gap of DISPLAY_DIGITS blanks */
+    uint8_t offset;
+} display_marquee;
+
+/* The bit-bang transport, see spi_transport in 7_seg_spi.h for the other */
+extern const seven_segment_transport bb_transport;
+
 /* Public functions */
 extern seven_segment_ui* display_setup(uint8_t strobe_pin, 
                             uint8_t clock_pin, 
                             uint8_t data_pin, 
                             uint8_t brightness);
+extern seven_segment_ui* display_setup_transport(uint8_t strobe_pin, 
+                            uint8_t clock_pin, 
+                            uint8_t data_pin, 
+                            uint8_t brightness,
+                            const seven_segment_transport *transport);
+extern seven_segment_ui* display_setup_chain(const uint8_t *strobe_pins,
+                            int boards,
+                            uint8_t clock_pin,
+                            uint8_t data_pin,
+                            uint8_t brightness,
+                            const seven_segment_transport *transport);
+extern void display_release(seven_segment_ui *display);
 extern void update_display(seven_segment_ui *display);
+extern void display_present(seven_segment_ui *display, const uint8_t *buffer,
+                            uint8_t flash);
 extern void display_blank(seven_segment_ui *display);
 extern void display_all(seven_segment_ui *display);
 extern void display_leds(seven_segment_ui *display, uint8_t value);
 extern uint8_t display_digit(uint8_t digit);
 extern void display_code(seven_segment_ui *display, uint8_t *code);
 extern void display_timer(seven_segment_ui *display, int seconds);
+extern void display_text(seven_segment_ui *display, int first, int count,
+                         const char *text);
+extern void display_number(seven_segment_ui *display, int first, int count,
+                           long value);
+extern void display_marquee_start(display_marquee *marquee, const char *text);
+extern void display_marquee_step(seven_segment_ui *display,
+                                 display_marquee *marquee);
 extern uint8_t read_buttons(seven_segment_ui *display);
+extern uint8_t read_buttons_scan(seven_segment_ui *display, uint32_t *scan);
+
+/* Low level bus access, through the display's transport to the selected board */
+extern void display_select(seven_segment_ui *display, int board);
+extern void bb_send_cmd(seven_segment_ui *display, uint8_t cmd);
+extern void bb_send(seven_segment_ui *display, const uint8_t *frame);
+extern uint8_t bb_read_buttons(seven_segment_ui *display);
 
 #endif
\ No newline at end of file
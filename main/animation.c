@@ -0,0 +1,199 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "7_seg_ui.h"
+#include "display_service.h"
+#include "deadline.h"
+#include "animation.h"
+
+static const char *TAG = "animation";
+
+#define FRAMES(f) (f), sizeof(f) / sizeof((f)[0])
+
+/* LEDs going out from the left, slowing down, for the end of a game */
+static const animation_frame sweep_frames[] = {
+    {800, 0xff, 0xff, 0, 0},
+    {700, 0x7f, 0xff, 0, 0},
+    {600, 0x3f, 0xff, 0, 0},
+    {500, 0x1f, 0xff, 0, 0},
+    {400, 0x0f, 0xff, 0, 0},
+    {300, 0x07, 0xff, 0, 0},
+    {200, 0x03, 0xff, 0, 0},
+    {100, 0x01, 0xff, 0, 0},
+};
+const animation animation_sweep = {FRAMES(sweep_frames), 1};
+
+/* A blip of the rightmost LED to show we are alive */
+static const animation_frame blink_frames[] = {
+    {50, 0x01, 0x01, 0, 0},
+};
+const animation animation_blink = {FRAMES(blink_frames), 1};
+
+/* A segment chasing round the edge of every digit */
+static const animation_frame spin_frames[] = {
+    {60, 0, 0, 0x01, 0xff},
+    {60, 0, 0, 0x02, 0xff},
+    {60, 0, 0, 0x04, 0xff},
+    {60, 0, 0, 0x08, 0xff},
+    {60, 0, 0, 0x10, 0xff},
+    {60, 0, 0, 0x20, 0xff},
+};
+const animation animation_spin = {FRAMES(spin_frames), 0};
+
+/* Everything on and off three times */
+static const animation_frame flash_frames[] = {
+    {150, 0xff, 0xff, 0xff, 0xff},
+    {150, 0x00, 0xff, 0x00, 0xff},
+};
+const animation animation_flash = {FRAMES(flash_frames), 3};
+
+
+/* A player for each display handle there can be, kept by the handle */
+static animation_player players[DISPLAY_POOL_SIZE];
+static portMUX_TYPE players_mux = portMUX_INITIALIZER_UNLOCKED;
+
+
+/*
+ * Give a display somewhere to play animations
+ */
+animation_player* animation_start(seven_segment_ui *display)
+{
+    animation_player *player = NULL;
+    int i;
+
+    portENTER_CRITICAL(&players_mux);
+    for (i=0; i<DISPLAY_POOL_SIZE; i++) {
+        if (players[i].display == NULL || players[i].display == display) {
+            player = &players[i];
+            player->display = display;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&players_mux);
+    if (player == NULL) {
+        ESP_LOGE(TAG, "No animation players left, see DISPLAY_POOL_SIZE");
+        return NULL;
+    }
+    memset(player->slots, 0, sizeof(player->slots));
+    player->active = 0;
+    player->mux = (portMUX_TYPE) portMUX_INITIALIZER_UNLOCKED;
+    display->animations = player;
+    return player;
+}
+
+
+/*
+ * Start an animation on top of any already playing, never blocks
+ * Returns an id for animation_stop(), or -1 if every slot is busy.
+ */
+int animation_play(seven_segment_ui *display, const animation *anim)
+{
+    animation_player *player = display->animations;
+    int i;
+    int id = -1;
+
+    if (player == NULL || anim->count == 0)
+        return -1;
+    portENTER_CRITICAL(&player->mux);
+    for (i=0; i<ANIMATION_SLOTS; i++) {
+        if (!(player->active & (1 << i))) {
+            player->slots[i].anim = anim;
+            player->slots[i].frame = 0;
+            player->slots[i].loops = anim->loops;
+            player->slots[i].frame_end = deadline_now() + DEADLINE_MS(anim->frames[0].duration);
+            player->active |= 1 << i;
+            id = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&player->mux);
+    if (id < 0)
+        ESP_LOGW(TAG, "No free animation slot");
+    else if (display->service)
+        display_service_kick(display->service);
+    return id;
+}
+
+
+void animation_stop(seven_segment_ui *display, int id)
+{
+    animation_player *player = display->animations;
+    if (player == NULL || id < 0 || id >= ANIMATION_SLOTS)
+        return;
+    portENTER_CRITICAL(&player->mux);
+    player->active &= ~(1 << id);
+    portEXIT_CRITICAL(&player->mux);
+}
+
+
+int animation_playing(seven_segment_ui *display, int id)
+{
+    animation_player *player = display->animations;
+    if (player == NULL || id < 0 || id >= ANIMATION_SLOTS)
+        return 0;
+    return (__atomic_load_n(&player->active, __ATOMIC_ACQUIRE) >> id) & 1;
+}
+
+
+int animation_active(animation_player *player)
+{
+    return player && __atomic_load_n(&player->active, __ATOMIC_ACQUIRE) != 0;
+}
+
+
+/* Move a slot on to the frame showing at now, call in the critical section */
+static void animation_advance(animation_player *player, int i, int64_t now)
+{
+    animation_slot *slot = &player->slots[i];
+    const animation *anim = slot->anim;
+
+    while (now - slot->frame_end >= 0) {
+        if (++slot->frame == anim->count) {
+            slot->frame = 0;
+            if (slot->loops && --slot->loops == 0) {
+                player->active &= ~(1 << i);
+                return;
+            }
+        }
+        /* From when the last frame was due to end, so nothing drifts */
+        slot->frame_end += DEADLINE_MS(anim->frames[slot->frame].duration);
+    }
+}
+
+
+/*
+ * Lay whatever is playing at now over a display buffer
+ * Returns 0, leaving out alone, when nothing is playing.
+ */
+int animation_compose(animation_player *player, int64_t now,
+                      const uint8_t *buffer, uint8_t *out)
+{
+    const animation_frame *frame;
+    int i, bit;
+
+    if (!animation_active(player))
+        return 0;
+    memcpy(out, buffer, DISPLAY_CHAIN_LENGTH);
+    portENTER_CRITICAL(&player->mux);
+    for (i=0; i<ANIMATION_SLOTS; i++) {
+        if (!(player->active & (1 << i)))
+            continue;
+        animation_advance(player, i, now);
+        if (!(player->active & (1 << i)))
+            continue;
+        frame = &player->slots[i].anim->frames[player->slots[i].frame];
+        for (bit=0; bit<8; bit++) {
+            if (frame->led_mask & (0x80 >> bit))
+                out[2*bit+1] = (frame->leds >> (7-bit)) & 0x01;
+            if (frame->digit_mask & (0x80 >> bit))
+                out[2*bit] = frame->segments;
+        }
+    }
+    portEXIT_CRITICAL(&player->mux);
+    return 1;
+}
@@ -0,0 +1,68 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "7_seg_ui.h"
+
+/*
+ * Animations
+ * An animation is a const table of keyframes, each shown for a number of
+ * ms.  A keyframe overrides the LEDs picked by led_mask and sets the
+ * segments of the digits picked by digit_mask, bit 7 being the leftmost
+ * as with display_leds().  Anything not picked shows the frame underneath.
+ *
+ * Up to ANIMATION_SLOTS play at once, later ones on top.  They are moved
+ * on by the time elapsed whenever a frame is composed, which the display
+ * service does every period, so playing one never blocks the caller.
+ * Without the service they only move on when update_display() is called.
+ */
+#ifndef ANIMATION_SLOTS
+#define ANIMATION_SLOTS 4
+#endif
+
+typedef struct {
+    uint16_t duration;          /* ms */
+    uint8_t leds;
+    uint8_t led_mask;
+    uint8_t segments;
+    uint8_t digit_mask;
+} animation_frame;
+
+typedef struct {
+    const animation_frame *frames;
+    uint8_t count;
+    uint8_t loops;              /* 0 plays until stopped */
+} animation;
+
+typedef struct {
+    const animation *anim;
+    uint8_t frame;
+    uint8_t loops;
+    int64_t frame_end;          /* deadline_now() time the frame ends */
+} animation_slot;
+
+typedef struct animation_player {
+    seven_segment_ui *display;
+    portMUX_TYPE mux;
+    animation_slot slots[ANIMATION_SLOTS];
+    uint32_t active;            /* Bit per playing slot */
+} animation_player;
+
+/* The stock animations */
+extern const animation animation_sweep;
+extern const animation animation_blink;
+extern const animation animation_spin;
+extern const animation animation_flash;
+
+extern animation_player* animation_start(seven_segment_ui *display);
+extern int animation_play(seven_segment_ui *display, const animation *anim);
+extern void animation_stop(seven_segment_ui *display, int id);
+extern int animation_playing(seven_segment_ui *display, int id);
+extern int animation_active(animation_player *player);
+extern int animation_compose(animation_player *player, int64_t now,
+                             const uint8_t *buffer, uint8_t *out);
+
+#endif
@@ -0,0 +1,47 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_timer.h"
+
+#include "boot.h"
+
+#define BOOT_STAGE(id, name) name,
+static const char *names[BOOT_STAGE_COUNT] = {
+    BOOT_STAGES
+};
+#undef BOOT_STAGE
+
+static int64_t stamps[BOOT_STAGE_COUNT];
+static uint32_t reached;                /* Bit per stage */
+
+
+void boot_mark(boot_stage stage)
+{
+    stamps[stage] = esp_timer_get_time();
+    reached |= 1 << stage;
+}
+
+
+/* us from start up to stage, -1 if not there yet */
+int64_t boot_time(boot_stage stage)
+{
+    return reached & (1 << stage) ? stamps[stage] : -1;
+}
+
+
+void boot_print(void)
+{
+    int64_t last = 0;
+    int i;
+
+    printf("Boot, ms since start up:\n");
+    for (i=0; i<BOOT_STAGE_COUNT; i++) {
+        if (!(reached & (1 << i))) {
+            printf("  %-16s        -\n", names[i]);
+            continue;
+        }
+        printf("  %-16s %8.3f  +%.3f\n", names[i], stamps[i] / 1e3,
+               (stamps[i] - last) / 1e3);
+        last = stamps[i];
+    }
+}
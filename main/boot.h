@@ -0,0 +1,38 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stdint.h>
+
+/*
+ * Boot timing
+ * app_main marks each stage of start up as it gets there, in us on
+ * esp_timer, which starts early in the app's own start up.  The
+ * bootloader's time before that isn't counted, its log lines carry their
+ * own ms timestamps.
+ *
+ * The order is what someone watching sees: the splash goes on the display
+ * as soon as it is set up, buttons are captured from when input is
+ * running, and only then does the rest start, with the splash cleared at
+ * ready.  boot_print() gives each stage's time.
+ */
+
+/* BOOT_STAGE(id, name) */
+#define BOOT_STAGES                                                         \
+    BOOT_STAGE(BOOT_APP_MAIN,       "app_main")                             \
+    BOOT_STAGE(BOOT_DISPLAY,        "display set up")                       \
+    BOOT_STAGE(BOOT_FIRST_FRAME,    "first frame")                          \
+    BOOT_STAGE(BOOT_INPUT,          "input running")                        \
+    BOOT_STAGE(BOOT_READY,          "ready")
+
+#define BOOT_STAGE(id, name) id,
+typedef enum {
+    BOOT_STAGES
+    BOOT_STAGE_COUNT
+} boot_stage;
+#undef BOOT_STAGE
+
+extern void boot_mark(boot_stage stage);
+extern int64_t boot_time(boot_stage stage);
+extern void boot_print(void);
+
+#endif
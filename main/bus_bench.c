@@ -0,0 +1,80 @@
+#include <stdint.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "7_seg_ui.h"
+#include "bus_bench.h"
+#include "power.h"
+
+static const char *TAG = "bus-bench";
+
+/* Bytes on the bus for one key scan: 0x42 command plus 4 key bytes */
+#define KEY_SCAN_BYTES 5
+
+static unsigned long rate(unsigned long bytes, int64_t us)
+{
+    return us > 0 ? (unsigned long) ((uint64_t) bytes * 1000000 / us) : 0;
+}
+
+static void bench_path(seven_segment_ui *display, int iterations,
+                       bus_bench_result *result)
+{
+    int i;
+    int64_t start;
+    unsigned long sent;
+    uint8_t frame[DISPLAY_BUFFER_LENGTH];
+
+    for (i=0; i<DISPLAY_BUFFER_LENGTH; i++)
+        frame[i] = display->display_buffer[i];
+    power_lock(POWER_BUS);
+    display_select(display, 0);
+
+    sent = display->bytes_sent;
+    start = esp_timer_get_time();
+    for (i=0; i<iterations; i++)
+        bb_send(display, frame);
+    /* Queued writes must have reached the display */
+    bb_read_buttons(display);
+    result->write_bytes_per_sec = rate(display->bytes_sent - sent,
+                                       esp_timer_get_time() - start);
+
+    start = esp_timer_get_time();
+    for (i=0; i<iterations; i++)
+        bb_read_buttons(display);
+    result->read_bytes_per_sec = rate(iterations * KEY_SCAN_BYTES,
+                                      esp_timer_get_time() - start);
+    power_unlock(POWER_BUS);
+
+    ESP_LOGI(TAG, "%-8s write: %lu bytes/s  read: %lu bytes/s", result->path,
+             result->write_bytes_per_sec, result->read_bytes_per_sec);
+}
+
+/*
+ * Measure bus throughput through the GPIO driver and through the register
+ * fast path, or through whatever other transport the display uses.
+ * Bulk frame writes are timed with bb_send() and key scans with
+ * bb_read_buttons().  Returns the number of results filled in.
+ */
+int bus_bench(seven_segment_ui *display, int iterations,
+              bus_bench_result *results)
+{
+    int count = 0;
+    uint8_t fast = display->fast;
+
+    if (display->transport != &bb_transport) {
+        results[count].path = display->transport->name;
+        bench_path(display, iterations, &results[count++]);
+        return count;
+    }
+    display->fast = 0;
+    results[count].path = "generic";
+    bench_path(display, iterations, &results[count++]);
+    if (fast) {
+        display->fast = 1;
+        results[count].path = "fast";
+        bench_path(display, iterations, &results[count++]);
+    }
+    display->fast = fast;
+    return count;
+}
@@ -0,0 +1,18 @@
+#ifndef BUS_BENCH_H
+#define BUS_BENCH_H
+
+#include "7_seg_ui.h"
+
+typedef struct {
+    const char *path;
+    unsigned long write_bytes_per_sec;
+    unsigned long read_bytes_per_sec;
+} bus_bench_result;
+
+/* Results for the generic path and, if the pins allow it, the fast path */
+#define BUS_BENCH_PATHS 2
+
+extern int bus_bench(seven_segment_ui *display, int iterations,
+                     bus_bench_result *results);
+
+#endif
@@ -0,0 +1,109 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "driver/uart.h"
+
+#include "console.h"
+#include "profile.h"
+#include "trace.h"
+#include "power.h"
+#include "session.h"
+#include "stats_log.h"
+#include "tasks.h"
+#include "latency.h"
+
+static const char *TAG = "console";
+
+#define CONSOLE_UART UART_NUM_0
+/* Edges on RX needed to wake from light sleep */
+#define CONSOLE_WAKEUP_EDGES 3
+/* vTaskGetRunTimeStats() needs about 40 bytes a task */
+#define CONSOLE_MAX_TASKS 16
+
+
+/*
+ * CPU time per task since boot, 100% less IDLE0's and IDLE1's share is
+ * how busy each core has been
+ */
+static void console_run_time(void)
+{
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_STATS_FORMATTING_FUNCTIONS
+    static char stats[40 * CONSOLE_MAX_TASKS];
+    vTaskGetRunTimeStats(stats);
+    printf("task\t\tus\t\tof elapsed\r\n%s", stats);
+#else
+    ESP_LOGI(TAG, "Run time stats not built in, see CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS");
+#endif
+}
+
+
+static void console_task(void *pvParameters)
+{
+    uint8_t c;
+
+    for (;;) {
+        /* Blocks in the driver until something is typed */
+        if (uart_read_bytes(CONSOLE_UART, &c, 1, portMAX_DELAY) != 1)
+            continue;
+        switch (c) {
+            case 'p':
+                profile_dump();
+                break;
+            case 'z':
+                profile_reset();
+                break;
+            case 't':
+                trace_dump();
+                break;
+            case 's':
+                power_log_stats();
+                break;
+            case 'g':
+                session_dump();
+                break;
+            case 'u':
+                console_run_time();
+                break;
+            case 'l':
+                stats_log_print();
+                break;
+            case 'k':
+                task_stack_print();
+                break;
+            case 'i':
+                latency_print();
+                break;
+            case '\r':
+            case '\n':
+                break;
+            default:
+                printf("p: profile, z: reset profile, t: trace, s: power stats, "
+                       "g: last game's session log, u: CPU time per task, "
+                       "l: game stats, k: task stacks, i: press to display latency\n");
+        }
+    }
+}
+
+
+/*
+ * Take over UART0 input and start the console task on the given core
+ */
+void console_start(int core, UBaseType_t priority)
+{
+    if (uart_driver_install(CONSOLE_UART, 256, 0, 0, NULL, 0) != ESP_OK) {
+        ESP_LOGE(TAG, "Unable to install the UART driver");
+        return;
+    }
+#if CONFIG_PM_ENABLE
+    uart_set_wakeup_threshold(CONSOLE_UART, CONSOLE_WAKEUP_EDGES);
+    esp_sleep_enable_uart_wakeup(CONSOLE_UART);
+#endif
+    if (task_start(TASK_CONSOLE, console_task, NULL, priority, core) == NULL)
+        ESP_LOGE(TAG, "Unable to start console");
+}
@@ -0,0 +1,20 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include "freertos/FreeRTOS.h"
+
+/*
+ * Serial console
+ * A task waits on UART0 for single letter commands, so the stats can be
+ * dumped on demand without a debugger:
+ *   p  profile_dump()      z  profile_reset()
+ *   t  trace_dump()        s  power_log_stats()
+ *   g  session_dump()      u  CPU time per task and core
+ *   l  stats_log_print()   k  task_stack_print()
+ *   i  latency_print()
+ * Anything else prints the list.  The UART can wake us from light sleep,
+ * but the character that does so is lost, so just type it again.
+ */
+extern void console_start(int core, UBaseType_t priority);
+
+#endif
@@ -0,0 +1,123 @@
+#include "freertos/FreeRTOS.h"
+
+#include <stdint.h>
+
+#include "esp_timer.h"
+
+#include "deadline.h"
+
+static deadline_clock clock_source = esp_timer_get_time;
+
+
+/*
+ * Replace the time base, NULL goes back to esp_timer
+ */
+void deadline_set_clock(deadline_clock clock)
+{
+    clock_source = clock ? clock : esp_timer_get_time;
+}
+
+
+int64_t deadline_now(void)
+{
+    return clock_source();
+}
+
+
+/*
+ * Arm a timer to go off delay us after now, then every period us if
+ * period is not 0
+ */
+void deadline_start(deadline_timer *timer, int64_t now, int64_t delay,
+                    int64_t period)
+{
+    timer->due = now + delay;
+    timer->period = period;
+    timer->armed = 1;
+}
+
+
+void deadline_stop(deadline_timer *timer)
+{
+    timer->armed = 0;
+}
+
+
+/*
+ * Has the timer gone off, without taking the expiry
+ */
+int deadline_reached(const deadline_timer *timer, int64_t now)
+{
+    return timer->armed && now - timer->due >= 0;
+}
+
+
+/*
+ * Take the expiries due by now
+ * Returns how many periods have passed since it was last taken, 0 if it is
+ * not due yet.  A one-shot is disarmed once taken.
+ */
+unsigned int deadline_expired(deadline_timer *timer, int64_t now)
+{
+    int64_t late;
+    unsigned int count;
+
+    if (!deadline_reached(timer, now))
+        return 0;
+    if (timer->period == 0) {
+        timer->armed = 0;
+        return 1;
+    }
+    late = now - timer->due;
+    count = (unsigned int) (late / timer->period) + 1;
+    timer->due += (int64_t) count * timer->period;
+    return count;
+}
+
+
+/*
+ * Microseconds until the timer goes off, 0 if it has, -1 if it is not armed
+ */
+int64_t deadline_remaining(const deadline_timer *timer, int64_t now)
+{
+    int64_t remaining;
+    if (!timer->armed)
+        return -1;
+    remaining = timer->due - now;
+    return remaining > 0 ? remaining : 0;
+}
+
+
+/*
+ * Ticks to block for so as to wake once delay has passed, 0 if it has
+ * Rounded up, so a delay of whole ticks wakes on time rather than a tick late
+ */
+TickType_t deadline_delay_ticks(int64_t delay)
+{
+    const int64_t tick = DEADLINE_MS(portTICK_PERIOD_MS);
+
+    if (delay <= 0)
+        return 0;
+    return (TickType_t) ((delay + tick - 1) / tick);
+}
+
+
+/*
+ * Ticks to block for so as to wake as the earliest of the timers is due,
+ * portMAX_DELAY if none of them are armed
+ */
+TickType_t deadline_ticks(deadline_timer * const timers[], int count, int64_t now)
+{
+    int i;
+    int64_t remaining;
+    int64_t earliest = -1;
+
+    for (i=0; i<count; i++) {
+        remaining = deadline_remaining(timers[i], now);
+        if (remaining >= 0 && (earliest < 0 || remaining < earliest))
+            earliest = remaining;
+    }
+    if (earliest < 0)
+        return portMAX_DELAY;
+    return deadline_delay_ticks(earliest);
+}
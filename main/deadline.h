@@ -0,0 +1,41 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+/*
+ * Deadline timers
+ * Deadlines are absolute times in microseconds on a monotonic clock,
+ * esp_timer_get_time() unless another one is injected, e.g. for tests.
+ * Times are only ever compared through their signed difference, so a
+ * wrapping clock would still be handled.
+ *
+ * A periodic timer moves its deadline on by whole periods from where it
+ * was due, not from when it was noticed, so it never drifts however late
+ * its owner gets round to looking.
+ */
+typedef int64_t (*deadline_clock)(void);
+
+typedef struct {
+    int64_t due;
+    int64_t period;         /* 0 for a one-shot */
+    uint8_t armed;
+} deadline_timer;
+
+#define DEADLINE_MS(ms) ((int64_t) (ms) * 1000)
+
+extern void deadline_set_clock(deadline_clock clock);
+extern int64_t deadline_now(void);
+extern void deadline_start(deadline_timer *timer, int64_t now, int64_t delay,
+                           int64_t period);
+extern void deadline_stop(deadline_timer *timer);
+extern int deadline_reached(const deadline_timer *timer, int64_t now);
+extern unsigned int deadline_expired(deadline_timer *timer, int64_t now);
+extern int64_t deadline_remaining(const deadline_timer *timer, int64_t now);
+extern TickType_t deadline_delay_ticks(int64_t delay);
+extern TickType_t deadline_ticks(deadline_timer * const timers[], int count,
+                                 int64_t now);
+
+#endif
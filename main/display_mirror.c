@@ -0,0 +1,539 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "esp_log.h"
+#include "lwip/sockets.h"
+
+#include "7_seg_ui.h"
+#include "display_mirror.h"
+#include "deadline.h"
+#include "tasks.h"
+
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_BINARY 0x2
+#define WS_CLOSE 0x8
+#define WS_PING 0x9
+#define WS_PONG 0xa
+
+
+/*
+ * The XOR of frame and base as tokens, see display_mirror.h
+ * Returns the bytes written to out, 0 if they are the same.
+ */
+int mirror_delta_encode(const uint8_t *base, const uint8_t *frame, int length,
+                        uint8_t *out)
+{
+    int i = 0, n = 0, skip, count, token;
+
+    for (;;) {
+        for (skip=0; i<length && frame[i] == base[i]; i++)
+            skip++;
+        if (i == length)
+            return n;
+        while (skip > 15) {
+            out[n++] = 0xf0;
+            skip -= 15;
+        }
+        token = n++;
+        for (count=0; i<length && count<15 && frame[i] != base[i]; count++, i++)
+            out[n++] = frame[i] ^ base[i];
+        out[token] = skip << 4 | count;
+    }
+}
+
+
+/*
+ * Apply tokens to a copy of base, returns 0 or -1 if they run off the end
+ */
+int mirror_delta_decode(const uint8_t *base, const uint8_t *tokens, int size,
+                        int length, uint8_t *frame)
+{
+    int i = 0, n = 0, count;
+
+    memcpy(frame, base, length);
+    while (n < size) {
+        i += tokens[n] >> 4;
+        count = tokens[n++] & 0x0f;
+        if (i + count > length || n + count > size)
+            return -1;
+        while (count--)
+            frame[i++] ^= tokens[n++];
+    }
+    return 0;
+}
+
+
+/*
+ * Take a frame as it goes on the bus, never blocks
+ * Only from the one task presenting the display.
+ */
+void display_mirror_frame(display_mirror *mirror, const uint8_t *frame, int length)
+{
+    uint32_t sequence = mirror->sequence;
+
+    __atomic_store_n(&mirror->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(mirror->frame, frame, length);
+    mirror->length = length;
+    __atomic_store_n(&mirror->sequence, sequence + 2, __ATOMIC_RELEASE);
+    xTaskNotifyGive(mirror->task);
+}
+
+
+#if DISPLAY_MIRROR_ENABLE
+static const char *TAG = "mirror";
+
+static display_mirror the_mirror;
+
+
+/* Copy out the latest frame, 1 if it is new since last time */
+static int mirror_take(display_mirror *mirror, uint32_t *seen)
+{
+    uint32_t before, after;
+    uint8_t frame[DISPLAY_CHAIN_LENGTH];
+    uint8_t length;
+
+    do {
+        before = __atomic_load_n(&mirror->sequence, __ATOMIC_ACQUIRE);
+        if (before == *seen)
+            return 0;
+        length = mirror->length;
+        memcpy(frame, mirror->frame, sizeof(frame));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&mirror->sequence, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+    *seen = before;
+    memcpy(mirror->latest, frame, sizeof(frame));
+    mirror->latest_length = length;
+    if (++mirror->number == 0)
+        mirror->number = 1;
+    mirror->stats.frames++;
+    return 1;
+}
+
+
+/*
+ * SHA-1 and base64, only for the handshake's Sec-WebSocket-Accept
+ */
+#define ROL(x, n) ((x) << (n) | (x) >> (32 - (n)))
+
+static void sha1_block(uint32_t *h, const uint8_t *p)
+{
+    uint32_t w[80], a, b, c, d, e, f, k, t;
+    int i;
+
+    for (i=0; i<16; i++)
+        w[i] = (uint32_t) p[4*i] << 24 | p[4*i+1] << 16 | p[4*i+2] << 8 | p[4*i+3];
+    for (; i<80; i++)
+        w[i] = ROL(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+    a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
+    for (i=0; i<80; i++) {
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        t = ROL(a, 5) + f + e + k + w[i];
+        e = d; d = c; c = ROL(b, 30); b = a; a = t;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+static void sha1(const uint8_t *data, size_t length, uint8_t *digest)
+{
+    uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+    uint8_t block[64];
+    size_t done, rest;
+    int i;
+
+    for (done=0; done+64<=length; done+=64)
+        sha1_block(h, data + done);
+    rest = length - done;
+    memset(block, 0, sizeof(block));
+    memcpy(block, data + done, rest);
+    block[rest] = 0x80;
+    if (rest >= 56) {
+        sha1_block(h, block);
+        memset(block, 0, sizeof(block));
+    }
+    for (i=0; i<8; i++)
+        block[63 - i] = (uint8_t) ((uint64_t) length * 8 >> (8 * i));
+    sha1_block(h, block);
+    for (i=0; i<20; i++)
+        digest[i] = h[i / 4] >> (24 - 8 * (i % 4));
+}
+
+static void base64(const uint8_t *data, size_t length, char *out)
+{
+    static const char digits[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t i;
+    uint32_t v;
+
+    for (i=0; i<length; i+=3) {
+        v = data[i] << 16 | (i+1 < length ? data[i+1] << 8 : 0) |
+            (i+2 < length ? data[i+2] : 0);
+        *out++ = digits[v >> 18 & 0x3f];
+        *out++ = digits[v >> 12 & 0x3f];
+        *out++ = i+1 < length ? digits[v >> 6 & 0x3f] : '=';
+        *out++ = i+2 < length ? digits[v & 0x3f] : '=';
+    }
+    *out = '\0';
+}
+
+
+static void client_close(display_mirror *mirror, mirror_client *client)
+{
+    close(client->fd);
+    client->fd = -1;
+}
+
+
+/*
+ * Send a whole message or nothing
+ * Returns 1 if sent, 0 if the socket is full, -1 if the client is gone.
+ */
+static int client_send(mirror_client *client, const void *data, size_t length)
+{
+    int n = send(client->fd, data, length, 0);
+    if (n == (int) length)
+        return 1;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+    /* Half a message would leave the stream out of step */
+    return -1;
+}
+
+
+static int ws_send(mirror_client *client, int opcode, const uint8_t *payload,
+                   int length)
+{
+    uint8_t message[2 + MIRROR_MESSAGE_SIZE];
+    message[0] = 0x80 | opcode;
+    message[1] = length;
+    memcpy(message + 2, payload, length);
+    return client_send(client, message, 2 + length);
+}
+
+
+/*
+ * Answer the upgrade request once it is all in
+ */
+static int client_handshake(display_mirror *mirror, mirror_client *client)
+{
+    char key[64 + sizeof(WS_GUID)];
+    char accept[32];
+    char response[160];
+    uint8_t digest[20];
+    char *line, *end;
+    int n;
+
+    client->request[client->request_length] = '\0';
+    if (strstr(client->request, "\r\n\r\n") == NULL)
+        return client->request_length < MIRROR_REQUEST_SIZE - 1 ? 0 : -1;
+    for (line = client->request; line != NULL; line = end) {
+        end = strstr(line, "\r\n");
+        if (end)
+            end += 2;
+        if (strncasecmp(line, "Sec-WebSocket-Key:", 18) == 0)
+            break;
+    }
+    if (line == NULL) {
+        static const char bad[] = "HTTP/1.1 400 Bad Request\r\n\r\n";
+        client_send(client, bad, sizeof(bad) - 1);
+        return -1;
+    }
+    line += 18;
+    while (*line == ' ')
+        line++;
+    for (n=0; n<64 && line[n] && line[n] != '\r' && line[n] != ' '; n++)
+        key[n] = line[n];
+    memcpy(key + n, WS_GUID, sizeof(WS_GUID));
+    sha1((const uint8_t *) key, n + sizeof(WS_GUID) - 1, digest);
+    base64(digest, sizeof(digest), accept);
+    n = snprintf(response, sizeof(response),
+                 "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                 "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", accept);
+    if (client_send(client, response, n) != 1)
+        return -1;
+    client->open = 1;
+    return 0;
+}
+
+
+/* The client has frame number, so diff against it from now on */
+static void client_ack(mirror_client *client, uint16_t number)
+{
+    int i;
+    for (i=0; i<client->in_flight; i++) {
+        if (client->sent[i] == number)
+            break;
+    }
+    if (i == client->in_flight)
+        return;
+    client->acked = number;
+    memcpy(client->base, client->sent_frames[i], DISPLAY_CHAIN_LENGTH);
+    /* It won't answer the older ones now */
+    i++;
+    memmove(client->sent, client->sent + i, (client->in_flight - i) * sizeof(client->sent[0]));
+    memmove(client->sent_frames, client->sent_frames + i,
+            (client->in_flight - i) * sizeof(client->sent_frames[0]));
+    client->in_flight -= i;
+}
+
+
+/*
+ * Act on whole messages from the client, which are masked
+ * Returns -1 to close it.
+ */
+static int client_messages(mirror_client *client)
+{
+    uint8_t *m = client->rx;
+    uint8_t payload[sizeof(client->rx)];
+    int length, i;
+
+    while (client->rx_length >= 6) {
+        length = m[1] & 0x7f;
+        if (!(m[1] & 0x80) || length > (int) sizeof(client->rx) - 6)
+            return -1;
+        if (client->rx_length < 6 + length)
+            return 0;
+        for (i=0; i<length; i++)
+            payload[i] = m[6 + i] ^ m[2 + i % 4];
+        switch (m[0] & 0x0f) {
+            case WS_BINARY:
+                if (length == 2)
+                    client_ack(client, payload[0] | payload[1] << 8);
+                break;
+            case WS_PING:
+                if (ws_send(client, WS_PONG, payload, length) < 0)
+                    return -1;
+                break;
+            case WS_CLOSE:
+                ws_send(client, WS_CLOSE, NULL, 0);
+                return -1;
+        }
+        client->rx_length -= 6 + length;
+        memmove(m, m + 6 + length, client->rx_length);
+    }
+    return 0;
+}
+
+
+/* Take whatever the client sent, -1 if it has gone */
+static int client_receive(mirror_client *client)
+{
+    int n;
+    for (;;) {
+        if (client->open)
+            n = recv(client->fd, client->rx + client->rx_length,
+                     sizeof(client->rx) - client->rx_length, 0);
+        else
+            n = recv(client->fd, client->request + client->request_length,
+                     MIRROR_REQUEST_SIZE - 1 - client->request_length, 0);
+        if (n == 0)
+            return -1;
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        if (client->open) {
+            client->rx_length += n;
+            if (client_messages(client) < 0)
+                return -1;
+        } else {
+            client->request_length += n;
+        }
+    }
+}
+
+
+/*
+ * Send the latest frame if the client is due one
+ */
+static void client_update(display_mirror *mirror, mirror_client *client, int64_t now)
+{
+    uint8_t message[MIRROR_MESSAGE_SIZE];
+    int n, rc, length = mirror->latest_length;
+
+    if (client->last == mirror->number || now < client->next_send)
+        return;
+    if (client->in_flight == MIRROR_IN_FLIGHT)
+        return;
+    message[0] = mirror->number;
+    message[1] = mirror->number >> 8;
+    message[2] = client->acked;
+    message[3] = client->acked >> 8;
+    message[4] = length;
+    n = mirror_delta_encode(client->base, mirror->latest, length,
+                            message + MIRROR_HEADER_BYTES);
+    if (n == 0 && client->acked) {
+        /* It already has this, there is nothing to say */
+        client->last = mirror->number;
+        return;
+    }
+    rc = ws_send(client, WS_BINARY, message, MIRROR_HEADER_BYTES + n);
+    if (rc < 0) {
+        mirror->stats.dropped++;
+        client_close(mirror, client);
+        return;
+    }
+    if (rc == 0) {
+        mirror->stats.stalled++;
+        return;
+    }
+    client->sent[client->in_flight] = mirror->number;
+    memcpy(client->sent_frames[client->in_flight], mirror->latest, DISPLAY_CHAIN_LENGTH);
+    client->in_flight++;
+    client->last = mirror->number;
+    client->next_send = now + 1000000 / MIRROR_MAX_FPS;
+    mirror->stats.sent++;
+    mirror->stats.bytes += 2 + MIRROR_HEADER_BYTES + n;
+}
+
+
+static void mirror_accept(display_mirror *mirror)
+{
+    mirror_client *client;
+    int fd, i;
+
+    while ((fd = accept(mirror->listener, NULL, NULL)) >= 0) {
+        for (i=0; i<MIRROR_MAX_CLIENTS && mirror->clients[i].fd >= 0; i++)
+            ;
+        if (i == MIRROR_MAX_CLIENTS) {
+            ESP_LOGW(TAG, "Too many clients");
+            close(fd);
+            continue;
+        }
+        client = &mirror->clients[i];
+        memset(client, 0, sizeof(*client));
+        client->fd = fd;
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        mirror->stats.clients++;
+        ESP_LOGI(TAG, "Client %d connected", i);
+    }
+}
+
+
+static void mirror_task(void *pvParameters)
+{
+    display_mirror *mirror = pvParameters;
+    mirror_client *client;
+    uint32_t seen = 0;
+    int64_t now, due;
+    int i, clients;
+    TickType_t wait;
+
+    for (;;) {
+        mirror_accept(mirror);
+        now = deadline_now();
+        if (mirror_take(mirror, &seen)) {
+            for (i=0, clients=0; i<MIRROR_MAX_CLIENTS; i++)
+                clients += mirror->clients[i].fd >= 0 && mirror->clients[i].open;
+            mirror->stats.raw_bytes += (unsigned long long) clients *
+                (2 + MIRROR_HEADER_BYTES + 2 * mirror->latest_length);
+        }
+        due = now + MIRROR_IDLE_POLL_MS * 1000LL;
+        for (i=0; i<MIRROR_MAX_CLIENTS; i++) {
+            client = &mirror->clients[i];
+            if (client->fd < 0)
+                continue;
+            if (client_receive(client) < 0 ||
+                (!client->open && client_handshake(mirror, client) < 0)) {
+                ESP_LOGI(TAG, "Client %d gone", i);
+                client_close(mirror, client);
+                continue;
+            }
+            if (client->open) {
+                client_update(mirror, client, now);
+                if (client->fd >= 0 && client->last != mirror->number &&
+                    client->next_send < due)
+                    due = client->next_send;
+            }
+            if (now + MIRROR_POLL_MS * 1000LL < due)
+                due = now + MIRROR_POLL_MS * 1000LL;
+        }
+        /* Until the next poll or frame due, or a new frame */
+        wait = (due - now + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000);
+        ulTaskNotifyTake(pdTRUE, wait ? wait : 1);
+    }
+}
+
+
+/*
+ * Listen for clients on port and mirror the display to them
+ * Port 0 takes any free one, see display_mirror_port().
+ */
+display_mirror* display_mirror_start(seven_segment_ui *display, int port,
+                                     int core, UBaseType_t priority)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_length = sizeof(addr);
+    display_mirror *mirror;
+    int i, one = 1;
+
+    mirror = &the_mirror;
+    if (mirror->task != NULL) {
+        ESP_LOGE(TAG, "There is only the one mirror");
+        return NULL;
+    }
+    memset(mirror, 0, sizeof(*mirror));
+    for (i=0; i<MIRROR_MAX_CLIENTS; i++)
+        mirror->clients[i].fd = -1;
+
+    mirror->listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (mirror->listener < 0) {
+        ESP_LOGE(TAG, "Unable to create a socket");
+        return NULL;
+    }
+    setsockopt(mirror->listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(mirror->listener, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+        listen(mirror->listener, MIRROR_MAX_CLIENTS) != 0 ||
+        getsockname(mirror->listener, (struct sockaddr *) &addr, &addr_length) != 0) {
+        ESP_LOGE(TAG, "Unable to listen on port %d", port);
+        close(mirror->listener);
+        return NULL;
+    }
+    fcntl(mirror->listener, F_SETFL, O_NONBLOCK);
+    mirror->port = ntohs(addr.sin_port);
+
+    mirror->task = task_start(TASK_MIRROR, mirror_task, mirror, priority, core);
+    if (mirror->task == NULL) {
+        ESP_LOGE(TAG, "Unable to start the mirror");
+        close(mirror->listener);
+        return NULL;
+    }
+    /* From the next frame presented */
+    display->mirror = mirror;
+    ESP_LOGI(TAG, "Mirroring the display on port %d", mirror->port);
+    return mirror;
+}
+
+
+int display_mirror_port(const display_mirror *mirror)
+{
+    return mirror->port;
+}
+
+
+void display_mirror_get_stats(const display_mirror *mirror, display_mirror_stats *stats)
+{
+    *stats = mirror->stats;
+}
+#endif
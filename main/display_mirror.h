@@ -0,0 +1,117 @@
+#ifndef DISPLAY_MIRROR_H
+#define DISPLAY_MIRROR_H
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "7_seg_ui.h"
+#include "tasks.h"
+
+/*
+ * Display mirror
+ * Streams what the display shows to WebSocket clients, e.g. a browser at
+ * ws://<unit>:MIRROR_PORT/, so the units at a venue can be watched from
+ * one place.  Needs the network up, see wifi.h.
+ *
+ * display_present() hands each frame it puts on the bus over through a
+ * sequence counted slot, so the game and the display service never wait
+ * on the network.  The mirror task takes the latest frame when it gets
+ * round to it: a burst of frames between two sends is just the last one.
+ * Each client gets at most MIRROR_MAX_FPS frames a second.
+ *
+ * A frame goes out as its difference from the last frame that client
+ * acknowledged, XORed and run-length coded, in a binary message:
+ *   number   2 bytes, little endian, never 0
+ *   base     2 bytes, the acknowledged frame it is against, 0 for blank
+ *   length   1 byte, bytes in the frame: 16 per board
+ *   tokens   a byte each of (unchanged bytes to skip << 4 | bytes to XOR),
+ *            then that many bytes to XOR into the base; anything after the
+ *            last token is as in the base
+ * The client answers each frame it applies with its number, 2 bytes, in
+ * a binary message.  No more than MIRROR_IN_FLIGHT frames go out to a
+ * client without an answer, so a slow client gets fewer, fresher frames.
+ *
+ * Only with DISPLAY_MIRROR_ENABLE set, see tasks.h; otherwise just the
+ * delta coding and display_mirror_frame() are built, and neither the
+ * mirror's state nor its task's stack take RAM.
+ */
+#ifndef MIRROR_PORT
+#define MIRROR_PORT 8080
+#endif
+#ifndef MIRROR_MAX_CLIENTS
+#define MIRROR_MAX_CLIENTS 4
+#endif
+#ifndef MIRROR_MAX_FPS
+#define MIRROR_MAX_FPS 10
+#endif
+#ifndef MIRROR_IN_FLIGHT
+#define MIRROR_IN_FLIGHT 4
+#endif
+/* How often the sockets are looked at, with and without clients */
+#ifndef MIRROR_POLL_MS
+#define MIRROR_POLL_MS 20
+#endif
+#ifndef MIRROR_IDLE_POLL_MS
+#define MIRROR_IDLE_POLL_MS 200
+#endif
+#define MIRROR_REQUEST_SIZE 512
+#define MIRROR_HEADER_BYTES 5
+/* A token per byte at worst */
+#define MIRROR_MESSAGE_SIZE (4 + MIRROR_HEADER_BYTES + 2 * DISPLAY_CHAIN_LENGTH)
+
+typedef struct {
+    int fd;                     /* -1 when the slot is free */
+    uint8_t open;               /* Handshake done */
+    char request[MIRROR_REQUEST_SIZE];
+    uint16_t request_length;
+    uint8_t rx[16];             /* Part of a message from the client */
+    uint8_t rx_length;
+    uint16_t acked;             /* Newest frame it answered, 0 for none */
+    uint8_t base[DISPLAY_CHAIN_LENGTH];
+    uint16_t sent[MIRROR_IN_FLIGHT];    /* Frames not yet answered, oldest first */
+    uint8_t sent_frames[MIRROR_IN_FLIGHT][DISPLAY_CHAIN_LENGTH];
+    uint8_t in_flight;
+    uint16_t last;              /* Newest frame sent */
+    int64_t next_send;          /* Not before, for the frame rate */
+} mirror_client;
+
+typedef struct {
+    unsigned long clients;      /* Connections accepted */
+    unsigned long frames;       /* Taken from the display */
+    unsigned long sent;         /* Messages to clients */
+    unsigned long long bytes;   /* ... including the WebSocket framing */
+    unsigned long long raw_bytes;   /* Had every frame taken gone whole to every client */
+    unsigned long stalled;      /* Sends put off, the socket was full */
+    unsigned long dropped;      /* Clients closed for falling too far behind */
+} display_mirror_stats;
+
+typedef struct display_mirror {
+    /* Written by display_present(), odd while a frame is being copied in */
+    uint32_t sequence;
+    uint8_t frame[DISPLAY_CHAIN_LENGTH];
+    uint8_t length;
+    TaskHandle_t task;
+    int listener;
+    int port;
+    uint16_t number;            /* Of the latest frame taken */
+    uint8_t latest[DISPLAY_CHAIN_LENGTH];
+    uint8_t latest_length;
+    mirror_client clients[MIRROR_MAX_CLIENTS];
+    display_mirror_stats stats;
+} display_mirror;
+
+extern display_mirror* display_mirror_start(seven_segment_ui *display, int port,
+                                            int core, UBaseType_t priority);
+extern void display_mirror_frame(display_mirror *mirror, const uint8_t *frame,
+                                 int length);
+extern int display_mirror_port(const display_mirror *mirror);
+extern void display_mirror_get_stats(const display_mirror *mirror,
+                                     display_mirror_stats *stats);
+extern int mirror_delta_encode(const uint8_t *base, const uint8_t *frame,
+                               int length, uint8_t *out);
+extern int mirror_delta_decode(const uint8_t *base, const uint8_t *tokens,
+                               int size, int length, uint8_t *frame);
+
+#endif
@@ -0,0 +1,194 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "7_seg_ui.h"
+#include "display_service.h"
+#include "power.h"
+#include "animation.h"
+#include "deadline.h"
+#include "tasks.h"
+#include "latency.h"
+
+static const char *TAG = "display";
+
+static display_service the_service;
+
+/*
+ * Hand a frame over to the service, never blocks
+ */
+void display_service_publish(display_service *service, const uint8_t *buffer,
+                             uint8_t flash)
+{
+    display_frame *frame = &service->frames[service->back];
+    uint32_t old;
+
+    memcpy(frame->buffer, buffer, DISPLAY_CHAIN_LENGTH);
+    frame->flash = flash;
+    old = __atomic_exchange_n(&service->middle,
+                              service->back | DISPLAY_SERVICE_FRESH,
+                              __ATOMIC_ACQ_REL);
+    service->back = old & 0x03;
+    service->published++;
+    if (old & DISPLAY_SERVICE_FRESH)
+        service->superseded++;
+    /* Any press it shows is on its way once the frame is in the slot */
+    latency_published();
+    /* Present it now rather than at the next period */
+    xTaskNotifyGive(service->task);
+}
+
+
+/*
+ * Have the service present again now if it is waiting at the idle period
+ */
+void display_service_kick(display_service *service)
+{
+    if (__atomic_load_n(&service->idle, __ATOMIC_ACQUIRE))
+        xTaskNotifyGive(service->task);
+}
+
+
+/*
+ * Latest key scan and its number, never blocks
+ * The keys and the number are one word, so they always go together.
+ */
+uint8_t display_service_keys(display_service *service, uint32_t *scan)
+{
+    uint32_t keys = __atomic_load_n(&service->keys, __ATOMIC_ACQUIRE);
+    *scan = keys >> DISPLAY_SERVICE_SCAN_SHIFT;
+    return (uint8_t) keys;
+}
+
+
+/*
+ * Wait up to ticks for the next key scan, returns whether there was one
+ * Only one task can wait, a scan made since its last wait counts.
+ */
+int display_service_wait_keys(display_service *service, TickType_t ticks)
+{
+    __atomic_store_n(&service->keys_waiter, xTaskGetCurrentTaskHandle(),
+                     __ATOMIC_RELEASE);
+    return ulTaskNotifyTake(pdTRUE, ticks) != 0;
+}
+
+
+static void display_service_task(void *pvParameters)
+{
+    display_service *service = pvParameters;
+    seven_segment_ui *display = service->display;
+    TickType_t wake = xTaskGetTickCount();
+    display_frame *frame;
+    uint8_t composed[DISPLAY_CHAIN_LENGTH];
+    const uint8_t *buffer;
+    uint32_t old;
+    uint8_t keys;
+    uint8_t fast = 0;           /* Scans on time left at the rescan rate */
+    TickType_t now, period;
+    TaskHandle_t waiter;
+
+    for (;;) {
+        latency_presenting();
+        /* Take the fresh frame if there is one */
+        if (__atomic_load_n(&service->middle, __ATOMIC_ACQUIRE) & DISPLAY_SERVICE_FRESH) {
+            old = __atomic_exchange_n(&service->middle, service->front,
+                                      __ATOMIC_ACQ_REL);
+            service->front = old & 0x03;
+        }
+        /* Present every period, the flashing digits depend on the time */
+        frame = &service->frames[service->front];
+        buffer = frame->buffer;
+        if (animation_compose(display->animations, deadline_now(), buffer, composed))
+            buffer = composed;
+        power_lock(POWER_BUS);
+        display_present(display, buffer, frame->flash);
+        service->presented++;
+
+        keys = bb_read_buttons(display);
+        power_unlock(POWER_BUS);
+        __atomic_store_n(&service->keys,
+                         display->key_scans << DISPLAY_SERVICE_SCAN_SHIFT | keys,
+                         __ATOMIC_RELEASE);
+        waiter = __atomic_load_n(&service->keys_waiter, __ATOMIC_ACQUIRE);
+        if (waiter)
+            xTaskNotifyGive(waiter);
+
+        /* While keys are down, and until the scan on time after they are
+         * let go of, scan at the input rate */
+        if (keys)
+            fast = 2;
+        period = fast ? service->rescan : service->period;
+        /* Animations need every period to move on */
+        if (power_idle() && period == service->period &&
+            !animation_active(display->animations)) {
+            __atomic_store_n(&service->idle, 1, __ATOMIC_RELEASE);
+            /* Unless a frame or animation came in while we were deciding */
+            if (!(__atomic_load_n(&service->middle, __ATOMIC_ACQUIRE) & DISPLAY_SERVICE_FRESH)
+                && !animation_active(display->animations))
+                ulTaskNotifyTake(pdTRUE, power_idle_ticks());
+            __atomic_store_n(&service->idle, 0, __ATOMIC_RELEASE);
+            wake = xTaskGetTickCount();
+        } else {
+            /* Until the next period, or sooner for a new frame */
+            for (;;) {
+                now = xTaskGetTickCount();
+                if (now - wake >= period) {
+                    wake += period;
+                    if (fast)
+                        fast--;
+                    break;
+                }
+                ulTaskNotifyTake(pdTRUE, wake + period - now);
+                if (__atomic_load_n(&service->middle, __ATOMIC_ACQUIRE) & DISPLAY_SERVICE_FRESH)
+                    break;
+            }
+        }
+        power_wakeup();
+    }
+}
+
+
+/*
+ * Start a display service task on the given core
+ * From now on update_display() and read_buttons() on this display go
+ * through the service and no other task may touch the bus.
+ */
+display_service* display_service_start(seven_segment_ui *display, int core,
+                                       int period_ms, UBaseType_t priority)
+{
+    display_service *service = &the_service;
+    if (service->display != NULL) {
+        ESP_LOGE(TAG, "There is only the one display service");
+        return NULL;
+    }
+    memset(service, 0, sizeof(*service));
+    service->display = display;
+    /* Start from what is in the buffer now */
+    memcpy(service->frames[1].buffer, display->display_buffer, DISPLAY_CHAIN_LENGTH);
+    service->frames[1].flash = display->flash;
+    service->back = 0;
+    service->front = 1;
+    service->middle = 2;
+    service->period = period_ms / portTICK_PERIOD_MS;
+    if (service->period == 0)
+        service->period = 1;
+    service->rescan = DISPLAY_SERVICE_RESCAN_MS / portTICK_PERIOD_MS;
+    if (service->rescan == 0 || service->rescan > service->period)
+        service->rescan = service->period;
+
+    service->task = task_start(TASK_DISPLAY, display_service_task, service,
+                               priority, core);
+    if (service->task == NULL) {
+        ESP_LOGE(TAG, "Unable to start display service");
+        service->display = NULL;
+        return NULL;
+    }
+    /* Only now is there a task for a publish to notify */
+    __atomic_store_n(&display->service, service, __ATOMIC_RELEASE);
+    ESP_LOGI(TAG, "Display service on core %d every %d ticks", core, service->period);
+    return service;
+}
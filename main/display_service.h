@@ -0,0 +1,67 @@
+#ifndef DISPLAY_SERVICE_H
+#define DISPLAY_SERVICE_H
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "7_seg_ui.h"
+
+/*
+ * Display service
+ * A task that owns the display bus.  It presents the latest published
+ * frame at a fixed rate and scans the keys on the same schedule.  While
+ * the power manager says we are idle and no key is down it only wakes
+ * every POWER_IDLE_PERIOD_MS.  A published frame is presented straight
+ * away, without waiting for the period, so a press shows as soon as the
+ * game has acted on it.  Animations keep it at the full rate until they
+ * finish.  While a key is down, and for one scan after, it scans every
+ * DISPLAY_SERVICE_RESCAN_MS instead, so the input service has fresh scans
+ * to debounce presses and releases with at its own rate.
+ *
+ * Frames are handed over through three slots: the producer fills the back
+ * slot and atomically swaps it with the middle one, the service swaps the
+ * middle slot with its front slot when a fresh frame is waiting.  Neither
+ * side ever blocks or takes a lock.  There must be only one producer per
+ * display, which is how update_display() is used today.
+ */
+#ifndef DISPLAY_SERVICE_RESCAN_MS
+#define DISPLAY_SERVICE_RESCAN_MS 10
+#endif
+
+typedef struct {
+    uint8_t buffer[DISPLAY_CHAIN_LENGTH];
+    uint8_t flash;
+} display_frame;
+
+typedef struct display_service {
+    seven_segment_ui *display;
+    display_frame frames[3];
+    uint8_t back;               /* Producer's slot */
+    uint8_t front;              /* Service's slot */
+    uint32_t middle;            /* Slot in between, DISPLAY_SERVICE_FRESH if unseen */
+    uint32_t keys;              /* Last key scan, and its number above DISPLAY_SERVICE_SCAN_SHIFT */
+    TickType_t period;
+    TickType_t rescan;          /* Period while keys are down */
+    TaskHandle_t task;
+    TaskHandle_t keys_waiter;   /* Notified after each key scan */
+    uint32_t idle;              /* Waiting for a frame at the idle period */
+    unsigned long published;
+    unsigned long presented;
+    unsigned long superseded;   /* Published but replaced before being presented */
+} display_service;
+
+#define DISPLAY_SERVICE_FRESH 0x80
+#define DISPLAY_SERVICE_SCAN_SHIFT 8
+
+extern display_service* display_service_start(seven_segment_ui *display,
+                                               int core, int period_ms,
+                                               UBaseType_t priority);
+extern void display_service_publish(display_service *service,
+                                    const uint8_t *buffer, uint8_t flash);
+extern void display_service_kick(display_service *service);
+extern uint8_t display_service_keys(display_service *service, uint32_t *scan);
+extern int display_service_wait_keys(display_service *service, TickType_t ticks);
+
+#endif
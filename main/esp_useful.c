@@ -2,7 +2,8 @@
 
 #include "time.h"
 
-clock_t clock_ms()
+unsigned long clock_ms()
 {
-    return (clock_t) (1000 / CLOCKS_PER_SEC * clock());
-}
\ No newline at end of file
+    /* Scale before dividing, CLOCKS_PER_SEC need not divide 1000 */
+    return (unsigned long) ((unsigned long long) clock() * 1000 / CLOCKS_PER_SEC);
+}
@@ -0,0 +1,115 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include "deadline.h"
+#include "executor.h"
+
+
+void executor_init(executor *ex)
+{
+    memset(ex, 0, sizeof(*ex));
+}
+
+
+/*
+ * Add a job, to run on the next pass
+ * Only from the executor's task.
+ */
+void executor_add(executor *ex, executor_job *job, executor_step step,
+                  int events)
+{
+    job->step = step;
+    job->due = deadline_now();
+    job->events = events;
+    job->steps = 0;
+    job->next = ex->jobs;
+    ex->jobs = job;
+}
+
+
+/*
+ * Have a job run on the next pass, e.g. once something has been handed to
+ * it from another job.  Only from the executor's task.
+ */
+void executor_wake(executor_job *job)
+{
+    job->due = deadline_now();
+}
+
+
+/* Whether a job is due at now */
+static int executor_due(const executor_job *job, int64_t now)
+{
+    return job->due != EXECUTOR_NEVER && job->due - now <= 0;
+}
+
+
+/*
+ * Step every job that is due, and every events job if woken
+ * Returns the earliest any job now wants to run, EXECUTOR_NEVER if none
+ * has a time.
+ */
+int64_t executor_pass(executor *ex, int woken)
+{
+    executor_job **link = &ex->jobs;
+    executor_job *job;
+    int64_t now, start;
+    int64_t earliest = EXECUTOR_NEVER;
+
+    ex->passes++;
+    while ((job = *link) != NULL) {
+        now = deadline_now();
+        if (executor_due(job, now) || (woken && job->events)) {
+            start = esp_timer_get_time();
+            job->due = job->step(job, now);
+            job->steps++;
+            ex->steps++;
+            ex->busy_us += esp_timer_get_time() - start;
+            if (job->due == EXECUTOR_DONE) {
+                *link = job->next;
+                continue;
+            }
+        }
+        link = &job->next;
+    }
+    /* Again, a step may have added jobs ahead of itself */
+    for (job = ex->jobs; job != NULL; job = job->next) {
+        if (job->due != EXECUTOR_NEVER &&
+            (earliest == EXECUTOR_NEVER || job->due - earliest < 0))
+            earliest = job->due;
+    }
+    return earliest;
+}
+
+
+/*
+ * Ticks to block for to wake as due comes round, as deadline_ticks()
+ */
+TickType_t executor_ticks(int64_t due, int64_t now)
+{
+    if (due == EXECUTOR_NEVER)
+        return portMAX_DELAY;
+    return deadline_delay_ticks(due - now);
+}
+
+
+/*
+ * Run the jobs on the calling task until none are left
+ */
+void executor_run(executor *ex)
+{
+    int64_t earliest;
+    int woken = 0;
+
+    while (ex->jobs != NULL) {
+        earliest = executor_pass(ex, woken);
+        if (ex->jobs == NULL)
+            break;
+        woken = ulTaskNotifyTake(pdTRUE, executor_ticks(earliest, deadline_now())) != 0;
+    }
+}
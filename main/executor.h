@@ -0,0 +1,59 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Cooperative executor
+ * Runs any number of jobs on the one task, each a step function that does
+ * a slice of work and returns when it next wants to run.  Between passes
+ * the task sleeps until the earliest of those, or until it is notified,
+ * e.g. by an input ring (spsc.h) it is the consumer of.  A job added with
+ * events set also runs on every notification, to take what came in.
+ *
+ * A step returns:
+ *   a time on deadline_now()'s clock   run then, or straight away if it
+ *                                      has passed
+ *   EXECUTOR_NEXT_TICK(now)            more to do, after the other tasks
+ *                                      have had a tick
+ *   EXECUTOR_NEVER                     only on a notification
+ *   EXECUTOR_DONE                      finished, take the job off
+ *
+ * Nothing is allocated: the caller owns each job, usually as the first
+ * member of what it runs so the step can get back to that.  Jobs may only
+ * be added from the executor's own task, which includes from a step.
+ */
+#define EXECUTOR_NEVER INT64_MAX
+#define EXECUTOR_DONE INT64_MIN
+#define EXECUTOR_NEXT_TICK(now) ((now) + 1)
+
+struct executor_job;
+typedef int64_t (*executor_step)(struct executor_job *job, int64_t now);
+
+typedef struct executor_job {
+    executor_step step;
+    int64_t due;
+    uint8_t events;             /* Also run on every notification */
+    unsigned long steps;
+    struct executor_job *next;
+} executor_job;
+
+typedef struct {
+    executor_job *jobs;
+    unsigned long passes;
+    unsigned long steps;
+    int64_t busy_us;            /* In steps, on esp_timer */
+} executor;
+
+extern void executor_init(executor *ex);
+extern void executor_add(executor *ex, executor_job *job, executor_step step,
+                         int events);
+extern void executor_wake(executor_job *job);
+extern int64_t executor_pass(executor *ex, int woken);
+extern TickType_t executor_ticks(int64_t due, int64_t now);
+extern void executor_run(executor *ex);
+
+#endif
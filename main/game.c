@@ -0,0 +1,351 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_system.h"
+
+#include "7_seg_ui.h"
+#include "game.h"
+#include "sound.h"
+#include "input_service.h"
+#include "power.h"
+#include "deadline.h"
+#include "animation.h"
+#include "trace.h"
+#include "profile.h"
+#include "mastermind.h"
+#include "session.h"
+#include "stats_log.h"
+#include "latency.h"
+
+static const char *TAG = "game";
+
+
+/* A bit per digit, 1=NOMATCH, digit 0 in the top bit */
+uint8_t game_check(const uint8_t *code, const uint8_t *secret)
+{
+    uint8_t flash = code_misses(code_pack(code), code_pack(secret)) << 4;
+    ESP_LOGD(TAG, "Check Code: %02x", flash);
+    return flash;
+}
+
+/* What the player learnt from a check, for the solver */
+uint8_t game_response(uint8_t flash)
+{
+    return ~flash >> 4 & 0x0f;
+}
+
+/* Give the solver its share of this step, returns whether it has more to do */
+int game_think(solver *s)
+{
+    solver_state state;
+    PROFILE_START(PROFILE_SOLVER_STEP);
+    state = solver_step(s, SOLVER_FRAME_CODES);
+    PROFILE_END(PROFILE_SOLVER_STEP);
+    return state == SOLVER_FILTERING || state == SOLVER_SEARCHING;
+}
+
+
+/* esp_random() % range, recorded or replayed on the board */
+static uint32_t game_random(game_session *game, uint32_t range)
+{
+    if (game->flags & GAME_BOARD)
+        return session_random(range);
+    return esp_random() % range;
+}
+
+/* Show the display buffer, only the board has anywhere to show it */
+static void game_present(game_session *game)
+{
+    if (game->flags & GAME_BOARD)
+        update_display(game->display);
+}
+
+static void game_tick(game_session *game)
+{
+    #if GAME_TICK
+    if ((game->flags & GAME_BOARD) && game_random(game, GAME_MISS_TICK))
+        sound_beep(portTICK_PERIOD_MS);
+    #endif
+}
+
+/* Start the end of game sweep, returns the animation to wait for */
+static int game_endgame(game_session *game)
+{
+    /* Sound for as long as the sweep takes, 10 * (8 + 7 + ... + 1) ticks */
+    if (game->flags & GAME_BOARD)
+        sound_beep(360 * portTICK_PERIOD_MS);
+    return animation_play(game->display, &animation_sweep);
+}
+
+
+/*
+ * Set up a game of count_from seconds, for game_step() to play
+ */
+void game_start(game_session *game, seven_segment_ui *display,
+                unsigned int count_from, uint8_t flags)
+{
+    memset(game, 0, sizeof(*game));
+    game->display = display;
+    game->flags = flags;
+    game->countdown = -1;
+    game->sweep = -1;
+    game->started = deadline_now();
+    game->replay_due = EXECUTOR_NEVER;
+    game->result.count_from = count_from;
+    if (flags & GAME_BOARD) {
+        power_lock(POWER_GAME);
+        /* Buttons and random numbers from here on are recorded, or replayed */
+        session_begin(display, count_from);
+    }
+    game->state = GAME_WAITING;
+}
+
+
+/*
+ * Buttons let go of, for a session not on the board, e.g. from a script
+ * Only from the task running the session.
+ */
+void game_press(game_session *game, uint8_t buttons)
+{
+    game->buttons |= buttons;
+    executor_wake(&game->job);
+}
+
+
+/* Act on the buttons let go of in the state we're in */
+static void game_advance(game_session *game)
+{
+    seven_segment_ui *display = game->display;
+    uint8_t buttons = game->buttons;
+    int i;
+
+    switch (game->state) {
+        case GAME_STARTED:
+            display_code(display, NULL);
+            if (game->countdown == 0) {
+                game->state = GAME_TIMEUP;
+                ESP_LOGD(TAG, "State: TIMEUP");
+            } else if (buttons) {
+                game->state = GAME_GUESSING;
+                ESP_LOGD(TAG, "State: GUESSING");
+            }
+            break;
+        case GAME_GUESSING:
+            if (game->countdown == 0) {
+                game->state = GAME_TIMEUP;
+                ESP_LOGD(TAG, "State: TIMEUP");
+            } else {
+                /* Update the guessed code */
+                for (i=0; i<4; i++) {
+                    if (buttons & (0x80 >> i))
+                        game->code[i] = (game->code[i] + 1) % 10;
+                }
+                #if GAME_END_BUTTON
+                if (buttons & 0x08) {
+                    /* This button will not be pushable when built... */
+                    ESP_LOGE(TAG, "Artificially ended game!");
+                    ESP_LOGD(TAG, "State: GAMEOVER");
+                    game->state = GAME_OVER;
+                }
+                #endif
+                #if GAME_HINT
+                /* Only the responses the player has seen go in, so a
+                 * hint asked for while thinking comes when it's done */
+                if (buttons & 0x02)
+                    game->hint = 1;
+                if (game->hint && !game->thinking) {
+                    game->hint = 0;
+                    game->result.hints++;
+                    code_unpack(solver_guess(&game->hints), game->code);
+                    game->countdown = game->countdown > GAME_HINT_SECONDS ?
+                                      game->countdown - GAME_HINT_SECONDS : 1;
+                    ESP_LOGI(TAG, "Hint %d%d%d%d", game->code[0], game->code[1],
+                             game->code[2], game->code[3]);
+                }
+                #endif
+                if (buttons & 0x01) {
+                    if (game->result.guesses < UINT8_MAX)
+                        game->result.guesses++;
+                    display->flash = game_check(game->code, game->secret);
+                    solver_response(&game->hints, code_pack(game->code),
+                                    game_response(display->flash));
+                    ESP_LOGI(TAG, "Guess %02x", display->flash);
+                    if ((display->flash & 0xf0) == 0x00) {
+                        game->state = GAME_CORRECT;
+                        game->result.outcome = STATS_CORRECT;
+                        game->result.duration_ms = (deadline_now() - game->started) / 1000;
+                        if (game->flags & GAME_BOARD)
+                            sound_play(sound_win, sound_win_length);
+                        ESP_LOGD(TAG, "State: CORRECT");
+                        deadline_start(&game->reset_now, deadline_now(),
+                                       DEADLINE_MS(9000), 0);
+                    }
+                }
+            }
+            display_code(display, game->code);
+            break;
+        case GAME_CORRECT:
+            display->flash = 0x0f;
+            display_code(display, game->code);
+            if (deadline_expired(&game->reset_now, deadline_now())) {
+                game->state = GAME_OVER;
+                ESP_LOGD(TAG, "State: RESETTING");
+            }
+            break;
+        case GAME_TIMEUP:
+            game->result.outcome = STATS_TIMEUP;
+            game->result.duration_ms = (deadline_now() - game->started) / 1000;
+            game->state = GAME_ENDING;
+            ESP_LOGD(TAG, "State: ENDING");
+            game->sweep = game_endgame(game);
+            break;
+        case GAME_ENDING:
+            /* Keep showing the time until the sweep is done */
+            if (!animation_playing(display, game->sweep)) {
+                game->state = GAME_OVER;
+                ESP_LOGD(TAG, "State: GAMEOVER");
+            }
+            break;
+        case GAME_RESETTING:
+            game->state = GAME_STARTED;
+            ESP_LOGD(TAG, "State: STARTED");
+            display->flash = 0xf0;
+            game->countdown = game->result.count_from;
+            /* The first second starts now, game_step() set when that was */
+            deadline_start(&game->second_timer, game->started, DEADLINE_MS(1000),
+                           DEADLINE_MS(1000));
+            deadline_start(&game->refresh, game->started, DEADLINE_MS(GAME_REFRESH_MS),
+                           DEADLINE_MS(GAME_REFRESH_MS));
+            for (i=0; i<4; i++) {
+                game->secret[i] = game_random(game, 10);
+                game->code[i] = 0;
+            }
+            solver_start(&game->hints, MASTERMIND_POSITIONS);
+            display_blank(display);
+            break;
+        case GAME_OVER:
+        case GAME_WAITING:
+            break;
+        default:
+            ESP_LOGE(TAG, "Unhandled game state");
+    }
+}
+
+
+static void game_finish(game_session *game)
+{
+    display_blank(game->display);
+    game_present(game);
+    if (!(game->flags & GAME_BOARD))
+        return;
+    #if STATS_LOG_ENABLE
+    /* A replayed game was logged when it was played */
+    if (game->result.outcome && session_get_mode() != SESSION_REPLAYING)
+        stats_log_game(&game->result);
+    #endif
+    session_end();
+    /* Don't let presses made during the game start another one */
+    input_flush();
+    power_unlock(POWER_GAME);
+}
+
+
+/*
+ * Executor step: take the buttons let go of since the last step and act
+ * on them, then on any timers that have gone off
+ * Returns when the next timer goes off, or straight away while the hint
+ * solver has thinking to do.
+ */
+int64_t game_step(executor_job *job, int64_t now)
+{
+    game_session *game = (game_session *) job;
+    seven_segment_ui *display = game->display;
+    deadline_timer * const timers[] = {
+        &game->second_timer, &game->refresh, &game->reset_now
+    };
+    unsigned int seconds;
+    int64_t due, remaining;
+    int i;
+
+    /*
+     * Start the clock on the next tick.  The executor wakes on ticks, so
+     * timers started as it wakes come due as it wakes again, where from
+     * part way through a tick each would wait for the tick after.
+     */
+    if (game->state == GAME_WAITING) {
+        game->state = GAME_RESETTING;
+        return EXECUTOR_NEXT_TICK(now);
+    }
+    /* The next step only sets the game up */
+    if (game->state == GAME_RESETTING)
+        game->started = now;
+    else if (game->flags & GAME_BOARD) {
+        game->replay_due = EXECUTOR_NEVER;
+        game->buttons |= session_poll_released(now, &game->replay_due);
+    }
+    for (;;) {
+        PROFILE_START(PROFILE_GAME_LOOP);
+        game_advance(game);
+        /* We have dealt with any released buttons now, show it straight
+         * away rather than at the next refresh */
+        if (game->buttons) {
+            if (game->flags & GAME_BOARD)
+                latency_changed(game->buttons);
+            game_present(game);
+        }
+        game->buttons = 0;
+
+        /* Manage timed events */
+        now = deadline_now();
+        seconds = deadline_expired(&game->second_timer, now);
+        if (seconds && (game->state == GAME_STARTED || game->state == GAME_GUESSING)) {
+            /* Catch up if we were held up for more than a second */
+            game->countdown = (game->countdown > (int) seconds) ?
+                              game->countdown - (int) seconds : 0;
+            TRACE(TRACE_COUNTDOWN, game->countdown, 0);
+            display_timer(display, game->countdown);
+            game_present(game);
+            game_tick(game);
+        }
+
+        if (deadline_reached(&game->refresh, now))
+            PROFILE_LATE(PROFILE_GAME_LATENESS, now - game->refresh.due);
+        if (deadline_expired(&game->refresh, now)) {
+            display_timer(display, game->countdown);
+            game_present(game);
+        }
+
+        /* Work out the next hint a bit at a time */
+        #if GAME_HINT
+        if (game->state == GAME_STARTED || game->state == GAME_GUESSING)
+            game->thinking = game_think(&game->hints);
+        #endif
+
+        PROFILE_END(PROFILE_GAME_LOOP);
+
+        if (game->state == GAME_OVER) {
+            game_finish(game);
+            return EXECUTOR_DONE;
+        }
+        /* Straight round again if time has just run out */
+        if (game->countdown != 0 || game->state == GAME_ENDING)
+            break;
+    }
+
+    /* Come back for the next timed event, or buttons, or next tick while
+     * the solver is still thinking */
+    now = deadline_now();
+    due = game->replay_due;
+    for (i=0; i<3; i++) {
+        remaining = deadline_remaining(timers[i], now);
+        if (remaining >= 0 && now + remaining - due < 0)
+            due = now + remaining;
+    }
+    if (game->thinking && due - EXECUTOR_NEXT_TICK(now) > 0)
+        due = EXECUTOR_NEXT_TICK(now);
+    return due;
+}
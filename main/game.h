@@ -0,0 +1,87 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdint.h>
+
+#include "7_seg_ui.h"
+#include "deadline.h"
+#include "executor.h"
+#include "mastermind.h"
+#include "stats_log.h"
+
+/*
+ * Game sessions
+ * A game of countdown, the secret code against the clock, as an object
+ * whose step advances it by whatever has happened since the last step: the
+ * buttons let go and the timers gone off.  The step never blocks, so an
+ * executor (executor.h) can run it alongside other sessions, animations
+ * and background work on one task.  Everything the game needs is in the
+ * session, hint solver included, so there is no heap and no globals.
+ *
+ * The session with GAME_BOARD is the one on the unit's own board: it takes
+ * its buttons from the input service, through session.h so the game is
+ * recorded or replayed, presents its display, beeps and goes in the stats
+ * log.  There is only one of those at a time.  Other sessions render into
+ * a display buffer of their own and get their buttons from game_press().
+ */
+/* S7 dials in the solver's next guess, for a price */
+#ifndef GAME_HINT
+#define GAME_HINT 1
+#endif
+#ifndef GAME_HINT_SECONDS
+#define GAME_HINT_SECONDS 10
+#endif
+/* S5 ends the game straight away, for testing */
+#ifndef GAME_END_BUTTON
+#define GAME_END_BUTTON 1
+#endif
+/* A tick a second, on average one in GAME_MISS_TICK is missed */
+#ifndef GAME_TICK
+#define GAME_TICK 1
+#endif
+#define GAME_MISS_TICK 6000
+#define GAME_REFRESH_MS 50
+
+#define GAME_BOARD 0x01
+
+typedef enum {
+    GAME_STARTED,
+    GAME_GUESSING,
+    GAME_CORRECT,
+    GAME_TIMEUP,
+    GAME_ENDING,
+    GAME_RESETTING,
+    GAME_OVER,
+    GAME_WAITING                /* For a tick to start on */
+} game_state;
+
+typedef struct {
+    executor_job job;           /* First, for game_step() to get back here */
+    seven_segment_ui *display;
+    uint8_t flags;
+    game_state state;
+    uint8_t secret[4];
+    uint8_t code[4];
+    uint8_t buttons;            /* Let go of and not yet dealt with */
+    int countdown;
+    int sweep;                  /* End of game animation */
+    int thinking;
+    int hint;
+    int64_t started;
+    int64_t replay_due;         /* When a replay's next buttons are */
+    deadline_timer second_timer;
+    deadline_timer refresh;
+    deadline_timer reset_now;
+    stats_game result;
+    solver hints;
+} game_session;
+
+extern void game_start(game_session *game, seven_segment_ui *display,
+                       unsigned int count_from, uint8_t flags);
+extern int64_t game_step(executor_job *job, int64_t now);
+extern void game_press(game_session *game, uint8_t buttons);
+extern uint8_t game_check(const uint8_t *code, const uint8_t *secret);
+extern uint8_t game_response(uint8_t flash);
+extern int game_think(solver *s);
+
+#endif
@@ -0,0 +1,242 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "7_seg_ui.h"
+#include "display_service.h"
+#include "input_service.h"
+#include "power.h"
+#include "spsc.h"
+#include "tasks.h"
+#include "trace.h"
+#include "latency.h"
+
+static const char *TAG = "input";
+
+/*
+ * The input task produces events and whoever calls input_wait() consumes
+ * them, the game on the other core from the display.  The tilt ISR is a
+ * second producer, so it gets a ring of its own.
+ */
+static input_event events_items[INPUT_QUEUE_LENGTH];
+static input_event isr_items[INPUT_ISR_QUEUE_LENGTH];
+
+static struct {
+    seven_segment_ui *display;
+    spsc_ring events;
+    spsc_ring isr_events;
+    uint8_t stable;             /* Debounced state */
+    uint32_t scan;              /* Number of the last key scan debounced */
+    int64_t scanned_at;         /* ... and when */
+    uint8_t long_sent;          /* Held buttons already reported as long presses */
+    uint8_t count[8];           /* Consecutive scans disagreeing with stable */
+    int64_t first_seen[8];      /* When the disagreement started */
+    int64_t pressed_at[8];
+} input;
+
+
+static void input_post(uint8_t type, uint8_t button, int64_t timestamp)
+{
+    input_event event = {
+        .timestamp = timestamp,
+        .type = type,
+        .button = button,
+        .buttons = input.stable,
+    };
+    spsc_push(&input.events, &event);
+}
+
+
+/*
+ * Scan once and queue whatever changed
+ * Only a fresh key scan counts towards debouncing, and only half a scan
+ * period or more after the last one that did.  The display service's scan
+ * seen twice isn't a second sample, nor is one it made straight after
+ * another to present a frame.
+ */
+static void input_scan(int64_t now)
+{
+    int i;
+    uint8_t mask;
+    uint32_t scan;
+    uint8_t raw = read_buttons_scan(input.display, &scan);
+    int fresh = scan != input.scan &&
+                now - input.scanned_at >= INPUT_SCAN_MS * 1000LL / 2;
+
+    if (fresh) {
+        input.scan = scan;
+        input.scanned_at = now;
+    }
+    for (i=0; i<8; i++) {
+        mask = 0x80 >> i;
+        if (fresh && ((raw ^ input.stable) & mask)) {
+            if (input.count[i]++ == 0)
+                input.first_seen[i] = now;
+            if (input.count[i] >= INPUT_DEBOUNCE_SAMPLES) {
+                input.count[i] = 0;
+                input.stable ^= mask;
+                if (input.stable & mask) {
+                    input.pressed_at[i] = input.first_seen[i];
+                    input.long_sent &= ~mask;
+                    input_post(INPUT_PRESS, mask, input.first_seen[i]);
+                } else {
+                    input_post(INPUT_RELEASE, mask, input.first_seen[i]);
+                }
+                TRACE(TRACE_INPUT, input.stable, 0);
+            }
+        } else if (fresh) {
+            /* Bounced back */
+            input.count[i] = 0;
+        }
+        /* Stale scan or not, a long press is down to the time */
+        if ((input.stable & mask) && !(input.long_sent & mask) &&
+            now - input.pressed_at[i] >= INPUT_LONG_PRESS_MS * 1000LL) {
+            input.long_sent |= mask;
+            input_post(INPUT_LONG_PRESS, mask, now);
+        }
+    }
+}
+
+
+/* Nothing pressed and nothing part way through debouncing */
+static int input_quiet(void)
+{
+    int i;
+    if (input.stable)
+        return 0;
+    for (i=0; i<8; i++) {
+        if (input.count[i])
+            return 0;
+    }
+    return 1;
+}
+
+
+static void input_task(void *pvParameters)
+{
+    TickType_t wake = xTaskGetTickCount();
+    TickType_t period = INPUT_SCAN_MS / portTICK_PERIOD_MS;
+    if (period == 0)
+        period = 1;
+    for (;;) {
+        input_scan(esp_timer_get_time());
+        if (power_idle() && input_quiet()) {
+            vTaskDelay(power_idle_ticks());
+            wake = xTaskGetTickCount();
+        } else if (input.display->service) {
+            /* Take each of the service's scans as it is made */
+            display_service_wait_keys(input.display->service, power_idle_ticks());
+            wake = xTaskGetTickCount();
+        } else {
+            vTaskDelayUntil(&wake, period);
+        }
+        power_wakeup();
+    }
+}
+
+
+/*
+ * Start scanning the buttons of a display
+ */
+int input_service_start(seven_segment_ui *display, int core, UBaseType_t priority)
+{
+    memset(&input, 0, sizeof(input));
+    input.display = display;
+    if (spsc_init(&input.events, events_items, sizeof(input_event),
+                  INPUT_QUEUE_LENGTH) ||
+        spsc_init(&input.isr_events, isr_items, sizeof(input_event),
+                  INPUT_ISR_QUEUE_LENGTH)) {
+        ESP_LOGE(TAG, "Unable to create input queue");
+        return -1;
+    }
+    if (task_start(TASK_INPUT, input_task, NULL, priority, core) == NULL) {
+        ESP_LOGE(TAG, "Unable to start input service");
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * Wait up to ticks for the next event
+ * Returns 1 with the event filled in, 0 on timeout
+ */
+int input_wait(input_event *event, TickType_t ticks)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t left = ticks;
+    TickType_t waited;
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    spsc_set_consumer(&input.events, self);
+    spsc_set_consumer(&input.isr_events, self);
+    for (;;) {
+        if (spsc_pop(&input.isr_events, event) || spsc_pop(&input.events, event))
+            return 1;
+        if (ticks != portMAX_DELAY) {
+            waited = xTaskGetTickCount() - start;
+            if (waited >= ticks)
+                return 0;
+            left = ticks - waited;
+        }
+        ulTaskNotifyTake(pdTRUE, left);
+    }
+}
+
+
+/*
+ * Wait up to ticks for button events and return the buttons released
+ * Returns as soon as there is an event, after taking any others queued
+ */
+uint8_t input_wait_released(TickType_t ticks)
+{
+    input_event event;
+    uint8_t released = 0;
+    while (input_wait(&event, ticks)) {
+        if (event.type == INPUT_RELEASE) {
+            released |= event.button;
+            latency_scanned(event.button, event.timestamp);
+        }
+        ticks = 0;
+    }
+    return released;
+}
+
+
+/*
+ * Queue an event from another source, e.g. the tilt switch ISR
+ */
+void IRAM_ATTR input_post_from_isr(uint8_t type, uint8_t button, int64_t timestamp)
+{
+    input_event event = {
+        .timestamp = timestamp,
+        .type = type,
+        .button = button,
+        .buttons = input.stable,
+    };
+    if (input.isr_events.items == NULL)
+        return;
+    spsc_push_from_isr(&input.isr_events, &event);
+}
+
+
+/*
+ * Forget any queued events, e.g. presses made while a game was ending
+ * Only from the task that calls input_wait().
+ */
+void input_flush(void)
+{
+    spsc_flush(&input.events);
+    spsc_flush(&input.isr_events);
+}
+
+
+unsigned long input_dropped(void)
+{
+    return input.events.dropped + input.isr_events.dropped;
+}
@@ -0,0 +1,65 @@
+#ifndef INPUT_SERVICE_H
+#define INPUT_SERVICE_H
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "7_seg_ui.h"
+
+/*
+ * Input service
+ * A task scans the buttons every INPUT_SCAN_MS, debounces each one and
+ * queues timestamped press, release and long press events.  Consumers
+ * block on the queue instead of polling the buttons themselves.  There is
+ * one consumer, the game: the queue is a ring with the input task as its
+ * only producer, see spsc.h.
+ *
+ * With the display service running it owns the bus, and this task takes
+ * each of its key scans as it is made instead of scanning every
+ * INPUT_SCAN_MS.  Only fresh scans count as samples to debounce with.
+ *
+ * While the power manager says we are idle and nothing is pressed the scan
+ * slows to POWER_IDLE_PERIOD_MS, the first press brings it back up.
+ */
+#ifndef INPUT_SCAN_MS
+#define INPUT_SCAN_MS 10
+#endif
+/* Consecutive scans a button must differ for before it changes state */
+#ifndef INPUT_DEBOUNCE_SAMPLES
+#define INPUT_DEBOUNCE_SAMPLES 2
+#endif
+#ifndef INPUT_LONG_PRESS_MS
+#define INPUT_LONG_PRESS_MS 1000
+#endif
+/* Powers of 2 */
+#ifndef INPUT_QUEUE_LENGTH
+#define INPUT_QUEUE_LENGTH 16
+#endif
+#ifndef INPUT_ISR_QUEUE_LENGTH
+#define INPUT_ISR_QUEUE_LENGTH 4
+#endif
+
+typedef enum {
+    INPUT_PRESS,
+    INPUT_RELEASE,
+    INPUT_LONG_PRESS,
+    INPUT_TILT              /* The tilt switch moved, see tilt.h */
+} input_event_type;
+
+typedef struct {
+    int64_t timestamp;      /* esp_timer_get_time() of the first scan that saw the change */
+    uint8_t type;           /* input_event_type */
+    uint8_t button;         /* The button, as read_buttons() reports it: S1 0x80 .. S8 0x01 */
+    uint8_t buttons;        /* All debounced buttons after the event */
+} input_event;
+
+extern int input_service_start(seven_segment_ui *display, int core,
+                               UBaseType_t priority);
+extern int input_wait(input_event *event, TickType_t ticks);
+extern uint8_t input_wait_released(TickType_t ticks);
+extern void input_flush(void);
+extern void input_post_from_isr(uint8_t type, uint8_t button, int64_t timestamp);
+extern unsigned long input_dropped(void);
+
+#endif
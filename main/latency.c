@@ -0,0 +1,184 @@
+#include "freertos/FreeRTOS.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_timer.h"
+
+#include "latency.h"
+
+/* Where each button's latest release has got to */
+typedef enum {
+    LATENCY_IDLE,
+    LATENCY_SCANNED,
+    LATENCY_CHANGED,
+    LATENCY_PUBLISHED,
+    LATENCY_PRESENTING
+} latency_state;
+
+static struct {
+    uint8_t state[LATENCY_BUTTONS];
+    int64_t scanned[LATENCY_BUTTONS];
+    int64_t changed[LATENCY_BUTTONS];
+    /* Bit per button published or presenting, for the display's fast path */
+    uint32_t pending;
+    latency_stats stats[LATENCY_BUTTONS];
+} latency;
+
+static portMUX_TYPE latency_mux = portMUX_INITIALIZER_UNLOCKED;
+
+
+/* S1, 0x80 as read_buttons() has it, is button 0 */
+static int button_index(int bit)
+{
+    return LATENCY_BUTTONS - 1 - bit;
+}
+
+
+void latency_scanned(uint8_t buttons, int64_t timestamp)
+{
+    int b;
+    portENTER_CRITICAL(&latency_mux);
+    for (b=0; b<LATENCY_BUTTONS; b++) {
+        if (buttons & (1 << b)) {
+            latency.state[button_index(b)] = LATENCY_SCANNED;
+            latency.scanned[button_index(b)] = timestamp;
+            latency.pending &= ~(1 << b);
+        }
+    }
+    portEXIT_CRITICAL(&latency_mux);
+}
+
+
+void latency_changed(uint8_t buttons)
+{
+    int64_t now = esp_timer_get_time();
+    int b;
+    portENTER_CRITICAL(&latency_mux);
+    for (b=0; b<LATENCY_BUTTONS; b++) {
+        if ((buttons & (1 << b)) && latency.state[button_index(b)] == LATENCY_SCANNED) {
+            latency.state[button_index(b)] = LATENCY_CHANGED;
+            latency.changed[button_index(b)] = now;
+        }
+    }
+    portEXIT_CRITICAL(&latency_mux);
+}
+
+
+/* Move every button in state from to state to */
+static void latency_advance(uint8_t from, uint8_t to)
+{
+    int b;
+    for (b=0; b<LATENCY_BUTTONS; b++) {
+        if (latency.state[button_index(b)] == from) {
+            latency.state[button_index(b)] = to;
+            latency.pending |= 1 << b;
+        }
+    }
+}
+
+
+void latency_published(void)
+{
+    portENTER_CRITICAL(&latency_mux);
+    latency_advance(LATENCY_CHANGED, LATENCY_PUBLISHED);
+    portEXIT_CRITICAL(&latency_mux);
+}
+
+
+void IRAM_ATTR latency_presenting(void)
+{
+    if (__atomic_load_n(&latency.pending, __ATOMIC_ACQUIRE) == 0)
+        return;
+    portENTER_CRITICAL(&latency_mux);
+    latency_advance(LATENCY_PUBLISHED, LATENCY_PRESENTING);
+    portEXIT_CRITICAL(&latency_mux);
+}
+
+
+static void latency_add(latency_stats *stats, uint32_t us, uint32_t changed_us)
+{
+    uint32_t bucket = us / 1000 / LATENCY_BUCKET_MS;
+    if (stats->count == 0 || us < stats->min_us)
+        stats->min_us = us;
+    if (us > stats->max_us)
+        stats->max_us = us;
+    stats->count++;
+    stats->total_us += us;
+    stats->changed_us += changed_us;
+    if (us > LATENCY_TARGET_MS * 1000)
+        stats->over++;
+    stats->buckets[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1]++;
+}
+
+
+void IRAM_ATTR latency_presented(void)
+{
+    int64_t now;
+    int b, i;
+
+    if (__atomic_load_n(&latency.pending, __ATOMIC_ACQUIRE) == 0)
+        return;
+    now = esp_timer_get_time();
+    portENTER_CRITICAL(&latency_mux);
+    for (b=0; b<LATENCY_BUTTONS; b++) {
+        i = button_index(b);
+        if (latency.state[i] != LATENCY_PRESENTING)
+            continue;
+        latency_add(&latency.stats[i], now - latency.scanned[i],
+                    latency.changed[i] - latency.scanned[i]);
+        latency.state[i] = LATENCY_IDLE;
+        latency.pending &= ~(1 << b);
+    }
+    portEXIT_CRITICAL(&latency_mux);
+}
+
+
+void latency_get_stats(int button, latency_stats *stats)
+{
+    portENTER_CRITICAL(&latency_mux);
+    *stats = latency.stats[button];
+    portEXIT_CRITICAL(&latency_mux);
+}
+
+
+void latency_reset(void)
+{
+    portENTER_CRITICAL(&latency_mux);
+    memset(latency.stats, 0, sizeof(latency.stats));
+    portEXIT_CRITICAL(&latency_mux);
+}
+
+
+/*
+ * Print each button pressed so far, then its non-empty buckets
+ */
+void latency_print(void)
+{
+    latency_stats stats;
+    char line[16 * LATENCY_BUCKETS];
+    int button, b, n;
+
+    printf("Press to display, ms, target %d:\n", LATENCY_TARGET_MS);
+    printf("  button  count    min   mean    max  to game  over\n");
+    for (button=0; button<LATENCY_BUTTONS; button++) {
+        latency_get_stats(button, &stats);
+        if (stats.count == 0)
+            continue;
+        printf("  S%d     %6u %6.1f %6.1f %6.1f %8.1f %5u\n", button + 1,
+               (unsigned) stats.count, stats.min_us / 1e3,
+               stats.total_us / 1e3 / stats.count, stats.max_us / 1e3,
+               stats.changed_us / 1e3 / stats.count, (unsigned) stats.over);
+        n = 0;
+        line[0] = '\0';
+        for (b=0; b<LATENCY_BUCKETS; b++) {
+            if (stats.buckets[b])
+                n += snprintf(line + n, sizeof(line) - n, " %d%s:%u",
+                              b * LATENCY_BUCKET_MS, b == LATENCY_BUCKETS - 1 ? "+" : "",
+                              (unsigned) stats.buckets[b]);
+        }
+        printf("        %s\n", line);
+    }
+}
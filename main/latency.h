@@ -0,0 +1,50 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+/*
+ * Press to display latency
+ * Follows each button from the scan that first saw it let go, through the
+ * game acting on it, to the end of the bus transfer that shows the result,
+ * and keeps a histogram per button.  The marks along the way:
+ *   latency_scanned()     input_wait_released() hands the game a release,
+ *                         with the input event's timestamp
+ *   latency_changed()     the game has acted on those buttons
+ *   latency_published()   update_display() after the change
+ *   latency_presenting()  a frame at least that new is taken for the bus
+ *   latency_presented()   ... and display_present() has sent it
+ * The game and display can be on different cores, the marks are safe for
+ * that.  A button the game didn't act on is forgotten at its next release.
+ *
+ * LATENCY_TARGET_MS is what we hold ourselves to, the host sim's latency
+ * mode fails a game with any press slower than that.
+ */
+#ifndef LATENCY_TARGET_MS
+#define LATENCY_TARGET_MS 20
+#endif
+/* Bucket b counts b * LATENCY_BUCKET_MS up to the next, the last any more */
+#define LATENCY_BUCKET_MS 2
+#define LATENCY_BUCKETS 20
+#define LATENCY_BUTTONS 8
+
+typedef struct {
+    uint32_t count;
+    uint32_t over;              /* Slower than LATENCY_TARGET_MS */
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint64_t changed_us;        /* Of total, scan to the game acting */
+    uint32_t buckets[LATENCY_BUCKETS];
+} latency_stats;
+
+extern void latency_scanned(uint8_t buttons, int64_t timestamp);
+extern void latency_changed(uint8_t buttons);
+extern void latency_published(void);
+extern void latency_presenting(void);
+extern void latency_presented(void);
+extern void latency_get_stats(int button, latency_stats *stats);
+extern void latency_reset(void);
+extern void latency_print(void);
+
+#endif
@@ -12,252 +12,194 @@
 #include "freertos/task.h"
 #include "esp_system.h"
 #include "esp_spi_flash.h"
-//#include "driver/gpio.h"
+#include "driver/gpio.h"
 #include "esp_log.h"
 
 #include "esp_useful.h"
 #include "7_seg_ui.h"
 #include "sound.h"
+#include "bus_bench.h"
+#include "display_service.h"
+#include "input_service.h"
+#include "tilt.h"
+#include "power.h"
+#include "deadline.h"
+#include "animation.h"
+#include "trace.h"
+#include "profile.h"
+#include "console.h"
+#include "mastermind.h"
+#include "session.h"
+#include "stats_log.h"
+#include "display_mirror.h"
+#include "wifi.h"
+#include "tasks.h"
+#include "boot.h"
+#include "game.h"
+#include "executor.h"
 
 /* Control how the program operates */
-#define DEBUG 1
-#define ALARM 1
-#define TICK 1
+/* Show every segment from as soon as the display is up until ready */
+#define SPLASH 1
 #define TILT 1
 #define TILT_ARM_DELAY 30000
-
-/* On average it will miss a tick every... */
-#define MISS_TICK 6000
+#define LED_FLASH_MS 15000
+#define BUS_BENCH 0
+#define SOLVER_BENCH 0
+/* Hold S7 and let go for the game to play itself */
+#define ATTRACT 1
+#define ATTRACT_GUESS_MS 1500
+/*
+ * Refresh the display from its own task, off the game loop
+ * Input scanning and the game share core 0, display refresh and sound get
+ * core 1 to themselves.  Input reaches the game, and the game's notes the
+ * sound task, through single producer rings (spsc.h), and frames go to
+ * the display through its triple buffer, so no task waits on another's
+ * lock.  Compare layouts with the host sim's cores mode.
+ */
+#define DISPLAY_SERVICE 1
+#define DISPLAY_CORE 1
+#define DISPLAY_PERIOD_MS 20
+#define INPUT_CORE 0
+#define SOUND_CORE 1
+/* Low priority, as it only writes flash between games, see stats_log.h */
+#define STATS_CORE 0
+/*
+ * Stream the display to WebSocket viewers over WiFi, see display_mirror.h
+ * Off by default, the radio costs power and needs WIFI_SSID set.  Also
+ * needs DISPLAY_MIRROR_ENABLE, see tasks.h, for the mirror to be built.
+ */
+#define MIRROR 0
+#define MIRROR_CORE 0
+#if MIRROR && !DISPLAY_MIRROR_ENABLE
+#error "MIRROR needs DISPLAY_MIRROR_ENABLE set in tasks.h"
+#endif
+/* Single letter commands on the serial port to dump stats, see console.h */
+#define CONSOLE 1
+#define CONSOLE_CORE 0
+/* Scale the CPU clock down and light sleep between events when idle */
+#define POWER_SAVE 1
+#define POWER_LIGHT_SLEEP 1
+#define POWER_STATS_MS 600000
 
 static const char *TAG = "scary";
 
 seven_segment_ui *display;
+/* The game on the board, see game.h, and what runs it */
+game_session board_game;
+static executor games;
 
-enum gamestate {
-    STARTED,
-    GUESSING,
-    CORRECT,
-    TIMEUP,
-    RESETTING,
-    GAMEOVER
-} state;
-
-const int strobe_pin = 12;
-const int clock_pin = 14;
-const int data_pin = 27;
+const int strobe_pin = SEVEN_SEG_STROBE_PIN;
+const int clock_pin = SEVEN_SEG_CLOCK_PIN;
+const int data_pin = SEVEN_SEG_DATA_PIN;
 const int beep_pin = 19;
 const int beep_gnd = 22;
 const int tilt_pin = 18;
 const int tilt_gnd = 23;
 
-uint8_t secret[4] = {0,0,0,0}; // Array to hold the secret code digits
-uint8_t code[4] = {0,0,0,0}; // Array to hold the guess digits
-
+/* The buzzer pins belong to the sound task, see sound_start() */
 void gpio_setup() {
-    gpio_pad_select_gpio(beep_pin);
-    gpio_pad_select_gpio(beep_gnd);
     gpio_pad_select_gpio(tilt_pin);
     gpio_pad_select_gpio(tilt_gnd);
-    gpio_set_direction(beep_pin, GPIO_MODE_OUTPUT);
-    gpio_set_direction(beep_gnd, GPIO_MODE_OUTPUT);
     gpio_set_direction(tilt_pin, GPIO_MODE_INPUT);
     gpio_set_direction(tilt_gnd, GPIO_MODE_OUTPUT);
-    gpio_set_level(beep_pin, 1);
-    gpio_set_level(beep_gnd, 1);
     gpio_set_level(tilt_gnd, 0);
     //gpio_pullup_enable(tilt_pin);
     gpio_set_pull_mode(tilt_pin, GPIO_PULLUP_ONLY);
 }
-void beep(int ticks) {
-    gpio_set_level(beep_gnd, 0);
-    vTaskDelay(ticks);
-    gpio_set_level(beep_gnd, 1);
-}
-
-void tick() {
-    #if TICK
-    if (esp_random() % MISS_TICK)
-        beep(1);
-    #endif
-}
 
-void alarm(int ticks) {
-    #if ALARM
-    beep(ticks);
-    #endif
+/*
+ * Play a game on the board, until it's over
+ */
+void game1(unsigned int count_from)
+{
+    game_start(&board_game, display, count_from, GAME_BOARD);
+    executor_init(&games);
+    /* Woken by the input service's ring, which it takes buttons from */
+    executor_add(&games, &board_game.job, game_step, 1);
+    executor_run(&games);
+    ESP_LOGI(TAG, "Game 1 ended!");
 }
 
-void endgame(seven_segment_ui *display) {
+/*
+ * Attract mode: the game playing itself, as a job on the games executor
+ * A guess every ATTRACT_GUESS_MS until a button is released.  The solver
+ * only sees what game_check() says, as a player would.  Each time it wins
+ * there is a pause and then a new secret.
+ */
+typedef struct {
+    executor_job job;           /* First, for attract_step() to get back here */
+    solver demo;
+    uint8_t secret[4];
+    int solved;
+    deadline_timer next_guess;
+} attract_session;
+
+static attract_session attract_mode;
+
+static void attract_new_secret(attract_session *attract)
+{
     int i;
-    uint8_t leds = 0xff;
-    gpio_set_level(beep_gnd, 0);
-    for (i=0; i<8; i++) {
-        display_leds(display, leds);
-        update_display(display);
-        leds >>= 1;
-        vTaskDelay(10*(8-i));
-    }
-    gpio_set_level(beep_gnd, 1);
+    for (i=0; i<4; i++)
+        attract->secret[i] = esp_random() % 10;
+    solver_start(&attract->demo, MASTERMIND_POSITIONS);
+    attract->solved = 0;
 }
 
-uint8_t manage_buttons(seven_segment_ui *display)
+/* Executor step: think a slice, guess when it's time, stop on a button */
+static int64_t attract_step(executor_job *job, int64_t now)
 {
-    /* Keep state a cross calls */
-    static uint8_t last_buttons;
-
-    /* Read the current state of the buttons */
-    ESP_LOGV(TAG, "Reading buttons");
-    uint8_t buttons = read_buttons(display);
-    /* Work out which buttons have changed */
-    uint8_t changes = buttons ^ last_buttons;
-    /* Work out which buttons have been released */
-    uint8_t released = ~buttons & changes;
+    attract_session *attract = (attract_session *) job;
+    uint8_t code[4];
+    int thinking;
 
-    /* Have the button states changed? */
-    if (changes) {
-        /* They have so update state and notify */
-        last_buttons = buttons;
-        ESP_LOGD(TAG, "Buttons: 0x%02X   Released: 0x%02X", buttons, released);
+    if (input_wait_released(0)) {
+        display->flash = 0xf0;
+        display_blank(display);
+        update_display(display);
+        input_flush();
+        power_unlock(POWER_GAME);
+        ESP_LOGI(TAG, "Attract mode ended");
+        return EXECUTOR_DONE;
     }
-    /* Return the released buttons */
-    return released;
-}
-
-uint8_t check_code() {
-    int i;
-    /* Assume all bits unmatched - 1=NOMATCH */
-    uint8_t flash=0xf0;
-    for (i=0; i<4; i++) {
-        /* Check each digit of the code */
-        if (code[i] == secret[i]) 
-            /* Clear the bit if we match */
-            flash &= ~(0x80 >> i);
+    thinking = game_think(&attract->demo);
+    now = deadline_now();
+    if (!thinking && deadline_expired(&attract->next_guess, now)) {
+        if (attract->solved || attract->demo.state == SOLVER_STUCK)
+            attract_new_secret(attract);
+        code_unpack(solver_guess(&attract->demo), code);
+        display->flash = game_check(code, attract->secret);
+        solver_response(&attract->demo, code_pack(code), game_response(display->flash));
+        display_code(display, code);
+        update_display(display);
+        if (display->flash == 0x00) {
+            attract->solved = 1;
+            animation_play(display, &animation_flash);
+            ESP_LOGI(TAG, "Solved in %d", attract->demo.responses);
+        }
     }
-    ESP_LOGD(TAG, "Check Code: %02x", flash);
-    return flash;
+    if (thinking)
+        return EXECUTOR_NEXT_TICK(now);
+    return now + deadline_remaining(&attract->next_guess, now);
 }
 
-void game1(unsigned int count_from)
+/*
+ * Play attract mode until a button is released
+ */
+void attract()
 {
-    int i=0;
-    uint8_t buttons_released = 0;
-
-    int countdown = -1;
-    clock_t second_timer = clock();
-    clock_t refresh = second_timer;
-    unsigned long reset_now=0;
-    state = RESETTING;
-    while (state != GAMEOVER) {
-        /* Manage states */
-        switch (state) {
-            case STARTED:
-                display_code(display, NULL);
-                if (countdown == 0) {
-                    state = TIMEUP;
-                    ESP_LOGD(TAG, "State: TIMEUP");
-                } else if (buttons_released) {
-                    state = GUESSING;
-                    ESP_LOGD(TAG, "State: GUESSING");
-                }
-                break;
-            case GUESSING:
-                if (countdown == 0) {
-                    state = TIMEUP;
-                    ESP_LOGD(TAG, "State: TIMEUP");
-                } else {
-                    /* Update the guessed code */
-                    if (buttons_released & 0x80) {
-                        code[0] = (code[0] +1) % 10;
-                    }
-                    if (buttons_released & 0x40) {
-                        code[1] = (code[1] +1) % 10;
-                    }
-                    if (buttons_released & 0x20) {
-                        code[2] = (code[2] +1) % 10;
-                    }
-                    if (buttons_released & 0x10) {
-                        code[3] = (code[3] +1) % 10;
-                    }
-                    #if DEBUG
-                    /* Check code button changed */
-                    if (buttons_released & 0x08) {
-                        /* End the countdown
-                         * This button will not be pushable when built... */
-                        ESP_LOGE(TAG, "Artificially ended game!");
-                        ESP_LOGD(TAG, "State: GAMEOVER");
-                        state = GAMEOVER;
-                    }  
-                    #endif
-                    if (buttons_released & 0x01) {
-                        display->flash = check_code();
-                        ESP_LOGI(TAG, "Guess %02x", display->flash);
-                        if ((display->flash & 0xf0) == 0x00) {
-                            state = CORRECT;
-                            ESP_LOGD(TAG, "State: CORRECT");
-                            reset_now = clock() + 9000;
-                        }
-                    }
-                }
-                display_code(display, code);
-                break;
-            case CORRECT:
-                display->flash = 0x0f;
-                display_code(display, code);
-                if (clock() > reset_now) {
-                    state = GAMEOVER;
-                    ESP_LOGD(TAG, "State: RESETTING");
-                }
-                break;
-            case TIMEUP:
-                state = GAMEOVER;
-                ESP_LOGD(TAG, "State: GAMEOVER");
-                endgame(display);
-                break;
-            case RESETTING:
-                state = STARTED;
-                ESP_LOGD(TAG, "State: STARTED");
-                display->flash = 0xf0;
-                countdown = count_from;
-                for (i=0; i<4; i++) {
-                    secret[i] = esp_random() % 10;
-                    code[i] = 0;
-                }
-                display_blank(display);
-                break;
-            case GAMEOVER:
-                break;
-            default:
-                ESP_LOGE(TAG, "Unhandled state in Game 1");
-        }
-
-        /* We have dealt with any released buttons now so reset */
-        buttons_released = 0;
-
-        /* Manage timed events */
-        if (clock() > second_timer) {
-            second_timer += 1000;
-            if (state == STARTED || state == GUESSING) {
-                countdown--;
-                ESP_LOGD(TAG, "%d", countdown);
-                tick();
-
-            }
-        }
-
-        if (clock() > refresh) {
-            refresh += 50;
-            buttons_released = manage_buttons(display);
-            display_timer(display, countdown);
-            //display_leds(display, display->flash);
-            update_display(display);
-        }
-        vTaskDelay(1);
-    }
+    power_lock(POWER_GAME);
+    ESP_LOGI(TAG, "Attract mode");
     display_blank(display);
-    update_display(display);
-    ESP_LOGI(TAG, "Game 1 ended!");
+    attract_new_secret(&attract_mode);
+    deadline_start(&attract_mode.next_guess, deadline_now(), 0,
+                   DEADLINE_MS(ATTRACT_GUESS_MS));
+    executor_init(&games);
+    /* Woken by the input service's ring, to stop on a button */
+    executor_add(&games, &attract_mode.job, attract_step, 1);
+    executor_run(&games);
 }
-    
+
 void binary_task(void *pvParameters)
 {
     const int led_pin = 22;
@@ -268,13 +210,13 @@ void binary_task(void *pvParameters)
     gpio_set_level(led_pin, 0);
 
     unsigned long counter = 0;
-    clock_t refresh = clock() + 1000;
+    deadline_timer refresh;
+    deadline_start(&refresh, deadline_now(), DEADLINE_MS(1000), DEADLINE_MS(1000));
 
     ESP_LOGD(TAG, "Starting...");
-    seven_segment_ui *display = display_setup(strobe_pin, clock_pin, data_pin, 0x01);
+    /* On the display app_main set up, there are no handles to spare */
     for (;;) {
-        if(clock() > refresh) {
-            refresh = clock() + 1000;
+        if (deadline_expired(&refresh, deadline_now())) {
             display_leds(display, (uint8_t)(++counter & 0xff));
             update_display(display);
             ESP_LOGI(TAG, "%lu", counter);
@@ -288,12 +230,9 @@ void binary_task(void *pvParameters)
 }
 
 
-void app_main()
+/* Print chip information */
+static void chip_info_print(void)
 {
-    /* Change log level for all components */
-    //esp_log_level_set("*", ESP_LOG_ERROR); 
-
-    /* Print chip information */
     esp_chip_info_t chip_info;
     esp_chip_info(&chip_info);
     printf("This is ESP32 chip with %d CPU cores, WiFi%s%s, ",
@@ -305,89 +244,155 @@ void app_main()
 
     printf("%dMB %s flash\n", spi_flash_get_chip_size() / (1024 * 1024),
             (chip_info.features & CHIP_FEATURE_EMB_FLASH) ? "embedded" : "external");
+}
+
+void app_main()
+{
+    /* Change log level for all components */
+    //esp_log_level_set("*", ESP_LOG_ERROR); 
+
+    /* Light the display first, everything else can wait, see boot.h */
+    boot_mark(BOOT_APP_MAIN);
+    task_register_main();
 
     /* initialise the display */
     display = display_setup(strobe_pin, clock_pin, data_pin, 0x01);
+    if (display == NULL) {
+        ESP_LOGE(TAG, "No display, stopping");
+        return;
+    }
+    boot_mark(BOOT_DISPLAY);
+    #if SPLASH
+    /* Every segment and LED, which doubles as a lamp test */
+    display_all(display);
+    update_display(display);
+    #endif
+    boot_mark(BOOT_FIRST_FRAME);
+    animation_start(display);
+    #if BUS_BENCH
+    bus_bench_result bench[BUS_BENCH_PATHS];
+    bus_bench(display, 1000, bench);
+    #endif
+    #if SOLVER_BENCH
+    solver_bench(1000000);
+    #endif
+    #if DISPLAY_SERVICE
+    display_service_start(display, DISPLAY_CORE, DISPLAY_PERIOD_MS, 5);
+    #endif
+    input_service_start(display, INPUT_CORE, 6);
+    boot_mark(BOOT_INPUT);
+
+    #if POWER_SAVE
+    power_setup(POWER_LIGHT_SLEEP);
+    #endif
     /* Initialise the sound and tilt sensor */
     gpio_setup();
+    sound_start(beep_pin, beep_gnd, SOUND_CORE, 4);
+    #if STATS_LOG_ENABLE
+    stats_log_start(STATS_CORE, 1);
+    #endif
+    #if MIRROR
+    wifi_start();
+    display_mirror_start(display, MIRROR_PORT, MIRROR_CORE, 1);
+    #endif
+    #if CONSOLE
+    console_start(CONSOLE_CORE, 2);
+    #endif
+    chip_info_print();
 
-    clock_t check_buttons = 0;
-    int button_ticks = 10;
-    clock_t flash_led = 0;
-    int led_ticks = 15000;
     uint8_t released_buttons;
+    uint8_t long_pressed = 0;
+    uint8_t attract_request;
+    input_event event;
+    TickType_t wait;
+    int64_t now = deadline_now();
+    deadline_timer flash_led = {0};
+    deadline_timer power_log = {0};
+    deadline_timer * const timers[] = {
+        &flash_led,
+        &power_log,
+        #if TILT
+        tilt_arm_timer(),
+        #endif
+    };
+    deadline_start(&power_log, now, DEADLINE_MS(POWER_STATS_MS),
+                   DEADLINE_MS(POWER_STATS_MS));
     #if TILT
-    clock_t tilt_arm = clock() + TILT_ARM_DELAY;
-    uint8_t tilt_armed = 0;
-    uint8_t tilt = gpio_get_level(tilt_pin);
-    uint8_t tilt_prev = tilt;
+    tilt_start(tilt_pin, TILT_ARM_DELAY);
+    #else
+    deadline_start(&flash_led, now, 0, DEADLINE_MS(LED_FLASH_MS));
     #endif
+    #if SPLASH
+    display_blank(display);
+    update_display(display);
+    #endif
+    boot_mark(BOOT_READY);
+    boot_print();
 
     /* Main loop */
     for (;;) {
-        /* Check if a button has been pushed */
-        if (clock() > check_buttons || (check_buttons - clock()) > button_ticks) {
-            check_buttons = clock() + button_ticks;
-            released_buttons = manage_buttons(display);
-            if (released_buttons) {
-                if (released_buttons & 0x02) {
-                    game1(10);
-                } else if (released_buttons & 0x01) {
-                    game1(60); 
-                } else {
-                    game1(esp_random() % (2 * released_buttons));
-                }
-                #if TILT
-                tilt_armed = 0;
-                tilt_arm = clock() + TILT_ARM_DELAY;
-                #endif
+        /* Sleep until a button or the tilt switch moves, or something is due */
+        released_buttons = 0;
+        attract_request = 0;
+        wait = deadline_ticks(timers, sizeof(timers) / sizeof(timers[0]), deadline_now());
+        while (input_wait(&event, wait)) {
+            if (event.type == INPUT_LONG_PRESS) {
+                /* Only holding S7 asks for attract mode, other buttons
+                 * start a game when let go of however long they were held */
+                long_pressed |= event.button & 0x02;
+            } else if (event.type == INPUT_RELEASE) {
+                /* Letting go of that long press isn't a press */
+                if (long_pressed & event.button)
+                    attract_request |= event.button;
+                else
+                    released_buttons |= event.button;
+                long_pressed &= ~event.button;
             }
+            wait = 0;
+        }
+        power_wakeup();
+        now = deadline_now();
+        if (deadline_expired(&power_log, now)) {
+            power_log_stats();
+            trace_dump();
+        }
+        #if ATTRACT
+        if (attract_request) {
+            attract();
             #if TILT
-            tilt = gpio_get_level(tilt_pin);
-            if (tilt_armed) {
-                /* Check the tilt switch */
-                if (tilt != tilt_prev) {
-                    /* Somebody moved us... */
-                    ESP_LOGI(TAG, "Tilted...  Starting countdown!");
-                    game1(60 + esp_random() % 60);
-                    tilt_armed = 0;
-                    tilt_arm = clock() + TILT_ARM_DELAY;
-                }
+            tilt_disarm(deadline_now());
+            #endif
+        }
+        #endif
+        if (released_buttons) {
+            if (released_buttons & 0x02) {
+                game1(10);
+            } else if (released_buttons & 0x01) {
+                game1(60); 
             } else {
-                if (tilt != tilt_prev) {
-                    /* We are not yet armed and are being moved */
-                    /* Reset the arming delay */
-                    ESP_LOGI(TAG, "Delaying tilt arming due to movement");
-                    tilt_prev = tilt;
-                    tilt_arm = clock() + TILT_ARM_DELAY;
-                }
-                if (clock() > tilt_arm) {
-                    ESP_LOGI(TAG, "Tilt mechanism armed...");
-                    /* We should arm the tilt mechanism */
-                    tilt_prev = gpio_get_level(tilt_pin);
-                    tilt_armed = 1;
-                } 
+                game1(esp_random() % (2 * released_buttons));
             }
+            #if TILT
+            tilt_disarm(deadline_now());
             #endif
         }
-        /* Flash the LED */
         #if TILT
-        if (tilt_armed) {
-        #endif
-
-        if (clock() > flash_led || (flash_led - clock()) > led_ticks) {
-            flash_led = clock() + led_ticks;
-            display_leds(display, 0x01);
-            update_display(display);
-            vTaskDelay(5);
-            display_leds(display, 0x00);
-            update_display(display);
+        if (tilt_update(deadline_now())) {
+            /* Somebody moved us... */
+            game1(60 + esp_random() % 60);
+            tilt_disarm(deadline_now());
         }
-
-        #if TILT
+        /* Only flash the LED while armed, starting as soon as we are */
+        if (tilt_armed() != flash_led.armed) {
+            if (tilt_armed())
+                deadline_start(&flash_led, deadline_now(), 0, DEADLINE_MS(LED_FLASH_MS));
+            else
+                deadline_stop(&flash_led);
         }
         #endif
-        /* Yield */
-        vTaskDelay(5);
+
+        /* Flash the LED */
+        if (deadline_expired(&flash_led, deadline_now()))
+            animation_play(display, &animation_blink);
     }
 }
\ No newline at end of file
@@ -0,0 +1,339 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "mastermind.h"
+
+static const char *TAG = "mastermind";
+
+/* Responses that can happen, 3 exact and 1 misplaced can't */
+#define COUNTS_RESPONSES 14
+#define POSITIONS_RESPONSES 16
+
+#if SOLVER_FULL_SEARCH > SOLVER_LIST_SIZE || SOLVER_LIST_SIZE < 2
+#error "A full search needs the candidates listed"
+#endif
+
+uint16_t code_pack(const uint8_t *digits)
+{
+    return (uint16_t) (digits[0] << 12 | digits[1] << 8 | digits[2] << 4 | digits[3]);
+}
+
+void code_unpack(uint16_t code, uint8_t *digits)
+{
+    digits[0] = code >> 12;
+    digits[1] = (code >> 8) & 0x0f;
+    digits[2] = (code >> 4) & 0x0f;
+    digits[3] = code & 0x0f;
+}
+
+uint8_t code_score(mastermind_rules rules, uint16_t guess, uint16_t secret)
+{
+    if (rules == MASTERMIND_COUNTS)
+        return code_score_counts(guess, code_histogram(guess), secret);
+    return code_score_positions(guess, 0, secret);
+}
+
+/* The code after this one counting in decimal, 0999 then 1000 */
+static inline uint16_t code_next(uint16_t code)
+{
+    code++;
+    if ((code & 0x000f) == 0x000a)
+        code += 0x0006;
+    if ((code & 0x00f0) == 0x00a0)
+        code += 0x0060;
+    if ((code & 0x0f00) == 0x0a00)
+        code += 0x0600;
+    return code;
+}
+
+static inline uint8_t score(const solver *s, uint16_t guess, uint64_t histogram,
+                            uint16_t secret)
+{
+    if (s->rules == MASTERMIND_COUNTS)
+        return code_score_counts(guess, histogram, secret);
+    return code_score_positions(guess, histogram, secret);
+}
+
+static inline int in_bitmap(const solver *s, uint16_t index)
+{
+    return s->candidates[index >> 3] & (1 << (index & 7));
+}
+
+static void ready(solver *s)
+{
+    s->state = SOLVER_READY;
+    ESP_LOGD(TAG, "Guess %04x leaves at most %d of %d, %lu codes looked at",
+             s->best, s->best_worst, s->remaining, s->work);
+}
+
+static void begin_search(solver *s)
+{
+    s->state = SOLVER_SEARCHING;
+    if (s->remaining == 0) {
+        s->state = SOLVER_STUCK;
+        ESP_LOGW(TAG, "No code fits the %d responses", s->responses);
+        return;
+    }
+    if (s->remaining <= 2) {
+        /* Guessing either can't do worse than splitting them */
+        s->best = s->list[0];
+        s->best_worst = s->remaining - 1;
+        ready(s);
+        return;
+    }
+    s->full = s->remaining <= SOLVER_FULL_SEARCH;
+    s->guesses = 0;
+    s->index = 0;
+    s->code = s->full || !s->from_list ? 0 : s->list[0];
+    s->list_pos = 0;
+    s->scoring = 0;
+    s->best_worst = 0xffff;
+    s->best_is_candidate = 0;
+}
+
+/* Move on to the next code that might be the guess */
+static void next_guess(solver *s)
+{
+    s->scoring = 0;
+    s->index++;
+    if (s->full || !s->from_list)
+        s->code = code_next(s->code);
+    else if (s->index < s->listed)
+        s->code = s->list[s->index];
+}
+
+static void begin_guess(solver *s)
+{
+    s->scoring = 1;
+    s->guesses++;
+    s->histogram = code_histogram(s->code);
+    memset(s->partition, 0, sizeof(s->partition));
+    s->worst = 0;
+    s->candidate_index = 0;
+    s->candidate = s->from_list ? s->list[0] : 0;
+    if (s->full) {
+        /* Both go up in order, so keep the list position alongside */
+        while (s->list_pos < s->listed && s->list[s->list_pos] < s->code)
+            s->list_pos++;
+        s->is_candidate = s->list_pos < s->listed && s->list[s->list_pos] == s->code;
+    } else {
+        s->is_candidate = 1;
+    }
+}
+
+static void end_guess(solver *s, int complete)
+{
+    int possible = s->rules == MASTERMIND_COUNTS ? COUNTS_RESPONSES : POSITIONS_RESPONSES;
+
+    if (complete) {
+        s->best = s->code;
+        s->best_worst = s->worst;
+        s->best_is_candidate = s->is_candidate;
+    }
+    next_guess(s);
+    /* Nothing can split the candidates more evenly than this */
+    if (s->best_is_candidate && s->best_worst <= (s->remaining + possible - 1) / possible)
+        ready(s);
+}
+
+/* Look at one code, is it a guess to try? */
+static void seek_guess(solver *s)
+{
+    if (s->full) {
+        if (s->index == MASTERMIND_CODES)
+            ready(s);
+        else
+            begin_guess(s);
+    } else if (s->guesses == SOLVER_MAX_GUESSES) {
+        ready(s);
+    } else if (s->from_list) {
+        if (s->index == s->listed)
+            ready(s);
+        else
+            begin_guess(s);
+    } else if (s->index == MASTERMIND_CODES) {
+        ready(s);
+    } else if (in_bitmap(s, s->index)) {
+        begin_guess(s);
+    } else {
+        next_guess(s);
+    }
+}
+
+/* Look at one code, score it against the guess if it is a candidate */
+static void score_candidate(solver *s)
+{
+    int candidate;
+    uint16_t count;
+
+    if (s->from_list) {
+        if (s->candidate_index == s->listed) {
+            end_guess(s, 1);
+            return;
+        }
+        s->candidate = s->list[s->candidate_index];
+        candidate = 1;
+    } else {
+        if (s->candidate_index == MASTERMIND_CODES) {
+            end_guess(s, 1);
+            return;
+        }
+        candidate = in_bitmap(s, s->candidate_index);
+    }
+    if (candidate) {
+        count = ++s->partition[score(s, s->code, s->histogram, s->candidate)];
+        if (count > s->worst) {
+            s->worst = count;
+            /* Give up as soon as it can't beat the best so far */
+            if (count > s->best_worst ||
+                (count == s->best_worst && (s->best_is_candidate || !s->is_candidate))) {
+                end_guess(s, 0);
+                return;
+            }
+        }
+    }
+    s->candidate_index++;
+    if (!s->from_list)
+        s->candidate = code_next(s->candidate);
+}
+
+/* Look at one code, does it still fit? */
+static void filter_candidate(solver *s)
+{
+    uint16_t code;
+
+    if (s->from_list) {
+        code = s->list[s->candidate_index++];
+        if (score(s, s->last_guess, s->histogram, code) == s->last_response)
+            s->list[s->list_pos++] = code;
+        else
+            s->remaining--;
+        if (s->candidate_index == s->listed) {
+            s->listed = s->list_pos;
+            begin_search(s);
+        }
+        return;
+    }
+    code = s->candidate;
+    if (in_bitmap(s, s->candidate_index)) {
+        if (score(s, s->last_guess, s->histogram, code) != s->last_response) {
+            s->candidates[s->candidate_index >> 3] &= ~(1 << (s->candidate_index & 7));
+            s->remaining--;
+        } else if (s->listed < SOLVER_LIST_SIZE) {
+            s->list[s->listed++] = code;
+        }
+    }
+    s->candidate_index++;
+    s->candidate = code_next(code);
+    if (s->candidate_index == MASTERMIND_CODES) {
+        s->from_list = s->remaining <= SOLVER_LIST_SIZE;
+        begin_search(s);
+    }
+}
+
+/*
+ * Start solving with every code a candidate.  The first guess is ready
+ * straight away, it is always the opening.
+ */
+void solver_start(solver *s, mastermind_rules rules)
+{
+    s->rules = rules;
+    memset(s->candidates, 0xff, sizeof(s->candidates));
+    s->listed = 0;
+    s->from_list = 0;
+    s->remaining = MASTERMIND_CODES;
+    s->responses = 0;
+    s->best = MASTERMIND_OPENING;
+    s->best_worst = MASTERMIND_CODES;
+    s->work = 0;
+    s->state = SOLVER_READY;
+}
+
+/*
+ * Tell the solver how a guess scored, with code_score() and the rules it
+ * was started with.  Only the remaining candidates that give the same
+ * response are kept, which takes solver_step()s.  Any filtering still to
+ * do for the last response is finished first, here and now.
+ */
+void solver_response(solver *s, uint16_t guess, uint8_t response)
+{
+    while (s->state == SOLVER_FILTERING)
+        solver_step(s, MASTERMIND_CODES);
+    if (s->state == SOLVER_STUCK)
+        return;
+    s->responses++;
+    s->last_guess = guess;
+    s->last_response = response;
+    s->histogram = code_histogram(guess);
+    s->candidate_index = 0;
+    s->candidate = 0;
+    if (s->from_list)
+        s->list_pos = 0;
+    else
+        s->listed = 0;
+    s->state = SOLVER_FILTERING;
+}
+
+/*
+ * Carry on filtering or searching, looking at no more than budget codes.
+ * Each one is at most a score and a few compares, so this bounds the
+ * time taken.  Returns SOLVER_READY once solver_guess() has the answer.
+ */
+solver_state solver_step(solver *s, unsigned long budget)
+{
+    while (budget && (s->state == SOLVER_FILTERING || s->state == SOLVER_SEARCHING)) {
+        budget--;
+        s->work++;
+        if (s->state == SOLVER_FILTERING)
+            filter_candidate(s);
+        else if (s->scoring)
+            score_candidate(s);
+        else
+            seek_guess(s);
+    }
+    return s->state;
+}
+
+/* The next guess to make, once solver_step() says it is ready */
+uint16_t solver_guess(const solver *s)
+{
+    return s->best;
+}
+
+/*
+ * Time scoring count codes against the opening, both ways.
+ * Returns codes scored per second under the Mastermind rules.
+ */
+unsigned long solver_bench(unsigned long count)
+{
+    unsigned long i;
+    unsigned long rates[2];
+    unsigned int total = 0;
+    int64_t start;
+    uint16_t secret;
+    const uint16_t guess = MASTERMIND_OPENING;
+    const uint64_t histogram = code_histogram(guess);
+    mastermind_rules rules;
+
+    for (rules = MASTERMIND_COUNTS; rules <= MASTERMIND_POSITIONS; rules++) {
+        secret = 0;
+        start = esp_timer_get_time();
+        for (i=0; i<count; i++) {
+            if (rules == MASTERMIND_COUNTS)
+                total += code_score_counts(guess, histogram, secret);
+            else
+                total += code_score_positions(guess, histogram, secret);
+            secret = code_next(secret);
+            if (secret == 0xa000)
+                secret = 0;
+        }
+        start = esp_timer_get_time() - start;
+        rates[rules] = start > 0 ? (unsigned long) ((uint64_t) count * 1000000 / start) : 0;
+    }
+    ESP_LOGI(TAG, "Scoring: %lu codes/s counts, %lu codes/s positions (%u)",
+             rates[MASTERMIND_COUNTS], rates[MASTERMIND_POSITIONS], total);
+    return rates[MASTERMIND_COUNTS];
+}
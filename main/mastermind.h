@@ -0,0 +1,156 @@
+#ifndef MASTERMIND_H
+#define MASTERMIND_H
+
+#include <stdint.h>
+
+/*
+ * Code scoring and a code breaking solver
+ * A 4 digit code is packed one digit per nibble, digit 0 in the top one,
+ * so 1234 is 0x1234.  Scores come from a few whole-word operations rather
+ * than a loop over the digits:
+ *   exact     - XOR, fold each nibble down to a bit, count the bits
+ *   common    - digit histograms with a nibble per digit 0-9, the per
+ *               nibble minimum of two of them, summed with one multiply
+ *   misplaced - common less exact
+ *
+ * The solver keeps the codes still consistent with every response as a
+ * bitmap and picks the next guess Knuth's way: the code whose worst case
+ * response leaves fewest candidates, preferring candidates on a tie.  It
+ * does a bounded number of scores per solver_step(), so it can run a bit
+ * at a time from a frame loop.  Before any response it plays the opening.
+ */
+#define MASTERMIND_CODES 10000
+/* Responses are exact * 5 + misplaced, or a match mask, both below this */
+#define MASTERMIND_RESPONSES 25
+#define MASTERMIND_SOLVED_COUNTS (4 * 5)
+#define MASTERMIND_SOLVED_POSITIONS 0x0f
+/* Opening guess, 0011 is good for counts and as good as any for positions */
+#ifndef MASTERMIND_OPENING
+#define MASTERMIND_OPENING 0x0011
+#endif
+/* Candidates are kept in a list as well as the bitmap once this few remain */
+#ifndef SOLVER_LIST_SIZE
+#define SOLVER_LIST_SIZE 512
+#endif
+/* Guesses are all codes once this few candidates remain, before that only
+ * the candidates, and no more than SOLVER_MAX_GUESSES of them */
+#ifndef SOLVER_FULL_SEARCH
+#define SOLVER_FULL_SEARCH 32
+#endif
+#ifndef SOLVER_MAX_GUESSES
+#define SOLVER_MAX_GUESSES 16
+#endif
+/* Codes to look at per pass of a game loop, see solver_bench() */
+#ifndef SOLVER_FRAME_CODES
+#define SOLVER_FRAME_CODES 4000
+#endif
+
+/* Digits 3..0 of a code that don't match, bit 3 for digit 0 */
+static inline uint8_t code_misses(uint16_t a, uint16_t b)
+{
+    uint32_t x = a ^ b;
+    x = (x | x >> 1 | x >> 2 | x >> 3) & 0x1111;
+    /* Gather bits 12, 8, 4, 0 into bits 3..0 */
+    return (uint8_t) ((x * 0x1248) >> 12) & 0x0f;
+}
+
+static inline int code_exact(uint16_t a, uint16_t b)
+{
+    uint32_t x = a ^ b;
+    x = (x | x >> 1 | x >> 2 | x >> 3) & 0x1111;
+    /* Sum bits 0, 4, 8 and 12 into bits 12-15 */
+    return 4 - (int) (((x * 0x1111) >> 12) & 0x0f);
+}
+
+/* A nibble per digit 0-9 counting how often it appears */
+static inline uint64_t code_histogram(uint16_t a)
+{
+    return (1ULL << (4 * (a >> 12))) + (1ULL << (4 * ((a >> 8) & 0x0f))) +
+           (1ULL << (4 * ((a >> 4) & 0x0f))) + (1ULL << (4 * (a & 0x0f)));
+}
+
+/* Digits two codes have in common, wherever they are */
+static inline int code_common(uint64_t ha, uint64_t hb)
+{
+    const uint64_t high = 0x8888888888ULL;
+    /* Each nibble is 8 + a - b, never borrowing as counts are at most 4 */
+    uint64_t ge = (((ha | high) - hb) & high) >> 3;
+    uint64_t min = (hb & ge * 0x0f) | (ha & ~(ge * 0x0f));
+    return (int) ((min * 0x1111111111ULL) >> 36) & 0x0f;
+}
+
+/* Mastermind response, exact * 5 + misplaced */
+static inline uint8_t code_score_counts(uint16_t guess, uint64_t guess_histogram,
+                                        uint16_t secret)
+{
+    int exact = code_exact(guess, secret);
+    return (uint8_t) (exact * 5 + code_common(guess_histogram, code_histogram(secret)) - exact);
+}
+
+/* This game's response, the digits in the right place, bit 3 for digit 0 */
+static inline uint8_t code_score_positions(uint16_t guess, uint64_t guess_histogram,
+                                           uint16_t secret)
+{
+    return ~code_misses(guess, secret) & 0x0f;
+}
+
+typedef enum {
+    MASTERMIND_COUNTS,          /* Exact and misplaced counts */
+    MASTERMIND_POSITIONS,       /* Which digits are right, as game_check() tells */
+} mastermind_rules;
+
+typedef enum {
+    SOLVER_FILTERING,           /* Dropping candidates the last response rules out */
+    SOLVER_SEARCHING,           /* Looking for the best next guess */
+    SOLVER_READY,               /* solver_guess() has it */
+    SOLVER_STUCK,               /* No code fits the responses */
+} solver_state;
+
+/*
+ * Candidates are a bitmap by code index, 1234 is bit 1234, until few
+ * enough remain to list as packed codes in order.  From then on the list
+ * is kept and the bitmap is stale.
+ */
+typedef struct {
+    mastermind_rules rules;
+    solver_state state;
+    uint8_t candidates[MASTERMIND_CODES / 8];
+    uint16_t list[SOLVER_LIST_SIZE];
+    uint16_t listed;
+    uint8_t from_list;          /* The list has them all */
+    uint16_t remaining;
+    uint16_t responses;         /* Given so far */
+    /* Last response, while filtering */
+    uint16_t last_guess;
+    uint8_t last_response;
+    /* Search position: guess, then candidate, as index and packed code */
+    uint8_t full;               /* Guesses are all codes, not candidates */
+    uint8_t scoring;            /* ... candidates against code */
+    uint16_t guesses;           /* Tried so far */
+    uint16_t index;
+    uint16_t code;
+    uint8_t is_candidate;       /* ... code */
+    uint16_t list_pos;          /* Next listed candidate >= code, or where
+                                   filtering writes the next one */
+    uint64_t histogram;         /* ... of code */
+    uint16_t candidate_index;
+    uint16_t candidate;
+    uint16_t partition[MASTERMIND_RESPONSES];
+    uint16_t worst;             /* ... partition of code so far */
+    /* Best guess so far */
+    uint16_t best;
+    uint16_t best_worst;
+    uint8_t best_is_candidate;
+    unsigned long work;         /* Codes looked at in total */
+} solver;
+
+extern uint16_t code_pack(const uint8_t *digits);
+extern void code_unpack(uint16_t code, uint8_t *digits);
+extern uint8_t code_score(mastermind_rules rules, uint16_t guess, uint16_t secret);
+extern void solver_start(solver *s, mastermind_rules rules);
+extern void solver_response(solver *s, uint16_t guess, uint8_t response);
+extern solver_state solver_step(solver *s, unsigned long budget);
+extern uint16_t solver_guess(const solver *s);
+extern unsigned long solver_bench(unsigned long count);
+
+#endif
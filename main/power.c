@@ -0,0 +1,223 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#endif
+
+#include "power.h"
+
+static const char *TAG = "power";
+
+static const char *state_names[POWER_STATES] = {"idle", "sound", "bus", "game"};
+#if CONFIG_PM_ENABLE
+static const esp_pm_lock_type_t lock_types[POWER_STATES] = {
+    ESP_PM_NO_LIGHT_SLEEP,      /* Not used */
+    ESP_PM_APB_FREQ_MAX,
+    ESP_PM_CPU_FREQ_MAX,
+    ESP_PM_CPU_FREQ_MAX,
+};
+#endif
+
+static struct {
+    portMUX_TYPE mux;
+    uint32_t held[POWER_STATES];
+    power_state state;          /* Highest state with a lock held */
+    int64_t since;              /* When we entered it */
+    int64_t start;
+    int64_t time[POWER_STATES];
+    TickType_t last_wakeup;
+    unsigned long wakeups;
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t locks[POWER_STATES];
+#endif
+} power = {
+    .mux = portMUX_INITIALIZER_UNLOCKED,
+};
+
+
+/* Move the accounting over to the highest state held, call in the critical section */
+static void power_account(int64_t now)
+{
+    power_state state = POWER_IDLE;
+    int i;
+    for (i=POWER_STATES-1; i>POWER_IDLE; i--) {
+        if (power.held[i]) {
+            state = i;
+            break;
+        }
+    }
+    if (state != power.state) {
+        power.time[power.state] += now - power.since;
+        power.state = state;
+        power.since = now;
+    }
+}
+
+
+/*
+ * Configure frequency scaling and, if asked, light sleep when idle
+ */
+int power_setup(int light_sleep)
+{
+#if CONFIG_PM_ENABLE
+    esp_err_t err;
+    esp_pm_lock_handle_t lock;
+    uint32_t held;
+    int i;
+    esp_pm_config_esp32_t config = {
+        .max_freq_mhz = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = POWER_MIN_FREQ_MHZ,
+        .light_sleep_enable = light_sleep,
+    };
+    for (i=POWER_IDLE+1; i<POWER_STATES; i++) {
+        err = esp_pm_lock_create(lock_types[i], 0, state_names[i], &lock);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Unable to create %s lock: %d", state_names[i], err);
+            return -1;
+        }
+        /* Locks taken before now are held again, as many times as they
+         * are held, in the same critical section as power_lock() and
+         * power_unlock() so neither can come in between */
+        portENTER_CRITICAL(&power.mux);
+        power.locks[i] = lock;
+        for (held=0; held<power.held[i]; held++)
+            esp_pm_lock_acquire(lock);
+        portEXIT_CRITICAL(&power.mux);
+    }
+    err = esp_pm_configure(&config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Unable to configure power management: %d", err);
+        return -1;
+    }
+    /* The tilt switch needs to wake us, see tilt.c */
+    if (light_sleep)
+        esp_sleep_enable_gpio_wakeup();
+    ESP_LOGI(TAG, "CPU %d-%d MHz, light sleep %s", POWER_MIN_FREQ_MHZ,
+             CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ, light_sleep ? "on" : "off");
+#else
+    ESP_LOGW(TAG, "CONFIG_PM_ENABLE is not set, only keeping statistics");
+#endif
+    portENTER_CRITICAL(&power.mux);
+    power.start = esp_timer_get_time();
+    power.since = power.start;
+    memset(power.time, 0, sizeof(power.time));
+    power.wakeups = 0;
+    portEXIT_CRITICAL(&power.mux);
+    return 0;
+}
+
+
+/*
+ * Hold the CPU at full speed, locks nest
+ * The count and the PM lock change together, so whether power_setup() has
+ * made the PM lock yet or not each hold is taken on it exactly once.
+ */
+void power_lock(power_state state)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&power.mux);
+    power.held[state]++;
+#if CONFIG_PM_ENABLE
+    if (state != POWER_IDLE && power.locks[state])
+        esp_pm_lock_acquire(power.locks[state]);
+#endif
+    power_account(now);
+    portEXIT_CRITICAL(&power.mux);
+}
+
+
+void power_unlock(power_state state)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&power.mux);
+    if (power.held[state]) {
+        power.held[state]--;
+#if CONFIG_PM_ENABLE
+        if (state != POWER_IDLE && power.locks[state])
+            esp_pm_lock_release(power.locks[state]);
+#endif
+    }
+    power_account(now);
+    portEXIT_CRITICAL(&power.mux);
+}
+
+
+/*
+ * Nothing is going on, so services can slow down
+ */
+int power_idle(void)
+{
+    return __atomic_load_n(&power.held[POWER_GAME], __ATOMIC_RELAXED) == 0;
+}
+
+
+/*
+ * Ticks to the next idle period boundary
+ * Everyone waiting for this wakes on the same tick.
+ */
+TickType_t power_idle_ticks(void)
+{
+    TickType_t period = POWER_IDLE_PERIOD_MS / portTICK_PERIOD_MS;
+    if (period == 0)
+        period = 1;
+    return period - xTaskGetTickCount() % period;
+}
+
+
+/*
+ * Count a wakeup, tasks waking on the same tick share one
+ */
+void power_wakeup(void)
+{
+    TickType_t now = xTaskGetTickCount();
+    portENTER_CRITICAL(&power.mux);
+    if (now != power.last_wakeup || power.wakeups == 0) {
+        power.last_wakeup = now;
+        power.wakeups++;
+    }
+    portEXIT_CRITICAL(&power.mux);
+}
+
+
+void power_get_stats(power_stats *stats)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&power.mux);
+    memcpy(stats->time, power.time, sizeof(stats->time));
+    stats->time[power.state] += now - power.since;
+    stats->uptime = now - power.start;
+    stats->wakeups = power.wakeups;
+    portEXIT_CRITICAL(&power.mux);
+}
+
+
+/*
+ * Log the time spent in each state and the wakeup rate
+ */
+void power_log_stats(void)
+{
+    power_stats stats;
+    int i;
+    double minutes;
+
+    power_get_stats(&stats);
+    minutes = stats.uptime / 60e6;
+    for (i=0; i<POWER_STATES; i++)
+        ESP_LOGI(TAG, "%-5s %8lld ms %5.1f%%", state_names[i], stats.time[i] / 1000,
+                 stats.uptime ? 100.0 * stats.time[i] / stats.uptime : 0.0);
+    ESP_LOGI(TAG, "%lu wakeups, %.1f / minute", stats.wakeups,
+             minutes > 0 ? stats.wakeups / minutes : 0.0);
+#if CONFIG_PM_ENABLE && CONFIG_PM_PROFILING
+    /* How long was really spent asleep and at each frequency */
+    esp_pm_dump_locks(stdout);
+#endif
+}
@@ -0,0 +1,54 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+/*
+ * Power management
+ * With CONFIG_PM_ENABLE the CPU runs at POWER_MIN_FREQ_MHZ when nothing
+ * holds a lock, and with CONFIG_FREERTOS_USE_TICKLESS_IDLE it light sleeps
+ * whenever no task is due for a few ticks.  Code that needs the full clock
+ * holds one of the locks:
+ * * POWER_SOUND while a note plays, LEDC needs a steady APB clock and
+ *   stops in light sleep
+ * * POWER_BUS around bus bursts, the bit-banged timing counts CPU cycles
+ * * POWER_GAME while a game is running
+ * The last two pin the CPU at its default frequency.
+ * Without CONFIG_PM_ENABLE the locks only keep the statistics.
+ *
+ * While idle the display and input services drop to POWER_IDLE_PERIOD_MS
+ * and wake on the same tick, so the CPU wakes once for both.
+ */
+#ifndef POWER_MIN_FREQ_MHZ
+#define POWER_MIN_FREQ_MHZ 80
+#endif
+#ifndef POWER_IDLE_PERIOD_MS
+#define POWER_IDLE_PERIOD_MS 50
+#endif
+
+typedef enum {
+    POWER_IDLE,             /* No lock held, minimum frequency or asleep */
+    POWER_SOUND,
+    POWER_BUS,
+    POWER_GAME,
+    POWER_STATES
+} power_state;
+
+typedef struct {
+    int64_t uptime;                     /* us since power_setup() */
+    int64_t time[POWER_STATES];         /* us spent with each as the highest lock */
+    unsigned long wakeups;              /* Distinct ticks a service task woke on */
+} power_stats;
+
+extern int power_setup(int light_sleep);
+extern void power_lock(power_state state);
+extern void power_unlock(power_state state);
+extern int power_idle(void);
+extern TickType_t power_idle_ticks(void);
+extern void power_wakeup(void);
+extern void power_get_stats(power_stats *stats);
+extern void power_log_stats(void);
+
+#endif
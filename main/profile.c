@@ -0,0 +1,103 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+
+#include "profile.h"
+
+static const char *TAG = "profile";
+
+#define PROFILE_SITE(id, name) name,
+static const char *names[PROFILE_SITE_COUNT] = {
+    PROFILE_SITES
+};
+#undef PROFILE_SITE
+
+static portMUX_TYPE profile_mux = portMUX_INITIALIZER_UNLOCKED;
+static profile_stats sites[PROFILE_SITE_COUNT];
+
+
+/*
+ * Count one pass through a site
+ */
+void IRAM_ATTR profile_add(profile_site site, uint32_t cycles)
+{
+    profile_stats *stats = &sites[site];
+    int bucket = cycles ? 31 - __builtin_clz(cycles) : 0;
+
+    portENTER_CRITICAL(&profile_mux);
+    if (stats->count == 0 || cycles < stats->min)
+        stats->min = cycles;
+    if (cycles > stats->max)
+        stats->max = cycles;
+    stats->count++;
+    stats->total += cycles;
+    stats->buckets[bucket]++;
+    portEXIT_CRITICAL(&profile_mux);
+}
+
+
+void profile_get_stats(profile_site site, profile_stats *stats)
+{
+    portENTER_CRITICAL(&profile_mux);
+    *stats = sites[site];
+    portEXIT_CRITICAL(&profile_mux);
+}
+
+
+const char* profile_name(profile_site site)
+{
+    return site < PROFILE_SITE_COUNT ? names[site] : "?";
+}
+
+
+void profile_reset(void)
+{
+    portENTER_CRITICAL(&profile_mux);
+    memset(sites, 0, sizeof(sites));
+    portEXIT_CRITICAL(&profile_mux);
+    ESP_LOGI(TAG, "Reset");
+}
+
+
+/*
+ * Print every site that has been hit, in cycles and in us at the
+ * default CPU frequency, then its non-empty histogram buckets
+ */
+void profile_dump(void)
+{
+    profile_stats stats;
+    char line[24 * PROFILE_BUCKETS];
+    int site, b, n;
+
+#if !PROFILE_ENABLE
+    ESP_LOGI(TAG, "Profiling not built in, see PROFILE_ENABLE");
+#endif
+    printf("%-16s %8s %9s %9s %9s  cycles, us at %d MHz\n", "site", "count",
+           "min", "mean", "max", CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
+    for (site=0; site<PROFILE_SITE_COUNT; site++) {
+        profile_get_stats(site, &stats);
+        if (stats.count == 0)
+            continue;
+        printf("%-16s %8u %9u %9u %9u  %.1f / %.1f / %.1f us\n", names[site],
+               (unsigned) stats.count, (unsigned) stats.min,
+               (unsigned) (stats.total / stats.count), (unsigned) stats.max,
+               (double) stats.min / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+               (double) stats.total / stats.count / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+               (double) stats.max / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
+        n = 0;
+        line[0] = '\0';
+        for (b=0; b<PROFILE_BUCKETS; b++) {
+            if (stats.buckets[b])
+                n += snprintf(line + n, sizeof(line) - n, " 2^%d:%u", b,
+                              (unsigned) stats.buckets[b]);
+        }
+        printf("%-16s%s\n", "", line);
+    }
+}
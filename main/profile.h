@@ -0,0 +1,75 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+/*
+ * Hot path profiling
+ * PROFILE_START()/PROFILE_END() around a piece of code count the CPU
+ * cycles it took and add them to that site's count, min, max, total and
+ * a histogram with a bucket per power of 2.  Cycles rather than time, so
+ * the CPU frequency scaling down when idle doesn't move the numbers.
+ *
+ * A scope must start and end in the same task and function, and the
+ * task must be pinned so both ends read the same core's counter.
+ * Anything that preempts the scope, or that it blocks on, is counted.
+ *
+ * PROFILE_LATE() counts how late something ran against its deadline
+ * instead, converted to cycles at the default CPU frequency so the us
+ * columns read true.  Its max - min is the jitter.
+ *
+ * With PROFILE_ENABLE 0 the scopes compile to nothing.
+ */
+#ifndef PROFILE_ENABLE
+#define PROFILE_ENABLE 1
+#endif
+/* Bucket b counts scopes of 2^b up to 2^(b+1) - 1 cycles */
+#define PROFILE_BUCKETS 32
+
+/* PROFILE_SITE(id, name) */
+#define PROFILE_SITES                                                       \
+    PROFILE_SITE(PROFILE_BB_SEND,           "bb_send")                      \
+    PROFILE_SITE(PROFILE_BB_READ_BUTTONS,   "bb_read_buttons")              \
+    PROFILE_SITE(PROFILE_DISPLAY_PRESENT,   "display_present")              \
+    PROFILE_SITE(PROFILE_UPDATE_DISPLAY,    "update_display")               \
+    PROFILE_SITE(PROFILE_DISPLAY_TIMER,     "display_timer")                \
+    PROFILE_SITE(PROFILE_GAME_LOOP,         "game1 loop")                   \
+    PROFILE_SITE(PROFILE_SOLVER_STEP,       "solver_step")                  \
+    PROFILE_SITE(PROFILE_GAME_LATENESS,     "game1 lateness")
+
+#define PROFILE_SITE(id, name) id,
+typedef enum {
+    PROFILE_SITES
+    PROFILE_SITE_COUNT
+} profile_site;
+#undef PROFILE_SITE
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t buckets[PROFILE_BUCKETS];
+} profile_stats;
+
+#if PROFILE_ENABLE
+#include "xtensa/hal.h"
+#define PROFILE_START(site) uint32_t profile_start_##site = xthal_get_ccount()
+#define PROFILE_END(site) \
+    profile_add((site), xthal_get_ccount() - profile_start_##site)
+#include "sdkconfig.h"
+#define PROFILE_LATE(site, us) \
+    profile_add((site), (uint32_t) (us) * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ)
+#else
+#define PROFILE_START(site) do { } while (0)
+#define PROFILE_END(site) do { } while (0)
+#define PROFILE_LATE(site, us) do { } while (0)
+#endif
+
+extern void profile_add(profile_site site, uint32_t cycles);
+extern void profile_get_stats(profile_site site, profile_stats *stats);
+extern const char* profile_name(profile_site site);
+extern void profile_reset(void);
+extern void profile_dump(void);
+
+#endif
@@ -0,0 +1,295 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_system.h"
+
+#include "7_seg_ui.h"
+#include "deadline.h"
+#include "input_service.h"
+#include "session.h"
+
+static const char *TAG = "session";
+
+/* Type, time and the biggest payload */
+#define SESSION_RECORD_MAX 11
+#define SESSION_DUMP_BYTES 32
+
+static session_mode mode;
+static seven_segment_ui *session_display;
+static int64_t start_us;
+static uint32_t last_ms;
+
+static uint8_t log_buffer[SESSION_LOG_SIZE];
+static size_t log_length;
+
+static const uint8_t *replay_log;
+static size_t replay_length;
+static size_t replay_pos;
+static session_stats stats;
+
+
+uint16_t session_display_hash(const seven_segment_ui *display)
+{
+    /* FNV-1a over what is shown, folded to 16 bits */
+    uint32_t hash = 2166136261u;
+    int i;
+
+    for (i=0; i<display->boards * DISPLAY_BUFFER_LENGTH; i++)
+        hash = (hash ^ display->display_buffer[i]) * 16777619u;
+    hash = (hash ^ display->flash) * 16777619u;
+    return (uint16_t) (hash ^ hash >> 16);
+}
+
+static uint32_t elapsed_ms(void)
+{
+    return (uint32_t) ((deadline_now() - start_us) / 1000);
+}
+
+static void put_byte(uint8_t b)
+{
+    log_buffer[log_length++] = b;
+}
+
+static void put_varint(uint32_t v)
+{
+    while (v >= 0x80) {
+        put_byte((uint8_t) (v | 0x80));
+        v >>= 7;
+    }
+    put_byte((uint8_t) v);
+}
+
+/* Start a record, returns 0 once the log is full */
+static int put_record(session_record type)
+{
+    uint32_t now = elapsed_ms();
+
+    if (stats.truncated || log_length + SESSION_RECORD_MAX > SESSION_LOG_SIZE) {
+        if (!stats.truncated)
+            ESP_LOGW(TAG, "Log full, recording stopped");
+        stats.truncated = 1;
+        return 0;
+    }
+    put_byte(type);
+    put_varint(now - last_ms);
+    last_ms = now;
+    return 1;
+}
+
+static uint32_t get_varint(size_t *pos)
+{
+    uint32_t v = 0;
+    int shift = 0;
+
+    while (*pos < replay_length && shift < 32) {
+        v |= (uint32_t) (replay_log[*pos] & 0x7f) << shift;
+        if (!(replay_log[(*pos)++] & 0x80))
+            break;
+        shift += 7;
+    }
+    return v;
+}
+
+/* The next record's type and when it is due, without taking it */
+static int peek_record(uint32_t *due_ms)
+{
+    size_t pos = replay_pos;
+    int type;
+
+    if (pos >= replay_length)
+        return 0;
+    type = replay_log[pos++];
+    *due_ms = last_ms + get_varint(&pos);
+    return type;
+}
+
+/* Take the next record if it is the type expected */
+static int get_record(session_record type)
+{
+    uint32_t due_ms;
+
+    if (peek_record(&due_ms) != type) {
+        if (!stats.missing)
+            ESP_LOGE(TAG, "Record %lu: expected type %d, log has %d", stats.records,
+                     type, peek_record(&due_ms));
+        stats.missing++;
+        return 0;
+    }
+    replay_pos++;
+    last_ms += get_varint(&replay_pos);
+    stats.records++;
+    return 1;
+}
+
+static uint16_t get_hash(void)
+{
+    uint16_t hash = 0;
+
+    if (replay_pos + 2 <= replay_length) {
+        hash = (uint16_t) (replay_log[replay_pos] | replay_log[replay_pos + 1] << 8);
+        replay_pos += 2;
+    }
+    return hash;
+}
+
+static void check_hash(const char *what)
+{
+    uint16_t expected = get_hash();
+    uint16_t hash = session_display_hash(session_display);
+
+    if (hash != expected) {
+        if (!stats.mismatches)
+            ESP_LOGE(TAG, "Record %lu at %u ms: %s display hash %04x, log has %04x",
+                     stats.records, (unsigned) last_ms, what, hash, expected);
+        stats.mismatches++;
+    }
+}
+
+
+/*
+ * Start a game's session: replay the log given to session_replay(), or
+ * record a new one
+ */
+void session_begin(seven_segment_ui *display, unsigned int count_from)
+{
+    session_display = display;
+    start_us = deadline_now();
+    last_ms = 0;
+    memset(&stats, 0, sizeof(stats));
+    if (replay_log) {
+        mode = SESSION_REPLAYING;
+        replay_pos = 0;
+        if (get_record(SESSION_START) && get_varint(&replay_pos) != count_from) {
+            ESP_LOGE(TAG, "Game length differs from the log's");
+            stats.mismatches++;
+        }
+    } else if (SESSION_ENABLE) {
+        mode = SESSION_RECORDING;
+        log_length = 0;
+        if (put_record(SESSION_START))
+            put_varint(count_from);
+    } else {
+        mode = SESSION_OFF;
+    }
+}
+
+void session_end(void)
+{
+    uint16_t hash = session_display_hash(session_display);
+
+    if (mode == SESSION_RECORDING && put_record(SESSION_END)) {
+        put_byte((uint8_t) hash);
+        put_byte((uint8_t) (hash >> 8));
+    } else if (mode == SESSION_REPLAYING) {
+        if (get_record(SESSION_END))
+            check_hash("final");
+        if (replay_pos < replay_length)
+            stats.missing++;
+        ESP_LOGI(TAG, "Replayed %lu records, %lu mismatches, %lu missing",
+                 stats.records, stats.mismatches, stats.missing);
+        replay_log = NULL;
+    }
+    mode = SESSION_OFF;
+}
+
+/* esp_random() % range, recorded or replayed */
+uint32_t session_random(uint32_t range)
+{
+    uint32_t value;
+
+    if (mode == SESSION_REPLAYING) {
+        if (get_record(SESSION_RANDOM)) {
+            value = get_varint(&replay_pos);
+            if (value < range)
+                return value;
+            stats.mismatches++;
+        }
+        return esp_random() % range;
+    }
+    value = esp_random() % range;
+    if (mode == SESSION_RECORDING && put_record(SESSION_RANDOM))
+        put_varint(value);
+    return value;
+}
+
+/*
+ * Buttons released since the last call, recorded or replayed, never blocks
+ * A replay gives the log's next buttons once they are due, and brings due
+ * forward to when that is if it's sooner, for the caller to come back then.
+ */
+uint8_t session_poll_released(int64_t now, int64_t *due)
+{
+    uint8_t buttons;
+    uint16_t hash;
+    uint32_t due_ms;
+    int64_t at;
+
+    if (mode != SESSION_REPLAYING) {
+        buttons = input_wait_released(0);
+        if (buttons && mode == SESSION_RECORDING && put_record(SESSION_INPUT)) {
+            hash = session_display_hash(session_display);
+            put_byte(buttons);
+            put_byte((uint8_t) hash);
+            put_byte((uint8_t) (hash >> 8));
+        }
+        return buttons;
+    }
+
+    if (peek_record(&due_ms) != SESSION_INPUT)
+        return 0;
+    at = start_us + DEADLINE_MS(due_ms);
+    if (at - now > 0) {
+        if (at - *due < 0)
+            *due = at;
+        return 0;
+    }
+    get_record(SESSION_INPUT);
+    buttons = replay_pos < replay_length ? replay_log[replay_pos++] : 0;
+    check_hash("input");
+    return buttons;
+}
+
+/* Replay this log in place of the next game's inputs, the log must stay put */
+void session_replay(const uint8_t *log, size_t length)
+{
+    replay_log = log;
+    replay_length = length;
+}
+
+/* The log recorded last, or being recorded */
+size_t session_log(const uint8_t **log)
+{
+    *log = log_buffer;
+    return log_length;
+}
+
+void session_get_stats(session_stats *s)
+{
+    *s = stats;
+}
+
+/* Whether the game running now is recorded, replayed or neither */
+session_mode session_get_mode(void)
+{
+    return mode;
+}
+
+/* Print the log as hex for the host's replay mode */
+void session_dump(void)
+{
+    size_t i;
+
+    for (i=0; i<log_length; i++) {
+        if (i % SESSION_DUMP_BYTES == 0)
+            printf(i ? "\nSL " : "SL ");
+        printf("%02x", log_buffer[i]);
+    }
+    if (log_length)
+        printf("\n");
+    ESP_LOGI(TAG, "%u bytes%s", (unsigned) log_length, stats.truncated ? ", truncated" : "");
+}
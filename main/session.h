@@ -0,0 +1,72 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "7_seg_ui.h"
+
+/*
+ * Game session record and replay
+ * Everything a game takes from outside goes through here: the buttons it
+ * was given and when, and the random numbers it drew.  Recording keeps
+ * them in a compact log along with a hash of the display each time a
+ * button arrives and at the end.  Replaying feeds a log back in place of
+ * the buttons and the random numbers, with the same timing, and checks the
+ * display hashes come out the same.  On the host simulation's virtual
+ * clock a replay runs 3000-10000x faster than real time.
+ *
+ * The log is a series of records, each a type byte and the milliseconds
+ * since the last record as a varint, then:
+ *   SESSION_START  - game length in seconds, varint
+ *   SESSION_RANDOM - the number drawn, varint
+ *   SESSION_INPUT  - buttons released, display hash (2 bytes)
+ *   SESSION_END    - display hash (2 bytes)
+ * A minute's game takes a few hundred bytes.  session_dump() prints it as
+ * hex "SL" lines for the host's replay mode.
+ *
+ * Replay times are only as fine as the tick, so a log from the device can
+ * land a button up to a tick later than it happened.  Logs recorded in the
+ * simulation replay exactly.
+ */
+#ifndef SESSION_ENABLE
+#define SESSION_ENABLE 1
+#endif
+#ifndef SESSION_LOG_SIZE
+#define SESSION_LOG_SIZE 2048
+#endif
+
+typedef enum {
+    SESSION_START = 1,
+    SESSION_RANDOM,
+    SESSION_INPUT,
+    SESSION_END,
+} session_record;
+
+typedef enum {
+    SESSION_OFF,
+    SESSION_RECORDING,
+    SESSION_REPLAYING,
+} session_mode;
+
+typedef struct {
+    unsigned long records;      /* Replayed */
+    unsigned long mismatches;   /* Display hashes or draws that differed */
+    unsigned long missing;      /* Log ran out or had the wrong record next */
+    uint8_t truncated;          /* Recording ran out of room */
+} session_stats;
+
+extern void session_begin(seven_segment_ui *display, unsigned int count_from);
+extern void session_end(void);
+extern uint32_t session_random(uint32_t range);
+extern uint8_t session_poll_released(int64_t now, int64_t *due);
+extern void session_replay(const uint8_t *log, size_t length);
+extern size_t session_log(const uint8_t **log);
+extern void session_get_stats(session_stats *stats);
+extern session_mode session_get_mode(void);
+extern void session_dump(void);
+extern uint16_t session_display_hash(const seven_segment_ui *display);
+
+#endif
@@ -22,7 +22,6 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/event_groups.h"
 
 #include "driver/gpio.h"
 #include "driver/ledc.h"
@@ -30,6 +29,10 @@
 #include "sdkconfig.h"
 
 #include "sound.h"
+#include "power.h"
+#include "spsc.h"
+#include "tasks.h"
+#include "trace.h"
 
 #define c 261
 #define d 294
@@ -51,109 +54,170 @@
 #define gSH 830
 #define aH 880
 
-#define GPIO_INPUT     0
-#define GPIO_OUTPUT    22
-#define GPIO_OUTPUT_OPPOSITE 19
-
 //#define GPIO_OUTPUT_SPEED LEDC_LOW_SPEED_MODE // back too old git commit :-(
 #define GPIO_OUTPUT_SPEED LEDC_HIGH_SPEED_MODE
 
 #define TAG "BUZZER"
 
-EventGroupHandle_t alarm_eventgroup;
+#define SOUND_SPEED GPIO_OUTPUT_SPEED
+#define SOUND_TIMER LEDC_TIMER_0
+#define SOUND_CHANNEL LEDC_CHANNEL_0
+/* 10 bit duty: 0x7F is about 12%, play here for your speaker or buzzer */
+#define SOUND_TONE_DUTY 0x7F
+#define SOUND_FULL_DUTY (1 << LEDC_TIMER_10_BIT)
+
+static sound_note notes_items[SOUND_QUEUE_LENGTH];
+
+static struct {
+    spsc_ring notes;            /* From the game task to the sound task */
+    uint32_t freq;
+} player;
+
+/* A little fanfare for cracking the code */
+const sound_note sound_win[] = {
+    {c, 120, 40}, {e, 120, 40}, {g, 120, 40}, {cH, 400, 300},
+};
+const int sound_win_length = sizeof(sound_win) / sizeof(sound_win[0]);
+
+
+static void sound_duty(uint32_t duty)
+{
+    ledc_set_duty(SOUND_SPEED, SOUND_CHANNEL, duty);
+    ledc_update_duty(SOUND_SPEED, SOUND_CHANNEL);
+}
 
-const int GPIO_SENSE_BIT = BIT0;
 
-void IRAM_ATTR gpio_isr_handler(void* arg) {
-    uint32_t gpio_num = (uint32_t) arg;
-    BaseType_t xHigherPriorityTaskWoken;
-    if (gpio_num==GPIO_INPUT) {
-    	xEventGroupSetBitsFromISR(alarm_eventgroup, GPIO_SENSE_BIT, &xHigherPriorityTaskWoken);
+/*
+ * Play one note to the end, only ever blocks the sound task
+ */
+static void sound_note_play(const sound_note *note)
+{
+    uint32_t duty = (note->freq == SOUND_BEEP) ? SOUND_FULL_DUTY : SOUND_TONE_DUTY;
+    uint32_t release = (note->release < note->duration) ? note->release : note->duration;
+
+    if (note->freq == SOUND_REST) {
+        vTaskDelay(note->duration / portTICK_PERIOD_MS);
+        return;
+    }
+    power_lock(POWER_SOUND);
+    if (note->freq != SOUND_BEEP && note->freq != player.freq) {
+        ledc_set_freq(SOUND_SPEED, SOUND_TIMER, note->freq);
+        player.freq = note->freq;
+    }
+    sound_duty(duty);
+    TRACE(TRACE_NOTE, note->freq, note->duration);
+    vTaskDelay((note->duration - release) / portTICK_PERIOD_MS);
+    if (release) {
+        /* Let the hardware fade it out */
+        ledc_set_fade_with_time(SOUND_SPEED, SOUND_CHANNEL, 0, release);
+        ledc_fade_start(SOUND_SPEED, SOUND_CHANNEL, LEDC_FADE_NO_WAIT);
+        vTaskDelay(release / portTICK_PERIOD_MS);
     }
+    sound_duty(0);
+    power_unlock(POWER_SOUND);
 }
 
-void init_gpio(void) {
-    gpio_config_t io_conf;
-
-    //interrupt of falling edge
-    io_conf.intr_type = GPIO_INTR_ANYEDGE;
-    io_conf.pin_bit_mask = (1<<GPIO_INPUT);
-    io_conf.mode = GPIO_MODE_INPUT;
-    io_conf.pull_up_en = 1;
-    io_conf.pull_down_en = 0;
-    gpio_config(&io_conf);
-
-    //install gpio isr service
-    gpio_install_isr_service(0); // no flags
-    //hook isr handler for specific gpio pin
-    gpio_isr_handler_add(GPIO_INPUT, gpio_isr_handler, (void*) GPIO_INPUT);
+
+static void sound_task(void *pvParameters)
+{
+    sound_note note;
+    for (;;) {
+        if (spsc_wait(&player.notes, &note, portMAX_DELAY))
+            sound_note_play(&note);
+    }
 }
 
-void sound(int gpio_num, int gnd_num, uint32_t freq, uint32_t duration) {
 
-    gpio_pad_select_gpio(gpio_num);
+/*
+ * Set up the buzzer once and start the task that plays queued notes
+ * The buzzer sits between gpio_num, driven by LEDC, and gnd_num held low.
+ */
+int sound_start(int gpio_num, int gnd_num, int core, UBaseType_t priority)
+{
+    ledc_timer_config_t timer_conf;
+    ledc_channel_config_t ledc_conf;
+    TaskHandle_t task;
+
     gpio_pad_select_gpio(gnd_num);
-    gpio_set_direction(gpio_num, GPIO_MODE_OUTPUT);
     gpio_set_direction(gnd_num, GPIO_MODE_OUTPUT);
     gpio_set_level(gnd_num, 0);
-    ESP_LOGI(TAG, "GPIO Config done");
-
-	ledc_timer_config_t timer_conf;
-	timer_conf.speed_mode = GPIO_OUTPUT_SPEED;
-	timer_conf.duty_resolution    = LEDC_TIMER_10_BIT;
-	timer_conf.timer_num  = LEDC_TIMER_0;
-	timer_conf.freq_hz    = freq;
-	ledc_timer_config(&timer_conf);
-    ESP_LOGI(TAG, "Timer Config done");
-
-	ledc_channel_config_t ledc_conf;
-	ledc_conf.gpio_num   = gpio_num;
-	ledc_conf.speed_mode = GPIO_OUTPUT_SPEED;
-	ledc_conf.channel    = LEDC_CHANNEL_0;
-	ledc_conf.intr_type  = LEDC_INTR_DISABLE;
-	ledc_conf.timer_sel  = LEDC_TIMER_0;
-    ledc_conf.hpoint = 0x7fff;
-	ledc_conf.duty       = 0x0; // 50%=0x3FFF, 100%=0x7FFF for 15 Bit
-	                            // 50%=0x01FF, 100%=0x03FF for 10 Bit
-	ledc_channel_config(&ledc_conf);
+
+    memset(&timer_conf, 0, sizeof(timer_conf));
+    timer_conf.speed_mode = SOUND_SPEED;
+    timer_conf.duty_resolution = LEDC_TIMER_10_BIT;
+    timer_conf.timer_num = SOUND_TIMER;
+    timer_conf.freq_hz = a;
+    ledc_timer_config(&timer_conf);
+    player.freq = a;
+
+    memset(&ledc_conf, 0, sizeof(ledc_conf));
+    ledc_conf.gpio_num = gpio_num;
+    ledc_conf.speed_mode = SOUND_SPEED;
+    ledc_conf.channel = SOUND_CHANNEL;
+    ledc_conf.intr_type = LEDC_INTR_DISABLE;
+    ledc_conf.timer_sel = SOUND_TIMER;
+    ledc_conf.hpoint = 0;
+    ledc_conf.duty = 0;
+    ledc_channel_config(&ledc_conf);
+    ledc_fade_func_install(0);
+
+    if (spsc_init(&player.notes, notes_items, sizeof(sound_note),
+                  SOUND_QUEUE_LENGTH)) {
+        ESP_LOGE(TAG, "Unable to create sound queue");
+        return -1;
+    }
+    task = task_start(TASK_SOUND, sound_task, NULL, priority, core);
+    if (task == NULL) {
+        ESP_LOGE(TAG, "Unable to start sound task");
+        return -1;
+    }
+    spsc_set_consumer(&player.notes, task);
     ESP_LOGI(TAG, "LEDC Config done");
+    return 0;
+}
 
-	// start
-    ESP_LOGI(TAG, "Starting Sound");
-    ledc_set_duty(GPIO_OUTPUT_SPEED, LEDC_CHANNEL_0, 0x7F); // 12% duty - play here for your speaker or buzzer
-    ledc_update_duty(GPIO_OUTPUT_SPEED, LEDC_CHANNEL_0);
-    ESP_LOGD(TAG, "Duty set to %d", ledc_get_duty(GPIO_OUTPUT_SPEED, LEDC_CHANNEL_0));
-	vTaskDelay(duration/portTICK_PERIOD_MS);
-	// stop
-    ESP_LOGI(TAG, "Stopping Sound");
-    ledc_set_duty(GPIO_OUTPUT_SPEED, LEDC_CHANNEL_0, 0);
-    ledc_update_duty(GPIO_OUTPUT_SPEED, LEDC_CHANNEL_0);
-    ESP_LOGD(TAG, "Duty set to %d", ledc_get_duty(GPIO_OUTPUT_SPEED, LEDC_CHANNEL_0));
 
+/*
+ * Queue notes to play after whatever is playing now, never blocks
+ * Returns how many were queued, the rest are dropped if the queue is full.
+ * The queue has one producer, so only ever call this from the game task.
+ */
+int sound_play(const sound_note *notes, int count)
+{
+    int i;
+    if (player.notes.items == NULL)
+        return 0;
+    for (i=0; i<count; i++) {
+        if (!spsc_push(&player.notes, &notes[i])) {
+            player.notes.dropped += count - i - 1;
+            break;
+        }
+    }
+    return i;
 }
-void gpio_task(void *pvParameters) {
-	EventBits_t bits;
 
-	uint32_t loop=0;
 
-	alarm_eventgroup = xEventGroupCreate();
-    init_gpio();
+/*
+ * Sound the buzzer at its own pitch
+ */
+int sound_beep(uint32_t duration_ms)
+{
+    sound_note note = {SOUND_BEEP, duration_ms, 0};
+    return sound_play(&note, 1);
+}
 
-	while (1) {
-		bits=xEventGroupWaitBits(alarm_eventgroup, GPIO_SENSE_BIT,pdTRUE, pdFALSE, 60000 / portTICK_RATE_MS); // max wait 60s
-		if(bits!=0) {
-			if (loop%2==0) {
-				//play_march(0);
-			} else {
-				//play_theme();
-			}
-	    	xEventGroupClearBits(alarm_eventgroup, GPIO_SENSE_BIT);
-		}
 
-		loop++;
-	}
+/*
+ * Forget queued notes, the one playing now still finishes
+ * From the game task, like sound_play().
+ */
+void sound_flush(void)
+{
+    spsc_discard(&player.notes);
+}
 
-	ESP_LOGI(TAG, "All done!");
 
-	vTaskDelete(NULL);
-}
\ No newline at end of file
+unsigned long sound_dropped(void)
+{
+    return player.notes.dropped;
+}
@@ -18,7 +18,36 @@
 
 #include <stdint.h>
 
-void sound(int gpio_num, int gnd_num, uint32_t freq, uint32_t duration);
-void sound_task(void *pvParameters);
+#include "freertos/FreeRTOS.h"
+
+/*
+ * Sound
+ * LEDC is set up once by sound_start() and a task plays notes from a
+ * queue, so callers never wait for a note to finish.  The queue is a ring
+ * with a single producer, see spsc.h, so only the game task plays notes.
+ * A note can end with a hardware fade over its last release ms.
+ */
+/* A power of 2 */
+#ifndef SOUND_QUEUE_LENGTH
+#define SOUND_QUEUE_LENGTH 32
+#endif
+
+#define SOUND_REST 0            /* Silence for the duration */
+#define SOUND_BEEP 0xffff       /* Full duty, the buzzer's own tone */
+
+typedef struct {
+    uint16_t freq;              /* Hz, or SOUND_REST or SOUND_BEEP */
+    uint16_t duration;          /* ms, including the release */
+    uint16_t release;           /* ms to fade out over */
+} sound_note;
+
+extern const sound_note sound_win[];
+extern const int sound_win_length;
+
+int sound_start(int gpio_num, int gnd_num, int core, UBaseType_t priority);
+int sound_play(const sound_note *notes, int count);
+int sound_beep(uint32_t duration_ms);
+void sound_flush(void);
+unsigned long sound_dropped(void);
 
 #endif /* SOUND_H */
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_log.h"
+
+#include "spsc.h"
+
+static const char *TAG = "spsc";
+
+
+/*
+ * Set up an empty ring over length items of item_size bytes
+ */
+int spsc_init(spsc_ring *ring, void *items, size_t item_size, unsigned length)
+{
+    memset(ring, 0, sizeof(*ring));
+    if (length == 0 || (length & (length - 1)) || length > 0x10000) {
+        ESP_LOGE(TAG, "Ring length %u is not a power of 2", length);
+        return -1;
+    }
+    ring->items = items;
+    ring->item_size = item_size;
+    ring->mask = length - 1;
+    return 0;
+}
+
+
+/*
+ * The task to notify on each push, the one that calls spsc_wait()
+ */
+void spsc_set_consumer(spsc_ring *ring, TaskHandle_t task)
+{
+    __atomic_store_n(&ring->consumer, task, __ATOMIC_RELEASE);
+}
+
+
+/* Copy the item in and publish it, 0 if full */
+static inline int IRAM_ATTR spsc_put(spsc_ring *ring, const void *item)
+{
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head - tail > ring->mask) {
+        ring->dropped++;
+        return 0;
+    }
+    memcpy(ring->items + (head & ring->mask) * ring->item_size, item,
+           ring->item_size);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+
+/*
+ * Add an item from a task, never blocks
+ * Returns 1, or 0 with the item dropped if the ring is full
+ */
+int spsc_push(spsc_ring *ring, const void *item)
+{
+    TaskHandle_t consumer;
+    if (!spsc_put(ring, item))
+        return 0;
+    /* The notification count outlives a consumer that hasn't blocked yet */
+    consumer = __atomic_load_n(&ring->consumer, __ATOMIC_ACQUIRE);
+    if (consumer)
+        xTaskNotifyGive(consumer);
+    return 1;
+}
+
+
+/*
+ * Add an item from an ISR
+ */
+int IRAM_ATTR spsc_push_from_isr(spsc_ring *ring, const void *item)
+{
+    BaseType_t woken = pdFALSE;
+    TaskHandle_t consumer;
+    if (!spsc_put(ring, item))
+        return 0;
+    consumer = __atomic_load_n(&ring->consumer, __ATOMIC_ACQUIRE);
+    if (consumer) {
+        vTaskNotifyGiveFromISR(consumer, &woken);
+        if (woken)
+            portYIELD_FROM_ISR();
+    }
+    return 1;
+}
+
+
+/*
+ * Take the oldest item if there is one, never blocks
+ */
+int spsc_pop(spsc_ring *ring, void *item)
+{
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t discard = __atomic_load_n(&ring->discard, __ATOMIC_ACQUIRE);
+
+    if ((int32_t) (discard - tail) > 0)
+        tail = discard;
+    if (tail == head) {
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        return 0;
+    }
+    memcpy(item, ring->items + (tail & ring->mask) * ring->item_size,
+           ring->item_size);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+
+/*
+ * Wait up to ticks for an item, from the consumer task
+ * Returns 1 with the item filled in, 0 on timeout
+ */
+int spsc_wait(spsc_ring *ring, void *item, TickType_t ticks)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t left = ticks;
+    TickType_t waited;
+
+    spsc_set_consumer(ring, xTaskGetCurrentTaskHandle());
+    for (;;) {
+        if (spsc_pop(ring, item))
+            return 1;
+        if (ticks != portMAX_DELAY) {
+            waited = xTaskGetTickCount() - start;
+            if (waited >= ticks)
+                return 0;
+            left = ticks - waited;
+        }
+        /* A notification left over from an item already taken just loops */
+        ulTaskNotifyTake(pdTRUE, left);
+    }
+}
+
+
+/*
+ * Throw away everything queued, from the consumer
+ */
+void spsc_flush(spsc_ring *ring)
+{
+    __atomic_store_n(&ring->tail, __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE),
+                     __ATOMIC_RELEASE);
+}
+
+
+/*
+ * Throw away everything queued, from the producer
+ * The consumer skips it on its next pop.
+ */
+void spsc_discard(spsc_ring *ring)
+{
+    __atomic_store_n(&ring->discard, ring->head, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * Items waiting, a snapshot from either side
+ */
+unsigned spsc_count(const spsc_ring *ring)
+{
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
@@ -0,0 +1,43 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Single producer, single consumer ring
+ * Passes fixed size items from one task (or ISR) to another, usually on
+ * the other core, without a lock: the producer only ever writes head, the
+ * consumer only ever writes tail.  A push gives the consumer task a
+ * notification, so it can block in spsc_wait() rather than poll.
+ *
+ * The storage belongs to the caller and the length must be a power of 2.
+ * Nothing checks who calls what: a second producer or consumer on the same
+ * ring corrupts it, so say in the owning module which task is which.
+ */
+typedef struct {
+    uint8_t *items;
+    uint16_t item_size;
+    uint16_t mask;
+    uint32_t head;              /* Next to write, producer only */
+    uint32_t tail;              /* Next to read, consumer only */
+    uint32_t discard;           /* Producer asks the consumer to skip to here */
+    TaskHandle_t consumer;      /* Notified on every push, if set */
+    unsigned long dropped;      /* Pushes that found it full */
+} spsc_ring;
+
+extern int spsc_init(spsc_ring *ring, void *items, size_t item_size,
+                     unsigned length);
+extern void spsc_set_consumer(spsc_ring *ring, TaskHandle_t task);
+extern int spsc_push(spsc_ring *ring, const void *item);
+extern int spsc_push_from_isr(spsc_ring *ring, const void *item);
+extern int spsc_pop(spsc_ring *ring, void *item);
+extern int spsc_wait(spsc_ring *ring, void *item, TickType_t ticks);
+extern void spsc_flush(spsc_ring *ring);
+extern void spsc_discard(spsc_ring *ring);
+extern unsigned spsc_count(const spsc_ring *ring);
+
+#endif
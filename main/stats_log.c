@@ -0,0 +1,411 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_spi_flash.h"
+
+#include "power.h"
+#include "spsc.h"
+#include "stats_log.h"
+#include "tasks.h"
+
+static const char *TAG = "stats";
+
+#define STATS_MAGIC 0x314c5453          /* "STL1" */
+#define STATS_RECORD_GAME 0x47
+/* Records read at a time when scanning a sector */
+#define STATS_SCAN_RECORDS 16
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;          /* One more than the sector written before */
+    stats_summary summary;      /* Every game logged before this sector */
+    uint32_t check;
+} stats_header;
+
+typedef struct {
+    uint8_t type;               /* STATS_RECORD_GAME */
+    uint8_t outcome;
+    uint8_t guesses;
+    uint8_t hints;
+    uint16_t count_from;
+    uint16_t check;             /* Over the record with this 0 */
+    uint32_t duration_ms;
+    uint32_t number;            /* Games logged before this one */
+} stats_record;
+
+/* Records start on a 16 byte boundary after the header */
+#define STATS_HEADER_SIZE ((sizeof(stats_header) + 15) & ~15)
+#define STATS_SECTOR_RECORDS ((SPI_FLASH_SEC_SIZE - STATS_HEADER_SIZE) / sizeof(stats_record))
+
+static stats_game queue_items[STATS_QUEUE_LENGTH];
+
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static struct {
+    const esp_partition_t *partition;
+    spsc_ring queue;            /* From the game task to the stats task */
+    unsigned sectors;
+    unsigned sector;            /* Being written */
+    unsigned slot;              /* Next free record in it */
+    uint32_t sequence;          /* Its header's */
+    uint32_t number;            /* The next game's */
+    stats_summary summary;      /* Everything written so far */
+    stats_record batch[STATS_BATCH];
+    unsigned pending;           /* In the batch */
+    unsigned long errors;
+} stats;
+
+
+/* Fletcher-16 */
+static uint16_t stats_check(const void *data, size_t length)
+{
+    const uint8_t *p = data;
+    uint16_t a = 0, b = 0;
+    while (length--) {
+        a = (a + *p++) % 255;
+        b = (b + a) % 255;
+    }
+    return b << 8 | a;
+}
+
+
+static uint16_t record_check(const stats_record *record)
+{
+    stats_record copy = *record;
+    copy.check = 0;
+    return stats_check(&copy, sizeof(copy));
+}
+
+
+static int record_erased(const stats_record *record)
+{
+    const uint8_t *p = (const uint8_t *) record;
+    size_t i;
+    for (i=0; i<sizeof(*record); i++) {
+        if (p[i] != 0xff)
+            return 0;
+    }
+    return 1;
+}
+
+
+/* Count one game into the totals */
+static void summary_add(stats_summary *summary, const stats_record *record)
+{
+    unsigned bucket;
+    summary->games++;
+    summary->hints += record->hints;
+    if (record->outcome != STATS_CORRECT)
+        return;
+    summary->wins++;
+    summary->guesses += record->guesses;
+    summary->solve_ms += record->duration_ms;
+    bucket = record->duration_ms / 1000 / STATS_HIST_SECONDS;
+    if (bucket >= STATS_HIST_BUCKETS)
+        bucket = STATS_HIST_BUCKETS - 1;
+    /* Saturates, the median is only as good as the buckets anyway */
+    if (summary->solve_hist[bucket] != UINT16_MAX)
+        summary->solve_hist[bucket]++;
+}
+
+
+static int read_header(unsigned sector, stats_header *header)
+{
+    if (esp_partition_read(stats.partition, sector * SPI_FLASH_SEC_SIZE, header,
+                           sizeof(*header)) != ESP_OK)
+        return 0;
+    return header->magic == STATS_MAGIC &&
+           header->check == stats_check(header, offsetof(stats_header, check));
+}
+
+
+/*
+ * Find the newest sector and add its records to the totals in its header
+ * Returns the sector, or -1 if there is no log yet.  *slot is where the
+ * next record would go, *number the next game's number.
+ */
+static int stats_scan(stats_summary *summary, unsigned *slot, uint32_t *sequence,
+                      uint32_t *number)
+{
+    stats_header header;
+    stats_record records[STATS_SCAN_RECORDS];
+    int newest = -1;
+    unsigned sector, i, n;
+
+    *sequence = 0;
+    for (sector=0; sector<stats.sectors; sector++) {
+        if (read_header(sector, &header) &&
+            (newest < 0 || (int32_t) (header.sequence - *sequence) > 0)) {
+            newest = sector;
+            *sequence = header.sequence;
+            *summary = header.summary;
+        }
+    }
+    if (newest < 0)
+        return -1;
+
+    *number = summary->games;
+    *slot = 0;
+    for (i=0; i<STATS_SECTOR_RECORDS; i+=n) {
+        n = STATS_SECTOR_RECORDS - i;
+        if (n > STATS_SCAN_RECORDS)
+            n = STATS_SCAN_RECORDS;
+        if (esp_partition_read(stats.partition, newest * SPI_FLASH_SEC_SIZE +
+                               STATS_HEADER_SIZE + i * sizeof(stats_record),
+                               records, n * sizeof(stats_record)) != ESP_OK)
+            break;
+        for (*slot=i; *slot<i+n; (*slot)++) {
+            const stats_record *record = &records[*slot - i];
+            if (record_erased(record))
+                return newest;
+            /* A write cut short by a reset still takes up its slot */
+            if (record->type == STATS_RECORD_GAME && record->check == record_check(record)) {
+                summary_add(summary, record);
+                *number = record->number + 1;
+            }
+        }
+    }
+    return newest;
+}
+
+
+/*
+ * Erase the next sector round and start it with the totals so far
+ */
+static int stats_new_sector(void)
+{
+    stats_header header;
+    unsigned sector = (stats.sector + 1) % stats.sectors;
+
+    if (esp_partition_erase_range(stats.partition, sector * SPI_FLASH_SEC_SIZE,
+                                  SPI_FLASH_SEC_SIZE) != ESP_OK)
+        return -1;
+    memset(&header, 0, sizeof(header));
+    header.magic = STATS_MAGIC;
+    header.sequence = stats.sequence + 1;
+    header.summary = stats.summary;
+    header.check = stats_check(&header, offsetof(stats_header, check));
+    if (esp_partition_write(stats.partition, sector * SPI_FLASH_SEC_SIZE, &header,
+                            sizeof(header)) != ESP_OK)
+        return -1;
+    stats.sector = sector;
+    stats.sequence = header.sequence;
+    stats.slot = 0;
+    return 0;
+}
+
+
+/*
+ * Write the batch, as few writes as there are sectors it spans
+ */
+static void stats_write_batch(void)
+{
+    unsigned i = 0, n;
+
+    while (i < stats.pending) {
+        if (stats.slot == STATS_SECTOR_RECORDS && stats_new_sector() != 0) {
+            stats.errors++;
+            ESP_LOGE(TAG, "Unable to start sector %u", (stats.sector + 1) % stats.sectors);
+            break;
+        }
+        n = stats.pending - i;
+        if (n > STATS_SECTOR_RECORDS - stats.slot)
+            n = STATS_SECTOR_RECORDS - stats.slot;
+        if (esp_partition_write(stats.partition, stats.sector * SPI_FLASH_SEC_SIZE +
+                                STATS_HEADER_SIZE + stats.slot * sizeof(stats_record),
+                                &stats.batch[i], n * sizeof(stats_record)) != ESP_OK) {
+            stats.errors++;
+            ESP_LOGE(TAG, "Unable to write %u records", n);
+            break;
+        }
+        stats.slot += n;
+        portENTER_CRITICAL(&stats_mux);
+        for (; n; n--, i++)
+            summary_add(&stats.summary, &stats.batch[i]);
+        portEXIT_CRITICAL(&stats_mux);
+    }
+    /* Anything not written is lost rather than retried for ever */
+    stats.pending = 0;
+}
+
+
+static void stats_batch_add(const stats_game *game)
+{
+    stats_record *record = &stats.batch[stats.pending++];
+    record->type = STATS_RECORD_GAME;
+    record->outcome = game->outcome;
+    record->guesses = game->guesses;
+    record->hints = game->hints;
+    record->count_from = game->count_from;
+    record->duration_ms = game->duration_ms;
+    record->number = stats.number++;
+    record->check = record_check(record);
+}
+
+
+static void stats_task(void *pvParameters)
+{
+    stats_game game;
+    TickType_t wait;
+
+    for (;;) {
+        wait = stats.pending ? STATS_BATCH_MS / portTICK_PERIOD_MS : portMAX_DELAY;
+        if (stats.pending < STATS_BATCH && spsc_wait(&stats.queue, &game, wait)) {
+            stats_batch_add(&game);
+            continue;
+        }
+        /* Flash writes and erases stall both CPUs, so not mid game */
+        if (!power_idle()) {
+            vTaskDelay(STATS_BATCH_MS / portTICK_PERIOD_MS);
+            continue;
+        }
+        stats_write_batch();
+    }
+}
+
+
+/*
+ * Read back the totals of every game in the log
+ * Returns 0, or -1 with *summary zeroed if there is no log.
+ */
+int stats_log_load(stats_summary *summary)
+{
+    unsigned slot;
+    uint32_t sequence, number;
+
+    memset(summary, 0, sizeof(*summary));
+    if (stats.partition == NULL || stats_scan(summary, &slot, &sequence, &number) < 0) {
+        memset(summary, 0, sizeof(*summary));
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * Find the log, read its totals and start the task that writes to it
+ */
+int stats_log_start(int core, UBaseType_t priority)
+{
+    TaskHandle_t task;
+    int sector;
+
+    memset(&stats, 0, sizeof(stats));
+    stats.partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                               STATS_PARTITION_SUBTYPE,
+                                               STATS_PARTITION_LABEL);
+    if (stats.partition == NULL) {
+        ESP_LOGW(TAG, "No %s partition, games will not be logged", STATS_PARTITION_LABEL);
+        return -1;
+    }
+    stats.sectors = stats.partition->size / SPI_FLASH_SEC_SIZE;
+    if (stats.sectors < 2) {
+        ESP_LOGE(TAG, "The %s partition needs 2 sectors or more", STATS_PARTITION_LABEL);
+        stats.partition = NULL;
+        return -1;
+    }
+    sector = stats_scan(&stats.summary, &stats.slot, &stats.sequence, &stats.number);
+    if (sector >= 0) {
+        stats.sector = sector;
+    } else {
+        /* The first batch starts it, the erase is no business of boot */
+        ESP_LOGI(TAG, "Starting a new log");
+        stats.sector = stats.sectors - 1;
+        stats.slot = STATS_SECTOR_RECORDS;
+    }
+    if (spsc_init(&stats.queue, queue_items, sizeof(stats_game), STATS_QUEUE_LENGTH))
+        return -1;
+    task = task_start(TASK_STATS, stats_task, NULL, priority, core);
+    if (task == NULL) {
+        ESP_LOGE(TAG, "Unable to start stats log");
+        return -1;
+    }
+    spsc_set_consumer(&stats.queue, task);
+    stats_log_print();
+    return 0;
+}
+
+
+/*
+ * Queue a finished game for the log, never blocks
+ * Only from the game task, the queue has a single producer.
+ * Returns 0 if it was dropped: no log, or the queue is full.
+ */
+int stats_log_game(const stats_game *game)
+{
+    if (stats.queue.items == NULL)
+        return 0;
+    return spsc_push(&stats.queue, game);
+}
+
+
+/*
+ * Totals of the games written so far, not those still queued
+ */
+void stats_log_get_summary(stats_summary *summary)
+{
+    portENTER_CRITICAL(&stats_mux);
+    *summary = stats.summary;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+
+/*
+ * The middle time to win, to the nearest bucket, 0 with no wins
+ */
+uint32_t stats_median_solve_ms(const stats_summary *summary)
+{
+    uint32_t seen = 0, wins = 0;
+    int b;
+
+    for (b=0; b<STATS_HIST_BUCKETS; b++)
+        wins += summary->solve_hist[b];
+    for (b=0; b<STATS_HIST_BUCKETS; b++) {
+        seen += summary->solve_hist[b];
+        if (wins && seen * 2 >= wins) {
+            if (b == STATS_HIST_BUCKETS - 1)
+                return b * STATS_HIST_SECONDS * 1000;
+            return b * STATS_HIST_SECONDS * 1000 + STATS_HIST_SECONDS * 500;
+        }
+    }
+    return 0;
+}
+
+
+void stats_log_print(void)
+{
+    stats_summary summary;
+
+    stats_log_get_summary(&summary);
+    ESP_LOGI(TAG, "%u games, %u won (%u%%), median win %u s, %u.%u guesses a win, %u hints",
+             summary.games, summary.wins,
+             summary.games ? summary.wins * 100 / summary.games : 0,
+             stats_median_solve_ms(&summary) / 1000,
+             summary.wins ? summary.guesses / summary.wins : 0,
+             summary.wins ? summary.guesses * 10 / summary.wins % 10 : 0,
+             summary.hints);
+    ESP_LOGI(TAG, "Log at sector %u of %u, record %u of %u, %lu errors",
+             stats.sector, stats.sectors, stats.slot, (unsigned) STATS_SECTOR_RECORDS,
+             stats.errors);
+}
+
+
+/*
+ * Games queued or batched but not yet written
+ */
+unsigned stats_log_pending(void)
+{
+    return stats.pending + spsc_count(&stats.queue);
+}
+
+
+unsigned long stats_log_dropped(void)
+{
+    return stats.queue.dropped;
+}
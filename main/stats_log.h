@@ -0,0 +1,79 @@
+#ifndef STATS_LOG_H
+#define STATS_LOG_H
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+/*
+ * Game statistics log
+ * Every game's outcome goes into an append-only log in the "stats" flash
+ * partition (see partitions.csv), so they survive a reboot.  The game only
+ * queues a record; a low priority task gathers them into a batch and
+ * writes it once no game is running, as erasing flash stalls both CPUs.
+ *
+ * The partition is used as a ring of sectors, each erased only when the
+ * log comes back round to it, so every sector wears at the same rate.  A
+ * sector starts with a header holding its sequence number and the totals
+ * of every game logged before it, then 16 byte records:
+ *
+ *   header  magic, sequence, stats_summary, check
+ *   record  type, outcome, guesses, hints, count_from, check,
+ *           duration_ms, game number
+ *
+ * At boot the newest header gives the totals, and only its own sector's
+ * records need reading on top.  Records that roll off with an erase are
+ * gone, but they stay counted in the totals.
+ */
+#ifndef STATS_LOG_ENABLE
+#define STATS_LOG_ENABLE 1
+#endif
+#define STATS_PARTITION_LABEL "stats"
+#define STATS_PARTITION_SUBTYPE 0x40
+/* Records written together, or after STATS_BATCH_MS with fewer */
+#ifndef STATS_BATCH
+#define STATS_BATCH 4
+#endif
+#ifndef STATS_BATCH_MS
+#define STATS_BATCH_MS 2000
+#endif
+/* A power of 2 */
+#ifndef STATS_QUEUE_LENGTH
+#define STATS_QUEUE_LENGTH 8
+#endif
+/* Wins by time to solve, the last bucket takes everything longer */
+#define STATS_HIST_BUCKETS 24
+#define STATS_HIST_SECONDS 5
+
+typedef enum {
+    STATS_CORRECT = 1,
+    STATS_TIMEUP,
+} stats_outcome;
+
+typedef struct {
+    uint8_t outcome;            /* stats_outcome */
+    uint8_t guesses;            /* Codes checked */
+    uint8_t hints;
+    uint16_t count_from;        /* Seconds the game started with */
+    uint32_t duration_ms;       /* Start to the win, or to time up */
+} stats_game;
+
+typedef struct {
+    uint32_t games;
+    uint32_t wins;
+    uint32_t guesses;           /* In games won */
+    uint32_t hints;
+    uint64_t solve_ms;          /* Total time to win */
+    uint16_t solve_hist[STATS_HIST_BUCKETS];
+} stats_summary;
+
+extern int stats_log_start(int core, UBaseType_t priority);
+extern int stats_log_game(const stats_game *game);
+extern void stats_log_get_summary(stats_summary *summary);
+extern int stats_log_load(stats_summary *summary);
+extern uint32_t stats_median_solve_ms(const stats_summary *summary);
+extern void stats_log_print(void);
+extern unsigned stats_log_pending(void);
+extern unsigned long stats_log_dropped(void);
+
+#endif
@@ -0,0 +1,98 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_log.h"
+
+#include "tasks.h"
+
+static const char *TAG = "tasks";
+
+/* Separate symbols, so the budget can name each task's share */
+#define TASK(id, name, stack) \
+    static StackType_t id##_stack[stack]; \
+    static StaticTask_t id##_tcb;
+TASKS
+#undef TASK
+
+#define TASK(id, name, stack) {name, stack, id##_stack, &id##_tcb},
+static const struct {
+    const char *name;
+    uint32_t size;
+    StackType_t *stack;
+    StaticTask_t *tcb;
+} task_table[TASK_COUNT] = {
+    TASKS
+    {"main", CONFIG_MAIN_TASK_STACK_SIZE, NULL, NULL},
+};
+#undef TASK
+
+static TaskHandle_t handles[TASK_COUNT];
+
+
+/*
+ * Start task id on its static stack
+ * Each can only be started once.  Returns NULL if it was already.
+ */
+TaskHandle_t task_start(task_id id, TaskFunction_t fn, void *arg,
+                        UBaseType_t priority, int core)
+{
+    if (id >= TASK_MAIN || handles[id] != NULL) {
+        ESP_LOGE(TAG, "Task %d already started", id);
+        return NULL;
+    }
+    handles[id] = xTaskCreateStaticPinnedToCore(fn, task_table[id].name,
+                                                task_table[id].size, arg, priority,
+                                                task_table[id].stack,
+                                                task_table[id].tcb, core);
+    return handles[id];
+}
+
+
+/* Call from app_main, for its stack to be reported on */
+void task_register_main(void)
+{
+    handles[TASK_MAIN] = xTaskGetCurrentTaskHandle();
+}
+
+
+void task_get_stack_stats(task_id id, task_stack_stats *stats)
+{
+    stats->name = task_table[id].name;
+    stats->size = task_table[id].size;
+    stats->running = handles[id] != NULL;
+    stats->used = stats->running ?
+        stats->size - uxTaskGetStackHighWaterMark(handles[id]) : 0;
+}
+
+
+/*
+ * Print each task's stack use, and the size it could do with
+ */
+void task_stack_print(void)
+{
+    task_stack_stats stats;
+    uint32_t size = 0, used = 0, suggested = 0, want;
+    int id;
+
+    printf("Task stacks, bytes:\n");
+    printf("  task        size    used    free  suggest\n");
+    for (id=0; id<TASK_COUNT; id++) {
+        task_get_stack_stats(id, &stats);
+        if (!stats.running) {
+            printf("  %-8s %7u       -       -        -\n", stats.name, stats.size);
+            continue;
+        }
+        /* Round up to 16 bytes, the stack's alignment */
+        want = (stats.used + TASK_STACK_MARGIN + 15) & ~15u;
+        printf("  %-8s %7u %7u %7u %8u%s\n", stats.name, stats.size, stats.used,
+               stats.size - stats.used, want,
+               stats.used + TASK_STACK_MARGIN / 2 > stats.size ? "  LOW" : "");
+        size += stats.size;
+        used += stats.used;
+        suggested += want;
+    }
+    printf("  running  %7u %7u %7u %8u\n", size, used, size - used, suggested);
+}
@@ -0,0 +1,71 @@
+#ifndef TASKS_H
+#define TASKS_H
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+/*
+ * Task stacks
+ * Every task the firmware starts gets its stack and TCB from here, both
+ * static, so what they take shows up at link time (host/ram_budget.sh,
+ * run after each build) rather than coming out of the heap.  Sizes are in
+ * bytes, as ESP-IDF counts stack depth.
+ *
+ * To size a stack, run the unit through a few games and type k at the
+ * serial console for each task's high-water mark, then bring its size
+ * here down to the bytes used plus TASK_STACK_MARGIN.  The host sim's
+ * budget mode prints the same, but host stacks are x86-64 ones and so
+ * only a rough guide.
+ *
+ * app_main's own task is IDF's, CONFIG_MAIN_TASK_STACK_SIZE, and is only
+ * reported on.
+ */
+#ifndef TASK_STACK_MARGIN
+#define TASK_STACK_MARGIN 512
+#endif
+
+/* The display mirror and its task are only built with this set */
+#ifndef DISPLAY_MIRROR_ENABLE
+#define DISPLAY_MIRROR_ENABLE 0
+#endif
+
+#if DISPLAY_MIRROR_ENABLE
+#define TASK_MIRROR_ENTRY TASK(TASK_MIRROR, "mirror", 3072)
+#else
+#define TASK_MIRROR_ENTRY
+#endif
+
+/* TASK(id, name, stack bytes) */
+#define TASKS                                                               \
+    TASK(TASK_DISPLAY,  "display",  2048)                                   \
+    TASK(TASK_INPUT,    "input",    2048)                                   \
+    TASK(TASK_SOUND,    "sound",    2048)                                   \
+    TASK(TASK_STATS,    "stats",    2048)                                   \
+    TASK(TASK_CONSOLE,  "console",  2048)                                   \
+    TASK_MIRROR_ENTRY
+
+#define TASK(id, name, stack) id,
+typedef enum {
+    TASKS
+    TASK_MAIN,
+    TASK_COUNT
+} task_id;
+#undef TASK
+
+typedef struct {
+    const char *name;
+    uint32_t size;              /* Bytes of stack */
+    uint32_t used;              /* Most it has used so far */
+    uint8_t running;
+} task_stack_stats;
+
+extern TaskHandle_t task_start(task_id id, TaskFunction_t fn, void *arg,
+                               UBaseType_t priority, int core);
+extern void task_register_main(void);
+extern void task_get_stack_stats(task_id id, task_stack_stats *stats);
+extern void task_stack_print(void);
+
+#endif
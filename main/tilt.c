@@ -0,0 +1,146 @@
+#include "freertos/FreeRTOS.h"
+
+#include <stdint.h>
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+
+#include "input_service.h"
+#include "deadline.h"
+#include "tilt.h"
+
+static const char *TAG = "tilt";
+
+static struct {
+    int pin;
+    int64_t arm_delay;
+    deadline_timer arm;         /* Running while disarmed and still */
+    uint8_t armed;
+    /* Written by the ISR only */
+    tilt_edge ring[TILT_RING_SIZE];
+    uint32_t head;
+    /* Read by the task only */
+    uint32_t tail;
+    unsigned long overruns;
+} tilt;
+
+
+/*
+ * Interrupt on the next change of the switch
+ * GPIO wakeup from light sleep only works with level interrupts, and takes
+ * over the pin's interrupt type, so with power management we wait for
+ * the opposite level each time instead of using an any-edge interrupt.
+ */
+static void tilt_watch(int level)
+{
+#if CONFIG_PM_ENABLE
+    gpio_wakeup_enable(tilt.pin, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+#else
+    (void) level;
+    gpio_set_intr_type(tilt.pin, GPIO_INTR_ANYEDGE);
+#endif
+}
+
+
+static void tilt_isr(void *arg)
+{
+    uint32_t head = tilt.head;
+    tilt_edge *edge = &tilt.ring[head % TILT_RING_SIZE];
+    edge->timestamp = esp_timer_get_time();
+    edge->level = gpio_get_level(tilt.pin);
+    tilt_watch(edge->level);
+    __atomic_store_n(&tilt.head, head + 1, __ATOMIC_RELEASE);
+    input_post_from_isr(INPUT_TILT, 0, edge->timestamp);
+}
+
+
+/*
+ * Start watching the tilt switch, which must already be set up as an input
+ */
+int tilt_start(int pin, int arm_delay_ms)
+{
+    esp_err_t err;
+    tilt.pin = pin;
+    tilt.arm_delay = arm_delay_ms * 1000LL;
+    tilt_disarm(deadline_now());
+    tilt_watch(gpio_get_level(pin));
+    /* The service may already be installed by someone else */
+    gpio_install_isr_service(0);
+    err = gpio_isr_handler_add(pin, tilt_isr, NULL);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Unable to add tilt ISR: %d", err);
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * Work through the edges recorded since the last call
+ * Returns 1 if the switch was armed and has been moved, and disarms it
+ */
+int tilt_update(int64_t now)
+{
+    uint32_t head = __atomic_load_n(&tilt.head, __ATOMIC_ACQUIRE);
+    tilt_edge *edge;
+
+    if (head - tilt.tail > TILT_RING_SIZE) {
+        /* The ISR lapped us, the oldest edges are gone but we still moved */
+        tilt.overruns++;
+        tilt.tail = head - TILT_RING_SIZE;
+    }
+    while (tilt.tail != head) {
+        edge = &tilt.ring[tilt.tail % TILT_RING_SIZE];
+        tilt.tail++;
+        if (!tilt.armed && deadline_reached(&tilt.arm, edge->timestamp)) {
+            /* Still for long enough before this edge */
+            deadline_stop(&tilt.arm);
+            tilt.armed = 1;
+        }
+        if (tilt.armed) {
+            ESP_LOGI(TAG, "Tilted...  Starting countdown!");
+            tilt_disarm(now);
+            return 1;
+        }
+        /* We are not yet armed and are being moved */
+        ESP_LOGI(TAG, "Delaying tilt arming due to movement");
+        deadline_start(&tilt.arm, edge->timestamp, tilt.arm_delay, 0);
+    }
+    if (!tilt.armed && deadline_expired(&tilt.arm, now)) {
+        ESP_LOGI(TAG, "Tilt mechanism armed...");
+        tilt.armed = 1;
+    }
+    return 0;
+}
+
+
+/*
+ * Start the arming delay again, e.g. after a game, forgetting old edges
+ */
+void tilt_disarm(int64_t now)
+{
+    tilt.armed = 0;
+    deadline_start(&tilt.arm, now, tilt.arm_delay, 0);
+    tilt.tail = __atomic_load_n(&tilt.head, __ATOMIC_ACQUIRE);
+}
+
+
+int tilt_armed(void)
+{
+    return tilt.armed;
+}
+
+
+/* Goes off when the switch will arm if it is left alone */
+deadline_timer *tilt_arm_timer(void)
+{
+    return &tilt.arm;
+}
+
+
+unsigned long tilt_overruns(void)
+{
+    return tilt.overruns;
+}
@@ -0,0 +1,32 @@
+#ifndef TILT_H
+#define TILT_H
+
+#include <stdint.h>
+
+#include "deadline.h"
+
+/*
+ * Tilt switch
+ * An interrupt on each change timestamps every movement into a ring
+ * buffer and posts an INPUT_TILT event so a task blocked on the input
+ * queue wakes up.  It also wakes the CPU from light sleep.
+ * Arming and triggering are worked out from the recorded edges:
+ * * While disarmed, each movement restarts the arming delay
+ * * Once still for the whole delay the switch arms
+ * * Any movement while armed triggers
+ */
+#define TILT_RING_SIZE 16
+
+typedef struct {
+    int64_t timestamp;      /* esp_timer_get_time() in the ISR */
+    uint8_t level;
+} tilt_edge;
+
+extern int tilt_start(int pin, int arm_delay_ms);
+extern int tilt_update(int64_t now);
+extern void tilt_disarm(int64_t now);
+extern int tilt_armed(void);
+extern deadline_timer *tilt_arm_timer(void);
+extern unsigned long tilt_overruns(void);
+
+#endif
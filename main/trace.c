@@ -0,0 +1,91 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "trace.h"
+
+static const char *TAG = "trace";
+
+#if TRACE_ENABLE
+
+typedef struct {
+    uint32_t head;              /* Slots ever reserved */
+    trace_record records[TRACE_RING_SIZE];
+} trace_ring;
+
+static trace_ring rings[portNUM_PROCESSORS];
+
+
+/*
+ * Record an event, safe from tasks and interrupts
+ */
+void IRAM_ATTR trace_write(uint16_t event, uint32_t a, uint32_t b)
+{
+    trace_ring *ring = &rings[xPortGetCoreID()];
+    uint32_t slot = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+    trace_record *record = &ring->records[slot & (TRACE_RING_SIZE - 1)];
+
+    /* Not this slot until it is all written */
+    __atomic_store_n(&record->seq, (uint16_t) (slot + 0x8000), __ATOMIC_RELAXED);
+    record->time = (uint32_t) esp_timer_get_time();
+    record->event = event;
+    record->a = a;
+    record->b = b;
+    __atomic_store_n(&record->seq, (uint16_t) slot, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * Print the rings for host/trace_decode, oldest first
+ * One line per record: TR <core> <time> <event> <a> <b>, all hex.
+ * Records being written while we look are left out.
+ */
+void trace_dump(void)
+{
+    trace_ring *ring;
+    trace_record record;
+    uint32_t head, slot;
+    unsigned long skipped;
+    int core;
+
+    for (core=0; core<portNUM_PROCESSORS; core++) {
+        ring = &rings[core];
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        slot = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        skipped = 0;
+        for (; slot != head; slot++) {
+            trace_record *r = &ring->records[slot & (TRACE_RING_SIZE - 1)];
+            if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != (uint16_t) slot) {
+                skipped++;
+                continue;
+            }
+            record = *r;
+            if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != (uint16_t) slot) {
+                skipped++;
+                continue;
+            }
+            printf("TR %d %08x %04x %08x %08x\n", core, (unsigned) record.time,
+                   (unsigned) record.event, (unsigned) record.a, (unsigned) record.b);
+        }
+        ESP_LOGI(TAG, "Core %d: %u records, %lu skipped", core, (unsigned) head, skipped);
+    }
+}
+
+#else
+
+void trace_write(uint16_t event, uint32_t a, uint32_t b)
+{
+}
+
+void trace_dump(void)
+{
+    ESP_LOGI(TAG, "Trace not built in, see TRACE_ENABLE");
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Deferred trace
+ * TRACE() drops a fixed size binary record (time, event, two arguments)
+ * into a ring for the core it runs on and returns.  Nothing is formatted
+ * on the device: trace_dump() prints the rings as hex and host/trace_decode
+ * turns that back into log lines using the formats in TRACE_EVENTS.
+ *
+ * Writers reserve a slot with an atomic add, so tasks and interrupts on
+ * the same core can interleave freely.  The oldest records are
+ * overwritten, the ring holds the most recent TRACE_RING_SIZE per core.
+ *
+ * With TRACE_ENABLE 0 the macros and their arguments compile to nothing.
+ * TRACE_V() is for events per byte on the bus and needs TRACE_VERBOSE too.
+ */
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 1
+#endif
+#ifndef TRACE_VERBOSE
+#define TRACE_VERBOSE 0
+#endif
+/* Records per core, a power of 2 */
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 256
+#endif
+
+/* TRACE_EVENT(id, tag, format), the format is given the two arguments */
+#define TRACE_EVENTS                                                        \
+    TRACE_EVENT(TRACE_BUS_BYTE,     "7-seg", "Sending byte: %02x")          \
+    TRACE_EVENT(TRACE_BUS_FRAME,    "7-seg", "bb_send")                     \
+    TRACE_EVENT(TRACE_BUS_ADDRESS,  "7-seg", "bb_send_address %02x = %02x") \
+    TRACE_EVENT(TRACE_BUS_READ,     "7-seg", "bb_read_buttons")             \
+    TRACE_EVENT(TRACE_BUTTONS,      "7-seg", "Buttons: 0x%02x")             \
+    TRACE_EVENT(TRACE_UPDATE,       "7-seg", "Update display")              \
+    TRACE_EVENT(TRACE_LEDS,         "7-seg", "LEDs: 0x%02x")                \
+    TRACE_EVENT(TRACE_INPUT,        "input", "Buttons: 0x%02X")             \
+    TRACE_EVENT(TRACE_NOTE,         "sound", "Note %u Hz for %u ms")        \
+    TRACE_EVENT(TRACE_COUNTDOWN,    "scary", "%d")
+
+#define TRACE_EVENT(id, tag, format) id,
+typedef enum {
+    TRACE_EVENTS
+    TRACE_EVENT_COUNT
+} trace_event;
+#undef TRACE_EVENT
+
+typedef struct {
+    uint32_t time;              /* us, low half of esp_timer_get_time() */
+    uint16_t event;
+    uint16_t seq;               /* Low half of the slot number, once written */
+    uint32_t a;
+    uint32_t b;
+} trace_record;
+
+#if TRACE_ENABLE
+#define TRACE(event, a, b) trace_write((event), (uint32_t) (a), (uint32_t) (b))
+#else
+#define TRACE(event, a, b) do { } while (0)
+#endif
+#if TRACE_ENABLE && TRACE_VERBOSE
+#define TRACE_V(event, a, b) TRACE(event, a, b)
+#else
+#define TRACE_V(event, a, b) do { } while (0)
+#endif
+
+extern void trace_write(uint16_t event, uint32_t a, uint32_t b);
+extern void trace_dump(void);
+
+#endif
@@ -0,0 +1,80 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include "esp_event_loop.h"
+#include "nvs_flash.h"
+#include "tcpip_adapter.h"
+
+#include "wifi.h"
+
+static const char *TAG = "wifi";
+
+#define WIFI_CONNECTED_BIT BIT0
+
+static EventGroupHandle_t wifi_events;
+static StaticEventGroup_t wifi_events_buffer;
+
+
+static esp_err_t wifi_event_handler(void *ctx, system_event_t *event)
+{
+    switch (event->event_id) {
+        case SYSTEM_EVENT_STA_START:
+            esp_wifi_connect();
+            break;
+        case SYSTEM_EVENT_STA_GOT_IP:
+            ESP_LOGI(TAG, "Connected as %s",
+                     ip4addr_ntoa(&event->event_info.got_ip.ip_info.ip));
+            xEventGroupSetBits(wifi_events, WIFI_CONNECTED_BIT);
+            break;
+        case SYSTEM_EVENT_STA_DISCONNECTED:
+            xEventGroupClearBits(wifi_events, WIFI_CONNECTED_BIT);
+            esp_wifi_connect();
+            break;
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+
+/*
+ * Start joining the network, returns straight away
+ */
+void wifi_start(void)
+{
+    wifi_init_config_t init = WIFI_INIT_CONFIG_DEFAULT();
+    wifi_config_t config;
+    esp_err_t err;
+
+    err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
+
+    wifi_events = xEventGroupCreateStatic(&wifi_events_buffer);
+    tcpip_adapter_init();
+    ESP_ERROR_CHECK(esp_event_loop_init(wifi_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_wifi_init(&init));
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+
+    memset(&config, 0, sizeof(config));
+    strncpy((char *) config.sta.ssid, WIFI_SSID, sizeof(config.sta.ssid));
+    strncpy((char *) config.sta.password, WIFI_PASSWORD, sizeof(config.sta.password));
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &config));
+    ESP_ERROR_CHECK(esp_wifi_start());
+    ESP_LOGI(TAG, "Joining %s", WIFI_SSID);
+}
+
+
+int wifi_connected(void)
+{
+    return wifi_events &&
+        (xEventGroupGetBits(wifi_events) & WIFI_CONNECTED_BIT) != 0;
+}
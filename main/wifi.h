@@ -0,0 +1,22 @@
+#ifndef WIFI_H
+#define WIFI_H
+
+/*
+ * WiFi station
+ * Joins WIFI_SSID and keeps trying to rejoin whenever it drops, for the
+ * display mirror (display_mirror.h).  Set the network with
+ * -DWIFI_SSID=\"...\" -DWIFI_PASSWORD=\"...\" rather than editing here.
+ * The radio keeps its modem sleep, so light sleep between events is
+ * still possible, but each beacon wakes the CPU.
+ */
+#ifndef WIFI_SSID
+#define WIFI_SSID "countdown"
+#endif
+#ifndef WIFI_PASSWORD
+#define WIFI_PASSWORD ""
+#endif
+
+extern void wifi_start(void);
+extern int wifi_connected(void);
+
+#endif